@@ -0,0 +1,1032 @@
+//
+//  json_bench.cxx
+//
+//  Timings for the parse and dump paths. Each section prints one line
+//  per case; run a release build. "json_bench corpus" times whole
+//  documents of typical shapes (and files given) phase by phase instead,
+//  see BenchCorpora.
+//
+
+#include <json_wrapper.h>
+#include <json_batch_loader.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <new>
+#include <algorithm>
+
+using namespace std;
+
+// Heap allocations made through new (std containers and strings), for the
+// benchmarks that care about them. jansson's go through malloc. All the
+// forms of new and delete are replaced so that every pair matches, and
+// new and delete are not inlined, or GCC sees malloc's pointer reach
+// delete and warns with -Wmismatched-new-delete.
+#ifdef __GNUC__
+    #define NOT_INLINED __attribute__((noinline))
+#else
+    #define NOT_INLINED
+#endif
+
+static size_t s_News = 0;
+
+NOT_INLINED void* operator new(size_t size)
+{
+    s_News++;
+    void* p = malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+NOT_INLINED void operator delete(void* p) noexcept { free(p); }
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+static double Now()
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keys like the ones in our wide records, of different lengths.
+static const vector<string>& FieldNames()
+{
+    static vector<string> names;
+    if(names.empty())
+    {
+        const char* words[] = { "id", "timestamp", "sensor_value", "x", "calibration_offset_mv", "status" };
+        for(size_t i = 0; i < 250; i++)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "%s_%zu", words[i % 6], i);
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+template<size_t N>
+class WideObject : public json::CJSONValueObject< WideObject<N> >
+{
+    public:
+        WideObject() : json::CJSONValueObject< WideObject<N> >("", this)
+        {
+            for(size_t i = 0; i < N; i++)
+                m_Values[i] = 0;
+        }
+        WideObject(const WideObject& src) : json::CJSONValueObject< WideObject<N> >("", this)
+        {
+            CopyFrom(src);
+            SetupJSONObject();
+        }
+
+        void SetupJSONObject()
+        {
+            for(size_t i = 0; i < N; i++)
+                this->AddIntegerValue(FieldNames()[i], &m_Values[i]);
+        }
+
+        WideObject& CopyFrom(const WideObject& src)
+        {
+            for(size_t i = 0; i < N; i++)
+                m_Values[i] = src.m_Values[i];
+            return *this;
+        }
+        WideObject& operator=(const WideObject& src) { return CopyFrom(src); }
+
+        int     m_Values[N];
+};
+
+// Key to binding lookup: the std::map find with a std::string made from
+// the key (the per instance map) against the shared field table.
+static void BenchKeyDispatch(size_t fields)
+{
+    const vector<string>& names = FieldNames();
+    map<string, int> bindings;
+    json::CJSONFieldTable table;
+    for(size_t i = 0; i < fields; i++)
+    {
+        bindings[names[i]] = int(i);
+        json::CJSONFieldTable::CField field;
+        field.name = names[i];
+        field.offset = i;
+        field.parse = NULL;
+        field.read = NULL;
+        field.dump = NULL;
+        field.write = NULL;
+        field.reset = NULL;
+        field.clear = NULL;
+        table.Add(field);
+    }
+    table.Finish(bindings.begin(), bindings.end());
+
+    const size_t lookups = 4000000;
+    size_t found = 0;
+    double start = Now();
+    for(size_t i = 0; i < lookups; i++)
+    {
+        const char* key = names[i % fields].c_str();
+        found += bindings.find(string(key))->second;
+    }
+    double mapTime = Now() - start;
+
+    start = Now();
+    for(size_t i = 0; i < lookups; i++)
+    {
+        const char* key = names[i % fields].c_str();
+        found += table.Find(key, strlen(key))->offset;
+    }
+    double tableTime = Now() - start;
+
+    printf("key dispatch  %3zu fields: map %6.1f ns/key  table %6.1f ns/key  (%.1fx) [%zu]\n", fields, mapTime * 1e6 / lookups, tableTime * 1e6 / lookups, mapTime / tableTime, found % 10);
+}
+
+// Counts copies and SetupJSONObject calls to see what filling an array of
+// objects costs besides the parse itself.
+class CountedRecord : public json::CJSONValueObject<CountedRecord>
+{
+    public:
+        CountedRecord() : CJSONValueObject("", this), m_Id(0) {}
+        CountedRecord(const CountedRecord& src) : CJSONValueObject("", this)
+        {
+            s_Copies++;
+            CopyFrom(src);
+            SetupJSONObject();
+        }
+
+        void SetupJSONObject()
+        {
+            s_Setups++;
+            AddIntegerValue("id", &m_Id);
+            AddStringValue("name", &m_Name);
+        }
+
+        CountedRecord& CopyFrom(const CountedRecord& src)
+        {
+            m_Id = src.m_Id;
+            m_Name = src.m_Name;
+            return *this;
+        }
+        CountedRecord& operator=(const CountedRecord& src) { s_Copies++; return CopyFrom(src); }
+
+        static size_t   s_Copies;
+        static size_t   s_Setups;
+
+    private:
+        int         m_Id;
+        std::string m_Name;
+};
+size_t CountedRecord::s_Copies = 0;
+size_t CountedRecord::s_Setups = 0;
+
+static void BenchArrayInsert(bool bStreaming)
+{
+    const size_t count = 200000;
+    string text = "[";
+    for(size_t i = 0; i < count; i++)
+    {
+        char value[96];
+        snprintf(value, sizeof(value), "%s{\"id\":%zu,\"name\":\"a record name longer than sso %zu\"}", i ? "," : "", i, i);
+        text += value;
+    }
+    text += "]";
+
+    json::CJSONParser parser(0, bStreaming);
+    parser.LoadFromString(text);
+    vector<CountedRecord> records;
+    CountedRecord::s_Copies = CountedRecord::s_Setups = 0;
+    double start = Now();
+    bool bParseSuccess = parser.ParseObjectArray(&records);
+    double elapsed = Now() - start;
+    printf("array insert  %s: %7.1f ms  %.2f copies/elem  %.2f setups/elem  %s\n", bStreaming ? "stream" : "dom   ", elapsed, double(CountedRecord::s_Copies) / count, double(CountedRecord::s_Setups) / count, bParseSuccess ? "ok" : "FAILED");
+}
+
+// DOM loads with the jansson tree in the parser's arena or on the heap.
+// The second load releases the first tree.
+static void BenchArena(bool bArena)
+{
+    const size_t count = 200000;
+    string text = "[";
+    for(size_t i = 0; i < count; i++)
+    {
+        char value[96];
+        snprintf(value, sizeof(value), "%s{\"id\":%zu,\"name\":\"record %zu\",\"tags\":[1,2,3]}", i ? "," : "", i, i);
+        text += value;
+    }
+    text += "]";
+
+    json::CJSONParser parser(0, false);
+    parser.SetArena(bArena);
+    double start = Now();
+    bool bSuccess = parser.LoadFromString(text);
+    bSuccess = parser.LoadFromString(text) && bSuccess;
+    double elapsed = Now() - start;
+    const json::CJSONArena::CStats& stats = parser.GetArenaStats();
+    printf("dom load x2   %s: %7.1f ms  %zu allocs  %.1f MB in %zu blocks  %s\n", bArena ? "arena " : "heap  ", elapsed, stats.allocations, stats.bytesReserved / 1e6, stats.blocks, bSuccess ? "ok" : "FAILED");
+}
+
+class Request : public json::CJSONValueObject<Request>
+{
+    public:
+        Request() : CJSONValueObject("", this), m_Id(0), m_Amount(0), m_bPriority(false) {}
+        void SetupJSONObject()
+        {
+            AddIntegerValue("id", &m_Id);
+            AddFloatingPointValue("amount", &m_Amount);
+            AddStringValue("customer_reference", &m_Customer);
+            AddBoolValue("priority", &m_bPriority);
+            AddNameValuePair<vector<int>, json::CJSONValueArray<int, json::CJSONValueInt> >("items", &m_Items);
+        }
+
+        int         m_Id;
+        double      m_Amount;
+        string      m_Customer;
+        bool        m_bPriority;
+        vector<int> m_Items;
+};
+
+// 1M small payloads back to back, as a request handler sees them: into a
+// new parser each, or into one kept parser and object that are Reset.
+static void BenchSmallPayloads(bool bStreaming, bool bReuse)
+{
+    const size_t count = 1000000;
+    vector<string> payloads;
+    for(size_t i = 0; i < 64; i++)
+    {
+        char value[192];
+        snprintf(value, sizeof(value), "{\"id\":%zu,\"amount\":%zu.25,\"customer_reference\":\"customer %zu of the region\",\"priority\":true,\"items\":[%zu,2,3]}", i, i * 10, i, i);
+        payloads.push_back(value);
+    }
+
+    json::CJSONParser parser(0, bStreaming);
+    Request request;
+    request.SetupJSONObject();
+    bool bParseSuccess = true;
+    size_t news = s_News;
+    double start = Now();
+    for(size_t i = 0; i < count; i++)
+    {
+        const string& payload = payloads[i % payloads.size()];
+        if(bReuse)
+        {
+            request.Reset();
+            bParseSuccess = parser.LoadFromString(payload) && parser.ParseObject(&request) && bParseSuccess;
+        }
+        else
+        {
+            json::CJSONParser fresh(0, bStreaming);
+            Request freshRequest;
+            freshRequest.SetupJSONObject();
+            bParseSuccess = fresh.LoadFromString(payload) && fresh.ParseObject(&freshRequest) && bParseSuccess;
+        }
+    }
+    double elapsed = Now() - start;
+    printf("small docs    %s %s: %7.1f ms  %.2f news/doc  %s\n", bStreaming ? "stream" : "dom   ", bReuse ? "reused" : "new   ", elapsed, double(s_News - news) / count, bParseSuccess ? "ok" : "FAILED");
+}
+
+// Building the jansson tree from large arrays (the text is not written).
+static void BenchArrayDump()
+{
+    vector<string> strings;
+    for(size_t i = 0; i < 1000000; i++)
+    {
+        char value[64];
+        snprintf(value, sizeof(value), "a string that does not fit in sso %zu", i);
+        strings.push_back(value);
+    }
+    vector<CountedRecord> records(200000);
+
+    json::CJSONValueArray<string, json::CJSONValueString> stringArray("strings", &strings);
+    json_t* pRet = NULL;
+    double start = Now();
+    bool bDumpSuccess = stringArray.Dump(pRet);
+    double elapsed = Now() - start;
+    printf("array dump    1M strings:      %7.1f ms  %s\n", elapsed, bDumpSuccess ? "ok" : "FAILED");
+
+    json::CJSONValueArray<CountedRecord, json::CJSONValueObject<CountedRecord> > recordArray("records", &records);
+    CountedRecord::s_Copies = 0;
+    start = Now();
+    bDumpSuccess = recordArray.Dump(pRet);
+    elapsed = Now() - start;
+    printf("array dump    200k objects:    %7.1f ms  %.2f copies/elem  %s\n", elapsed, double(CountedRecord::s_Copies) / records.size(), bDumpSuccess ? "ok" : "FAILED");
+}
+
+class RecordList : public json::CJSONValueObject<RecordList>
+{
+    public:
+        RecordList() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<CountedRecord>, json::CJSONValueArray<CountedRecord, json::CJSONValueObject<CountedRecord> > >("records", &m_Records);
+            AddStringArrayValue("strings", &m_Strings);
+        }
+
+        vector<CountedRecord>   m_Records;
+        vector<string>          m_Strings;
+};
+
+// DumpObjectToString through the jansson tree and through the writer.
+static void BenchDumpText(bool bStreaming)
+{
+    RecordList list;
+    list.SetupJSONObject();
+    list.m_Records.resize(200000);
+    for(size_t i = 0; i < 200000; i++)
+    {
+        char value[64];
+        snprintf(value, sizeof(value), "a string that does not fit in sso %zu", i);
+        list.m_Strings.push_back(value);
+    }
+
+    json::CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER, bStreaming);
+    string text;
+    double start = Now();
+    bool bDumpSuccess = parser.DumpObjectToString(text, &list);
+    double elapsed = Now() - start;
+    printf("dump text     %s: %7.1f ms  %6.1f MB/s  %s\n", bStreaming ? "stream" : "dom   ", elapsed, text.size() / (elapsed * 1e3), bDumpSuccess ? "ok" : "FAILED");
+}
+
+class Telemetry : public json::CJSONValueObject<Telemetry>
+{
+    public:
+        Telemetry() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<double>, json::CJSONValueArray<double, json::CJSONValueDouble> >("samples", &m_Samples);
+        }
+
+        vector<double>  m_Samples;
+};
+
+// Real arrays: formatting and reading the numbers dominates. As CBOR the
+// samples are one typed array and are copied in and out.
+static void BenchRealArray(bool bStreaming, json::CJSONFormat format = json::JSON_FORMAT_TEXT)
+{
+    Telemetry out, in;
+    out.SetupJSONObject();
+    in.SetupJSONObject();
+    for(size_t i = 0; i < 1000000; i++)
+        out.m_Samples.push_back(double((i * 7919) % 100000) / 1000.0 + 0.5);
+
+    json::CJSONParser parser(0, bStreaming);
+    parser.SetFormat(format);
+    string text;
+    double start = Now();
+    bool bSuccess = parser.DumpObjectToString(text, &out);
+    double dumpTime = Now() - start;
+
+    start = Now();
+    bSuccess = parser.LoadFromString(text) && parser.ParseObject(&in) && bSuccess;
+    double parseTime = Now() - start;
+    printf("reals         %s: dump %7.1f ms  parse %7.1f ms  %5.1f MB  %s\n", format == json::JSON_FORMAT_CBOR ? "cbor  " : bStreaming ? "stream" : "dom   ", dumpTime, parseTime, text.size() / 1e6, bSuccess && in.m_Samples == out.m_Samples ? "ok" : "FAILED");
+}
+
+// Shortest text of uniform doubles, most of them 16 or 17 digits: a third
+// miss the exact double path and go through Eisel-Lemire, which strtod is
+// timed against.
+static void BenchParseReals()
+{
+    const size_t count = 1000000;
+    vector<string> tokens;
+    uint64_t state = 88172645463325252ULL;
+    for(size_t i = 0; i < count; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        char buffer[32];
+        size_t length = json::CJSONNumber::FormatDouble(double(state >> 11) / double(uint64_t(1) << 53) * 1000.0, buffer);
+        tokens.push_back(string(buffer, length));
+    }
+
+    double sum = 0, check = 0;
+    double start = Now();
+    for(size_t i = 0; i < count; i++)
+    {
+        double value = 0;
+        json::CJSONNumber::ParseDouble(tokens[i].data(), tokens[i].data() + tokens[i].size(), value);
+        sum += value;
+    }
+    double parseTime = Now() - start;
+    start = Now();
+    for(size_t i = 0; i < count; i++)
+        check += strtod(tokens[i].c_str(), NULL);
+    double strtodTime = Now() - start;
+    printf("parse reals   : %7.1f ms  strtod %7.1f ms  %s\n", parseTime, strtodTime, sum == check ? "ok" : "FAILED");
+}
+
+template<size_t N>
+static void BenchWideParse(bool bStreaming)
+{
+    const size_t count = 400000 / N;
+    string text = "[";
+    for(size_t i = 0; i < count; i++)
+    {
+        text += (i ? ",{" : "{");
+        for(size_t k = 0; k < N; k++)
+        {
+            char value[96];
+            snprintf(value, sizeof(value), "%s\"%s\":%zu", k ? "," : "", FieldNames()[(k * 7 + i) % N].c_str(), k);
+            text += value;
+        }
+        text += "}";
+    }
+    text += "]";
+
+    json::CJSONParser parser(0, bStreaming);
+    vector< WideObject<N> > records;
+    double start = Now(); // the jansson tree is built in the load.
+    bool bParseSuccess = parser.LoadFromString(text) && parser.ParseObjectArray(&records);
+    double elapsed = Now() - start;
+    printf("wide parse    %3zu fields %s: %7.1f ms  %6.1f MB/s  %s\n", N, bStreaming ? "stream" : "dom   ", elapsed, text.size() / (elapsed * 1e3), bParseSuccess ? "ok" : "FAILED");
+}
+
+class StateFile : public json::CJSONValueObject<StateFile>
+{
+    public:
+        StateFile() : CJSONValueObject("", this), m_Version(0) {}
+        void SetupJSONObject()
+        {
+            AddIntegerValue("version", &m_Version);
+            AddStringValue("host", &m_Host);
+            AddStringValue("status", &m_Status);
+            AddNameValuePair<vector<CountedRecord>, json::CJSONValueArray<CountedRecord, json::CJSONValueObject<CountedRecord> > >("records", &m_Records);
+            AddNameValuePair<vector<double>, json::CJSONValueArray<double, json::CJSONValueDouble> >("samples", &m_Samples);
+        }
+
+        int                     m_Version;
+        string                  m_Host;
+        string                  m_Status;
+        vector<CountedRecord>   m_Records;
+        vector<double>          m_Samples;
+};
+
+// A large state document with three scalars at the end.
+static string StateText()
+{
+    string text = "{\"records\":[";
+    for(size_t i = 0; i < 200000; i++)
+    {
+        char value[96];
+        snprintf(value, sizeof(value), "%s{\"id\":%zu,\"name\":\"a record name longer than sso %zu\"}", i ? "," : "", i, i);
+        text += value;
+    }
+    text += "],\"samples\":[";
+    for(size_t i = 0; i < 1000000; i++)
+    {
+        char value[32];
+        snprintf(value, sizeof(value), "%s%zu.5", i ? "," : "", i % 1000);
+        text += value;
+    }
+    text += "],\"version\":3,\"host\":\"node-17\",\"status\":\"healthy\"}";
+    return text;
+}
+
+// The three scalars read with a full parse, lazily (only they are
+// materialized) or through JSON Pointers.
+static void BenchLazyParse(bool bLazy)
+{
+    string text = StateText();
+    json::CJSONParser parser(0, true);
+    StateFile state;
+    state.SetupJSONObject();
+    state.SetLazy(bLazy);
+    double start = Now();
+    bool bParseSuccess = parser.LoadFromString(text) && parser.ParseObject(&state);
+    bParseSuccess = state.Materialize("version") && state.Materialize("host") && state.Materialize("status") && bParseSuccess;
+    double elapsed = Now() - start;
+    printf("3 of %4.1f MB  %s: %7.1f ms  %s\n", text.size() / 1e6, bLazy ? "lazy  " : "full  ", elapsed, bParseSuccess && state.m_Version == 3 && state.m_Status == "healthy" ? "ok" : "FAILED");
+}
+
+static void BenchPointers()
+{
+    string text = StateText();
+    json::CJSONParser parser(0, true);
+    int version = 0;
+    string host, status;
+    json::CJSONValueInt versionValue("version", &version);
+    json::CJSONValueString hostValue("host", &host);
+    json::CJSONValueString statusValue("status", &status);
+    vector< pair<string, json::CJSONValue*> > targets;
+    targets.push_back(make_pair(string("/version"), (json::CJSONValue*)&versionValue));
+    targets.push_back(make_pair(string("/host"), (json::CJSONValue*)&hostValue));
+    targets.push_back(make_pair(string("/status"), (json::CJSONValue*)&statusValue));
+
+    double start = Now();
+    bool bParseSuccess = parser.LoadFromString(text) && parser.ParsePointers(targets);
+    double elapsed = Now() - start;
+    printf("3 of %4.1f MB  ptrs  : %7.1f ms  %s\n", text.size() / 1e6, elapsed, bParseSuccess && version == 3 && status == "healthy" ? "ok" : "FAILED");
+}
+
+// A checkpoint: a counter that changes every time next to a large state
+// that does not.
+class Checkpoint : public json::CJSONValueObject<Checkpoint>
+{
+    public:
+        Checkpoint() : CJSONValueObject("", this), m_Tick(0) {}
+        void SetupJSONObject()
+        {
+            AddIntegerValue("tick", &m_Tick);
+            AddObjectValue("state", &m_State);
+        }
+
+        int         m_Tick;
+        StateFile   m_State;
+};
+
+static void BenchCheckpoint(bool bStreaming, bool bCache)
+{
+    Checkpoint checkpoint;
+    checkpoint.SetupJSONObject();
+    checkpoint.m_State.SetupJSONObject();
+    json::CJSONParser parser(0, true);
+    bool bDumpSuccess = parser.LoadFromString(StateText()) && parser.ParseObject(&checkpoint.m_State);
+    checkpoint.SetCacheDumps(bCache);
+
+    json::CJSONParser writer(0, bStreaming);
+    string text;
+    const size_t n = 20;
+    double start = Now();
+    for(size_t i = 0; i < n; i++)
+    {
+        checkpoint.SetMember(checkpoint.m_Tick, checkpoint.m_Tick + 1);
+        bDumpSuccess = writer.DumpObjectToString(text, &checkpoint) && bDumpSuccess;
+    }
+    double elapsed = Now() - start;
+    printf("checkpoint %4.1f MB  %s %s: %7.2f ms/dump  %s\n", text.size() / 1e6, bStreaming ? "streaming" : "dom      ", bCache ? "cached" : "full  ", elapsed / n, bDumpSuccess ? "ok" : "FAILED");
+}
+
+// 2000 small files loaded one after the other, as a startup loop does, or
+// through CJSONBatchLoader on a pool of one thread per hardware thread.
+static void BenchBatchLoad(bool bStreaming, bool bBatch)
+{
+    const size_t count = 2000;
+    vector<string> paths;
+    for(size_t i = 0; i < count; i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "json_bench_batch_%zu.json", i);
+        paths.push_back(path);
+        FILE* pFile = fopen(path, "wb");
+        if(pFile)
+        {
+            fprintf(pFile, "{\"id\":%zu,\"amount\":%zu.25,\"customer_reference\":\"customer %zu of the region\",\"priority\":true,\"items\":[", i, i * 10, i);
+            for(size_t j = 0; j < 200; j++)
+                fprintf(pFile, "%s%zu", j ? "," : "", i + j);
+            fprintf(pFile, "]}");
+            fclose(pFile);
+        }
+    }
+
+    vector<Request> requests(count);
+    for(size_t i = 0; i < count; i++)
+        requests[i].SetupJSONObject();
+    json::CJSONThreadPool pool;
+    bool bLoadSuccess = true;
+    double start = Now();
+    if(bBatch)
+    {
+        json::CJSONBatchLoader loader(&pool);
+        loader.SetStreaming(bStreaming);
+        for(size_t i = 0; i < count; i++)
+            loader.Add(paths[i], &requests[i]);
+        bLoadSuccess = loader.Load();
+    }
+    else
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            json::CJSONParser parser(0, bStreaming);
+            bLoadSuccess = parser.LoadFromFile(paths[i]) && parser.ParseObject(&requests[i]) && bLoadSuccess;
+        }
+    }
+    double elapsed = Now() - start;
+    for(size_t i = 0; i < count; i++)
+        remove(paths[i].c_str());
+    printf("%zu files     %s %s: %7.1f ms  %zu threads  %s\n", count, bStreaming ? "stream" : "dom   ", bBatch ? "batch " : "serial", elapsed, bBatch ? pool.GetThreadCount() : 1, bLoadSuccess && requests[count - 1].m_Id == int(count - 1) ? "ok" : "FAILED");
+}
+
+// Corpora: documents of a few typical shapes, made the same on every run
+// from a fixed seed and bound to a type. LoadFromFile, ParseObject,
+// DumpObjectToString and DumpObjectToFile are timed on their own over a
+// number of runs. Allocations are the news plus jansson's mallocs; the
+// DOM loads go to the heap for that, not to the parser's arena.
+static size_t s_Mallocs = 0;
+
+static void* CountingMalloc(size_t size)
+{
+    s_Mallocs++;
+    return malloc(size);
+}
+
+static void CountingFree(void* p)
+{
+    free(p);
+}
+
+// A 64 bit LCG (Knuth's MMIX constants), the same numbers everywhere.
+static uint64_t s_Random = 0;
+
+static uint64_t Random()
+{
+    s_Random = s_Random * 6364136223846793005ull + 1442695040888963407ull;
+    return s_Random >> 11;
+}
+
+static string RandomText(size_t length, bool bEscapes)
+{
+    const char* pieces[] = { "\"", "\\", "\n", "\t", "/", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x99\x82" };
+    string text;
+    while(text.size() < length)
+    {
+        uint64_t r = Random();
+        if(bEscapes && r % 16 == 0)
+            text += pieces[(r >> 4) % 8];
+        else
+            text += char('a' + (r >> 4) % 26);
+    }
+    return text;
+}
+
+class WideCorpus : public json::CJSONValueObject<WideCorpus>
+{
+    public:
+        WideCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector< WideObject<250> >, json::CJSONValueArray<WideObject<250>, json::CJSONValueObject< WideObject<250> > > >("rows", &m_Rows);
+        }
+        void Fill()
+        {
+            m_Rows.resize(2000);
+            for(size_t i = 0; i < m_Rows.size(); i++)
+            {
+                for(size_t j = 0; j < 250; j++)
+                    m_Rows[i].m_Values[j] = int(Random() % 2000000) - 1000000;
+            }
+        }
+
+        vector< WideObject<250> >   m_Rows;
+};
+
+// Nodes nested in chains, the depth of a nested configuration and more.
+class NestedNode : public json::CJSONValueObject<NestedNode>
+{
+    public:
+        NestedNode() : CJSONValueObject("", this), m_Level(0), m_Weight(0) {}
+        NestedNode(const NestedNode& src) : CJSONValueObject("", this)
+        {
+            CopyFrom(src);
+            SetupJSONObject();
+        }
+        void SetupJSONObject()
+        {
+            AddIntegerValue("level", &m_Level);
+            AddFloatingPointValue("weight", &m_Weight);
+            AddStringValue("tag", &m_Tag);
+            AddNameValuePair<vector<NestedNode>, json::CJSONValueArray<NestedNode, json::CJSONValueObject<NestedNode> > >("children", &m_Children);
+        }
+        NestedNode& CopyFrom(const NestedNode& src)
+        {
+            m_Level = src.m_Level;
+            m_Weight = src.m_Weight;
+            m_Tag = src.m_Tag;
+            m_Children = src.m_Children;
+            return *this;
+        }
+        NestedNode& operator=(const NestedNode& src) { return CopyFrom(src); }
+
+        void Fill(int level, int depth)
+        {
+            m_Level = level;
+            m_Weight = double(Random() % 100000) / 64.0;
+            m_Tag = RandomText(8, false);
+            m_Children.clear();
+            if(level < depth)
+            {
+                m_Children.resize(1);
+                m_Children[0].Fill(level + 1, depth);
+            }
+        }
+
+        int                 m_Level;
+        double              m_Weight;
+        string              m_Tag;
+        vector<NestedNode>  m_Children;
+};
+
+class DeepCorpus : public json::CJSONValueObject<DeepCorpus>
+{
+    public:
+        DeepCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<NestedNode>, json::CJSONValueArray<NestedNode, json::CJSONValueObject<NestedNode> > >("chains", &m_Chains);
+        }
+        void Fill()
+        {
+            m_Chains.resize(200);
+            for(size_t i = 0; i < m_Chains.size(); i++)
+                m_Chains[i].Fill(0, 100);
+        }
+
+        vector<NestedNode>  m_Chains;
+};
+
+class IntCorpus : public json::CJSONValueObject<IntCorpus>
+{
+    public:
+        IntCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<int64_t>, json::CJSONValueArray<int64_t, json::CJSONValueInt64> >("values", &m_Values);
+        }
+        void Fill()
+        {
+            for(size_t i = 0; i < 2000000; i++)
+                m_Values.push_back(int64_t(Random() >> (Random() % 50)) - (int64_t(1) << 40));
+        }
+
+        vector<int64_t> m_Values;
+};
+
+class RealCorpus : public json::CJSONValueObject<RealCorpus>
+{
+    public:
+        RealCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<double>, json::CJSONValueArray<double, json::CJSONValueDouble> >("values", &m_Values);
+        }
+        void Fill()
+        {
+            for(size_t i = 0; i < 1000000; i++)
+                m_Values.push_back(i % 2 ? double(Random() % 1000000) / 100.0 : double(Random()) * 1e-9 - 4e6);
+        }
+
+        vector<double>  m_Values;
+};
+
+class CorpusRecord : public json::CJSONValueObject<CorpusRecord>
+{
+    public:
+        CorpusRecord() : CJSONValueObject("", this), m_Id(0), m_Amount(0), m_bActive(false) {}
+        CorpusRecord(const CorpusRecord& src) : CJSONValueObject("", this)
+        {
+            CopyFrom(src);
+            SetupJSONObject();
+        }
+        void SetupJSONObject()
+        {
+            AddInt64Value("id", &m_Id);
+            AddStringValue("name", &m_Name);
+            AddFloatingPointValue("amount", &m_Amount);
+            AddBoolValue("active", &m_bActive);
+            AddStringArrayValue("tags", &m_Tags);
+        }
+        CorpusRecord& CopyFrom(const CorpusRecord& src)
+        {
+            m_Id = src.m_Id;
+            m_Name = src.m_Name;
+            m_Amount = src.m_Amount;
+            m_bActive = src.m_bActive;
+            m_Tags = src.m_Tags;
+            return *this;
+        }
+        CorpusRecord& operator=(const CorpusRecord& src) { return CopyFrom(src); }
+
+        int64_t         m_Id;
+        string          m_Name;
+        double          m_Amount;
+        bool            m_bActive;
+        vector<string>  m_Tags;
+};
+
+class RecordCorpus : public json::CJSONValueObject<RecordCorpus>
+{
+    public:
+        RecordCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<CorpusRecord>, json::CJSONValueArray<CorpusRecord, json::CJSONValueObject<CorpusRecord> > >("records", &m_Records);
+        }
+        void Fill()
+        {
+            m_Records.resize(200000);
+            for(size_t i = 0; i < m_Records.size(); i++)
+            {
+                CorpusRecord& record = m_Records[i];
+                record.m_Id = int64_t(i) * 7919;
+                record.m_Name = RandomText(8 + Random() % 24, false);
+                record.m_Amount = double(Random() % 10000000) / 100.0;
+                record.m_bActive = Random() % 2 != 0;
+                record.m_Tags.resize(Random() % 4);
+                for(size_t j = 0; j < record.m_Tags.size(); j++)
+                    record.m_Tags[j] = RandomText(4 + Random() % 8, false);
+            }
+        }
+
+        vector<CorpusRecord>    m_Records;
+};
+
+class StringCorpus : public json::CJSONValueObject<StringCorpus>
+{
+    public:
+        StringCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject()
+        {
+            AddStringArrayValue("strings", &m_Strings);
+        }
+        void Fill()
+        {
+            for(size_t i = 0; i < 300000; i++)
+                m_Strings.push_back(RandomText(10 + Random() % 190, true));
+        }
+
+        vector<string>  m_Strings;
+};
+
+// Any document with an object root: nothing is bound, every member is
+// kept as a missing value, so this times jansson with the binding layer.
+class FileCorpus : public json::CJSONValueObject<FileCorpus>
+{
+    public:
+        FileCorpus() : CJSONValueObject("", this) {}
+        void SetupJSONObject() {}
+};
+
+struct CPhase
+{
+    const char*     name;
+    vector<double>  times;
+    size_t          allocations;
+    bool            bSuccess;
+};
+
+static void PrintPhase(const string& corpus, bool bStreaming, const CPhase& phase, size_t bytes)
+{
+    vector<double> times = phase.times;
+    sort(times.begin(), times.end());
+    size_t runs = times.size();
+    double p50 = times[runs / 2];
+    double p90 = times[(runs * 9) / 10 < runs ? (runs * 9) / 10 : runs - 1];
+    printf("%-10s %s %-10s p50 %8.2f ms  p90 %8.2f  max %8.2f  %7.1f MB/s  %9zu allocs  %s\n", corpus.c_str(), bStreaming ? "stream" : "dom   ", phase.name, p50, p90, times.back(), bytes / (p50 * 1e3), phase.allocations / runs, phase.bSuccess ? "ok" : "FAILED");
+}
+
+template<class TObject>
+static void BenchCorpus(const string& corpus, const string& path, bool bStreaming, size_t runs)
+{
+    TObject object;
+    object.SetupJSONObject();
+    json::CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER, bStreaming);
+    parser.SetArena(false);
+    const string out = path + ".out";
+    string text;
+
+    CPhase phases[4] = { { "load", vector<double>(), 0, true }, { "parse", vector<double>(), 0, true }, { "dump text", vector<double>(), 0, true }, { "dump file", vector<double>(), 0, true } };
+    for(size_t run = 0; run < runs; run++)
+    {
+        object.Reset();
+        for(size_t i = 0; i < 4; i++)
+        {
+            size_t allocations = s_News + s_Mallocs;
+            double start = Now();
+            bool bSuccess = false;
+            switch(i)
+            {
+                case 0: bSuccess = parser.LoadFromFile(path); break;
+                case 1: bSuccess = parser.ParseObject(&object); break;
+                case 2: bSuccess = parser.DumpObjectToString(text, &object); break;
+                case 3: bSuccess = parser.DumpObjectToFile(out, &object); break;
+            }
+            phases[i].times.push_back(Now() - start);
+            phases[i].allocations += s_News + s_Mallocs - allocations;
+            phases[i].bSuccess = phases[i].bSuccess && bSuccess;
+        }
+    }
+    remove(out.c_str());
+
+    FILE* pFile = fopen(path.c_str(), "rb");
+    size_t bytes = 0;
+    if(pFile)
+    {
+        fseek(pFile, 0, SEEK_END);
+        bytes = size_t(ftell(pFile));
+        fclose(pFile);
+    }
+    for(size_t i = 0; i < 4; i++)
+        PrintPhase(corpus, bStreaming, phases[i], i < 2 ? bytes : text.size());
+}
+
+// Writes the corpus made by TObject::Fill to path and times both engines.
+template<class TObject>
+static void BenchSyntheticCorpus(const string& corpus, size_t runs)
+{
+    const string path = "json_bench_" + corpus + ".json";
+    {
+        TObject object;
+        object.SetupJSONObject();
+        s_Random = 0x2545F4914F6CDD1Dull;
+        object.Fill();
+        json::CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER, true);
+        if(!parser.DumpObjectToFile(path, &object))
+        {
+            printf("%-10s could not write %s\n", corpus.c_str(), path.c_str());
+            return;
+        }
+    }
+    for(int streaming = 0; streaming < 2; streaming++)
+        BenchCorpus<TObject>(corpus, path, streaming != 0, runs);
+    remove(path.c_str());
+}
+
+// json_bench corpus [-n runs] [file.json ...]: the synthetic corpora and
+// then the files given, instead of the sections above.
+static int BenchCorpora(int argc, const char * argv[])
+{
+    size_t runs = 11;
+    vector<string> files;
+    for(int i = 2; i < argc; i++)
+    {
+        if(string(argv[i]) == "-n" && i + 1 < argc)
+            runs = size_t(atoi(argv[++i]));
+        else
+            files.push_back(argv[i]);
+    }
+    if(runs == 0)
+        runs = 1;
+    json_set_alloc_funcs(&CountingMalloc, &CountingFree);
+
+    printf("%zu runs each, sizes are of the loaded file and the dumped text\n", runs);
+    BenchSyntheticCorpus<WideCorpus>("wide", runs);
+    BenchSyntheticCorpus<DeepCorpus>("deep", runs);
+    BenchSyntheticCorpus<IntCorpus>("ints", runs);
+    BenchSyntheticCorpus<RealCorpus>("reals", runs);
+    BenchSyntheticCorpus<RecordCorpus>("records", runs);
+    BenchSyntheticCorpus<StringCorpus>("strings", runs);
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        string corpus = files[i].substr(files[i].find_last_of('/') + 1);
+        for(int streaming = 0; streaming < 2; streaming++)
+            BenchCorpus<FileCorpus>(corpus, files[i], streaming != 0, runs);
+    }
+    return 0;
+}
+
+int main(int argc, const char * argv[])
+{
+    if(argc > 1 && string(argv[1]) == "corpus")
+        return BenchCorpora(argc, argv);
+
+    BenchKeyDispatch(10);
+    BenchKeyDispatch(50);
+    BenchKeyDispatch(250);
+
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchArrayInsert(streaming != 0);
+    }
+    BenchArrayDump();
+    BenchArena(false);
+    BenchArena(true);
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchSmallPayloads(streaming != 0, false);
+        BenchSmallPayloads(streaming != 0, true);
+    }
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchDumpText(streaming != 0);
+    }
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchRealArray(streaming != 0);
+    }
+    BenchRealArray(true, json::JSON_FORMAT_CBOR);
+    BenchParseReals();
+    BenchLazyParse(false);
+    BenchLazyParse(true);
+    BenchPointers();
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchCheckpoint(streaming != 0, false);
+        BenchCheckpoint(streaming != 0, true);
+    }
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchBatchLoad(streaming != 0, false);
+        BenchBatchLoad(streaming != 0, true);
+    }
+
+    for(int streaming = 0; streaming < 2; streaming++)
+    {
+        BenchWideParse<10>(streaming != 0);
+        BenchWideParse<50>(streaming != 0);
+        BenchWideParse<250>(streaming != 0);
+    }
+    return 0;
+}
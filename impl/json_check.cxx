@@ -0,0 +1,1201 @@
+//
+//  json_check.cxx
+//
+//  Checks of the parser's behaviours that can fail, one section per
+//  feature. Prints the checks that fail and exits non zero if any did;
+//  run by ctest.
+//
+
+#include <json_wrapper.h>
+#include <json_record_reader.h>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201103L
+    #include <atomic>
+    #include <new>
+    #include <thread>
+#endif
+#ifdef JSON_HAS_MKSTEMP
+    #include <dirent.h>
+#endif
+
+using namespace std;
+
+#if __cplusplus >= 201103L
+// Allocations made through new (std containers and strings), for the
+// checks that there are none. jansson's go through malloc. new and delete
+// are not inlined, or GCC sees malloc's pointer reach delete (and new's
+// reach free) and warns with -Wmismatched-new-delete.
+#ifdef __GNUC__
+    #define NOT_INLINED __attribute__((noinline))
+#else
+    #define NOT_INLINED
+#endif
+
+static std::atomic<size_t> s_News(0);
+
+NOT_INLINED void* operator new(size_t size)
+{
+    s_News++;
+    void* p = malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+NOT_INLINED void operator delete(void* p) noexcept { free(p); }
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+#endif
+
+static size_t s_Checks = 0;
+static size_t s_Failures = 0;
+
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+static void Check(bool bPassed, const char* condition, const char* file, int line)
+{
+    s_Checks++;
+    if(!bPassed)
+    {
+        s_Failures++;
+        printf("%s:%d: check failed: %s\n", file, line, condition);
+    }
+}
+
+class Leaf : public json::CJSONValueObject<Leaf>
+{
+    public:
+        Leaf() : CJSONValueObject("leaf", this), m_Int(0), m_Real(0), m_bFlag(false) {}
+        Leaf(const Leaf& src) : CJSONValueObject("leaf", this) { *this = src; SetupJSONObject(); }
+        Leaf& operator=(const Leaf& src)
+        {
+            m_Int = src.m_Int;
+            m_Real = src.m_Real;
+            m_bFlag = src.m_bFlag;
+            m_String = src.m_String;
+            return *this;
+        }
+
+        void SetupJSONObject()
+        {
+            AddIntegerValue("int", &m_Int);
+            AddFloatingPointValue("real", &m_Real);
+            AddBoolValue("flag", &m_bFlag);
+            AddStringValue("string", &m_String);
+        }
+
+        int         m_Int;
+        double      m_Real;
+        bool        m_bFlag;
+        string      m_String;
+};
+
+class Document : public json::CJSONValueObject<Document>
+{
+    public:
+        Document() : CJSONValueObject("", this), m_Count(0) {}
+
+        void SetupJSONObject()
+        {
+            AddIntegerValue("count", &m_Count);
+            AddObjectValue("leaf", &m_Leaf);
+            m_Leaf.SetupJSONObject();
+            AddStringArrayValue("names", &m_Names);
+            AddNameValuePair<vector<int>, json::CJSONValueArray<int, json::CJSONValueInt> >("ints", &m_Ints);
+            AddNameValuePair<vector<Leaf>, json::CJSONValueArray<Leaf, json::CJSONValueObject<Leaf> > >("leaves", &m_Leaves);
+        }
+
+        int             m_Count;
+        Leaf            m_Leaf;
+        vector<string>  m_Names;
+        vector<int>     m_Ints;
+        vector<Leaf>    m_Leaves;
+};
+
+static const char* s_DocumentText =
+    "{\"count\":3,\"unknown\":{\"a\":[1,{\"b\":null}]},"
+    "\"leaf\":{\"int\":-7,\"real\":2.5,\"flag\":true,\"string\":\"tab\\t quote\\\" \\u00e9 \\ud83d\\ude00\"},"
+    "\"names\":[\"a\",\"\",\"c\"],\"ints\":[1,-2,3],"
+    "\"leaves\":[{\"int\":1,\"string\":\"x\"},{\"int\":2,\"flag\":false}]}";
+
+static bool Parse(const string& text, Document& document, bool bStreaming)
+{
+    json::CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER, bStreaming);
+    return parser.LoadFromString(text) && parser.ParseObject(&document);
+}
+
+// user-001: the streaming parse binds what the DOM parse binds.
+static void CheckStreaming()
+{
+    Document dom, streamed;
+    dom.SetupJSONObject();
+    streamed.SetupJSONObject();
+    CHECK(Parse(s_DocumentText, dom, false));
+    CHECK(Parse(s_DocumentText, streamed, true));
+    CHECK(streamed.m_Count == 3 && dom.m_Count == 3);
+    CHECK(streamed.m_Leaf.m_Int == -7 && streamed.m_Leaf.m_Real == 2.5 && streamed.m_Leaf.m_bFlag);
+    CHECK(streamed.m_Leaf.m_String == dom.m_Leaf.m_String);
+    CHECK(streamed.m_Leaf.m_String == "tab\t quote\" \xc3\xa9 \xf0\x9f\x98\x80");
+    CHECK(streamed.m_Names == dom.m_Names && streamed.m_Names.size() == 3);
+    CHECK(streamed.m_Ints == dom.m_Ints && streamed.m_Ints.size() == 3);
+    CHECK(streamed.m_Leaves.size() == 2 && dom.m_Leaves.size() == 2);
+    CHECK(streamed.m_Leaves.size() == 2 && streamed.m_Leaves[1].m_Int == 2 && streamed.m_Leaves[0].m_String == "x");
+
+    const char* bad[] = { "{\"count\":}", "{\"count\":1", "{\"count\":1}}", "{\"leaf\":{\"int\":1,}}", "[1,2" };
+    for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        Document document;
+        document.SetupJSONObject();
+        CHECK(!Parse(bad[i], document, true));
+    }
+}
+
+// user-002: the index is listed a chunk at a time, strings and tokens
+// that cross chunks read the same. Both modes take the same UTF-8.
+static void CheckStructuralIndex()
+{
+    string text = "{\n    \"count\" : 3,\n    \"leaves\" : [\n";
+    for(size_t i = 0; i < 4000; i++)
+    {
+        char value[64];
+        snprintf(value, sizeof(value), "%s        { \"int\" : %zu , \"string\" : \"", i ? ",\n" : "", i);
+        text += value;
+        text += string(i % 97 == 0 ? JSON_STRUCTURAL_INDEX_CHUNK + i : i % 17, 'x');
+        text += (i % 5 == 0) ? "\\\"\" }" : "\" }";
+    }
+    text += "\n    ]\n}\n";
+    Document dom, streamed;
+    dom.SetupJSONObject();
+    streamed.SetupJSONObject();
+    CHECK(Parse(text, dom, false));
+    CHECK(Parse(text, streamed, true));
+    bool bSame = dom.m_Leaves.size() == 4000 && streamed.m_Leaves.size() == 4000;
+    for(size_t i = 0; bSame && i < dom.m_Leaves.size(); i++)
+        bSame = dom.m_Leaves[i].m_Int == streamed.m_Leaves[i].m_Int && dom.m_Leaves[i].m_String == streamed.m_Leaves[i].m_String;
+    CHECK(bSame);
+
+    const char* invalid[] = { "\xC0\xAF", "\xE0\x80\xAF", "\xF0\x80\x80\xAF", "\xED\xA0\x80", "\xED\xBF\xBF", "\xF4\x90\x80\x80", "\x80", "\xE2\x82" };
+    for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        string bad = string("{\"leaf\":{\"string\":\"a") + invalid[i] + "b\"}}";
+        Document document;
+        document.SetupJSONObject();
+        CHECK(!Parse(bad, document, true));
+        CHECK(!Parse(bad, document, false));
+    }
+    Document document;
+    document.SetupJSONObject();
+    CHECK(Parse("{\"leaf\":{\"string\":\"\xC2\xA9\xE2\x82\xAC\xED\x9F\xBF\xEE\x80\x80\xF4\x8F\xBF\xBF\"}}", document, true));
+    CHECK(document.m_Leaf.m_String.size() == 15);
+
+    json::CJSONParser streaming(0, true);
+    CHECK(streaming.LoadFromString("  {\"count\":1}") && streaming.IsRootObject() && !streaming.IsRootArray() && !streaming.IsRootString());
+}
+
+// user-002: streaming is opt in, a default parser rejects malformed text
+// at load and leaves the object alone.
+static void CheckStreamingDefault()
+{
+    json::CJSONParser parser;
+    CHECK(!parser.IsStreaming());
+    Leaf leaf;
+    leaf.SetupJSONObject();
+    leaf.m_Int = 7;
+    CHECK(!parser.LoadFromString("{\"int\":1, \"real\": 2 ,,,"));
+    CHECK(!parser.ParseObject(&leaf));
+    CHECK(leaf.m_Int == 7);
+}
+
+class Point : public json::CJSONValueObject<Point>
+{
+    public:
+        Point() : CJSONValueObject("", this), m_X(0) {}
+        void SetupJSONObject() { AddIntegerValue("x", &m_X); }
+        int m_X;
+};
+
+class Point3 : public Point
+{
+    public:
+        Point3() : m_Y(0), m_Z(0) {}
+        void SetupJSONObject()
+        {
+            Point::SetupJSONObject();
+            AddIntegerValue("y", &m_Y);
+            AddIntegerValue("z", &m_Z);
+        }
+        int m_Y, m_Z;
+};
+
+// Binds y only for some instances, so it opts out.
+class OptionalPoint : public json::CJSONValueObject<OptionalPoint>
+{
+    public:
+        OptionalPoint(bool bY = false) : CJSONValueObject("", this), m_X(0), m_Y(0), m_bY(bY) {}
+        void SetupJSONObject()
+        {
+            AddIntegerValue("x", &m_X);
+            if(m_bY)
+                AddIntegerValue("y", &m_Y);
+        }
+        int m_X, m_Y;
+        bool m_bY;
+};
+
+namespace json {
+template<>
+struct CJSONSharedFields<OptionalPoint> { enum { value = false }; };
+}
+
+template<class TVal>
+static bool ParseText(const string& text, TVal& object)
+{
+    json::CJSONParser parser;
+    return parser.LoadFromString(text) && parser.ParseObject(&object);
+}
+
+// user-004: a record that does not parse is reported on its own and the
+// records after it are still read.
+class Line : public json::CJSONValueObject<Line>
+{
+    public:
+        Line() : CJSONValueObject("", this), m_A(0) {}
+        void SetupJSONObject() { AddIntegerValue("a", &m_A); }
+
+        int m_A;
+};
+
+static void CheckRecordReader()
+{
+    const string text = "{\"a\":1}\n{\"a\":\"bad\"}\n{\"a\" 2}\n{\"a\":3}\n";
+    Line line;
+    line.SetupJSONObject();
+    json::CJSONRecordReader reader;
+    reader.AttachBuffer(text.data(), text.size());
+
+    vector<int> values;
+    vector<bool> errors;
+    while(reader.Next(&line))
+    {
+        errors.push_back(reader.HasRecordError());
+        if(!reader.HasRecordError())
+            values.push_back(line.m_A);
+    }
+    CHECK(errors.size() == 4 && !errors[0] && errors[1] && errors[2] && !errors[3]);
+    CHECK(values.size() == 2 && values[0] == 1 && values[1] == 3);
+    CHECK(!reader.HasError() && !reader.HasRecordError() && reader.IsEOF() && reader.GetRecordCount() == 4);
+
+    // A stream cut in the middle of a record is an error of the stream.
+    const string cut = "{\"a\":1}\n{\"a\":";
+    reader.AttachBuffer(cut.data(), cut.size());
+    CHECK(reader.Next(&line) && !reader.HasRecordError() && line.m_A == 1);
+    CHECK(!reader.Next(&line) && reader.HasError());
+}
+
+// user-006: shared fields are on by default. Instances of a derived class
+// keep their own bindings and what they bind on top of the base, whether
+// they come before or after the base's table is ready, and a type that
+// opts out never shares.
+static void CheckSharedFields()
+{
+    for(size_t i = 0; i < 3; i++)
+    {
+        Point3 point3;
+        point3.SetupJSONObject();
+        CHECK(ParseText("{\"x\":1,\"y\":2,\"z\":3}", point3) && point3.m_X == 1 && point3.m_Y == 2 && point3.m_Z == 3);
+        CHECK(!point3.HasSharedFields());
+        json::CJSONParser parser;
+        string text;
+        CHECK(parser.DumpObjectToString(text, &point3) && text.find("\"z\"") != string::npos);
+
+        Point point;
+        point.SetupJSONObject();
+        CHECK(ParseText("{\"x\":4}", point) && point.m_X == 4);
+        CHECK(point.HasSharedFields() == (i > 0));
+    }
+
+    for(size_t i = 0; i < 3; i++)
+    {
+        OptionalPoint point(i == 2);
+        point.SetupJSONObject();
+        CHECK(ParseText("{\"x\":4,\"y\":5}", point) && point.m_X == 4 && point.m_Y == (i == 2 ? 5 : 0));
+        CHECK(!point.HasSharedFields());
+    }
+}
+
+// Counts copies and SetupJSONObject calls.
+class Counted : public json::CJSONValueObject<Counted>
+{
+    public:
+        Counted() : CJSONValueObject("", this), m_Id(0) {}
+        Counted(const Counted& src) : CJSONValueObject("", this)
+        {
+            s_Copies++;
+            CopyFrom(src);
+            SetupJSONObject();
+        }
+
+        void SetupJSONObject()
+        {
+            s_Setups++;
+            AddIntegerValue("id", &m_Id);
+            AddStringValue("name", &m_Name);
+        }
+
+        Counted& CopyFrom(const Counted& src)
+        {
+            m_Id = src.m_Id;
+            m_Name = src.m_Name;
+            return *this;
+        }
+        Counted& operator=(const Counted& src) { s_Copies++; return CopyFrom(src); }
+
+        int         m_Id;
+        string      m_Name;
+
+        static size_t   s_Copies;
+        static size_t   s_Setups;
+};
+size_t Counted::s_Copies = 0;
+size_t Counted::s_Setups = 0;
+
+// user-009: the elements of an array of objects are parsed where they end
+// up, each set up once and never copied.
+static void CheckArrayInPlace()
+{
+    const size_t count = 1000;
+    string text = "[";
+    for(size_t i = 0; i < count; i++)
+    {
+        char value[96];
+        snprintf(value, sizeof(value), "%s{\"id\":%zu,\"name\":\"record %zu\",\"extra\":%zu}", i ? "," : "", i, i, i);
+        text += value;
+    }
+    text += "]";
+
+#ifdef c_plus_plus_11
+    json::CJSONThreadPool pool(4);
+    const size_t modes = 3;
+#else
+    const size_t modes = 2;
+#endif
+    for(size_t mode = 0; mode < modes; mode++)
+    {
+        json::CJSONParser parser(0, mode != 0);
+    #ifdef c_plus_plus_11
+        if(mode == 2)
+            parser.SetThreadPool(&pool);
+    #endif
+        vector<Counted> records;
+        Counted::s_Copies = 0;
+        Counted::s_Setups = 0;
+        CHECK(parser.LoadFromString(text) && parser.ParseObjectArray(&records));
+        CHECK(records.size() == count);
+        CHECK(Counted::s_Copies == 0);
+        CHECK(Counted::s_Setups == count);
+        bool bValues = records.size() == count;
+        for(size_t i = 0; bValues && i < count; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "record %zu", i);
+            bValues = records[i].m_Id == int(i) && records[i].m_Name == name;
+        }
+        CHECK(bValues);
+
+        string dumped;
+        CHECK(parser.DumpObjectToString(dumped, &records.back()) && dumped.find("\"extra\"") != string::npos);
+    }
+}
+
+class Samples : public json::CJSONValueObject<Samples>
+{
+    public:
+        Samples() : CJSONValueObject("", this), m_Float(0) {}
+        void SetupJSONObject()
+        {
+            AddNameValuePair<vector<double>, json::CJSONValueArray<double, json::CJSONValueDouble> >("samples", &m_Samples);
+            AddNameValuePair<float, json::CJSONValueFloat>("float", &m_Float);
+        }
+
+        vector<double>  m_Samples;
+        float           m_Float;
+};
+
+static string FormatDouble(double value)
+{
+    char buffer[32];
+    return string(buffer, json::CJSONNumber::FormatDouble(value, buffer));
+}
+
+static bool SameBits(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// user-012: reals are written with the shortest digits that read back to
+// the same double, in jansson's layout, and read back exactly.
+static void CheckReals()
+{
+    CHECK(FormatDouble(0.1) == "0.1");
+    CHECK(FormatDouble(1.0) == "1.0");
+    CHECK(FormatDouble(-0.0) == "-0.0");
+    CHECK(FormatDouble(1e300) == "1e300");
+    CHECK(FormatDouble(1e-7) == "1e-7");
+    CHECK(FormatDouble(0.30000000000000004) == "0.30000000000000004");
+    CHECK(FormatDouble(5e-324) == "5e-324");
+    CHECK(FormatDouble(1.7976931348623157e308) == "1.7976931348623157e308");
+    char buffer[32];
+    CHECK(string(buffer, json::CJSONNumber::FormatFloat(0.1f, buffer)) == "0.1");
+
+    // Random bit patterns: formatted, read back by strtod and by the reader.
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    size_t formatted = 0, parsed = 0;
+    const size_t count = 200000;
+    for(size_t i = 0; i < count; i++)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double value;
+        memcpy(&value, &state, sizeof(value));
+        if(value != value || value - value != 0) // NaN or infinite.
+            value = double(int64_t(state)) / 3.0;
+        string text = FormatDouble(value);
+        double back = 0;
+        formatted += SameBits(strtod(text.c_str(), NULL), value);
+        parsed += json::CJSONNumber::ParseDouble(text.data(), text.data() + text.size(), back) && SameBits(back, value);
+    }
+    CHECK(formatted == count);
+    CHECK(parsed == count);
+
+    // The exact double path, Eisel-Lemire (17 digits, large exponents,
+    // subnormals, ties to even) and strtod (over 19 digits).
+    const char* tokens[] = { "0", "-0.0", "1e-400", "2.2250738585072011e-308", "123456789012345678901234", "0.1e1", "9007199254740993", "1.5E+3",
+        "1e23", "8.988465674311579e307", "1.7976931348623157e308", "4.9406564584124654e-324", "2.4703282292062328e-324", "1e-342",
+        "9007199254740993e1", "7.2057594037927933e16", "-640.39160894418463", "18446744073709551615e-10", "123.45678901234567e-250" };
+    for(size_t i = 0; i < sizeof(tokens) / sizeof(tokens[0]); i++)
+    {
+        double value = 1;
+        CHECK(json::CJSONNumber::ParseDouble(tokens[i], tokens[i] + strlen(tokens[i]), value) && SameBits(value, strtod(tokens[i], NULL)));
+    }
+    double value = 0;
+    CHECK(!json::CJSONNumber::ParseDouble("1e400", "1e400" + 5, value));
+    CHECK(!json::CJSONNumber::ParseDouble("1.7976931348623159e308", "1.7976931348623159e308" + 22, value));
+
+    Samples out;
+    out.SetupJSONObject();
+    double samples[] = { 0.1, 2.0 / 3.0, 1e-300, -123.456, 4503599627370497.0, 0.0 };
+    out.m_Samples.assign(samples, samples + sizeof(samples) / sizeof(samples[0]));
+    out.m_Float = 0.2f;
+    json::CJSONParser writer(0, true);
+    string text;
+    CHECK(writer.DumpObjectToString(text, &out));
+    CHECK(text.find("0.1,") != string::npos && text.find("0.2") != string::npos && text.find("0.20000") == string::npos);
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        Samples in;
+        in.SetupJSONObject();
+        json::CJSONParser parser(0, mode != 0);
+        CHECK(parser.LoadFromString(text) && parser.ParseObject(&in));
+        bool bSame = in.m_Samples.size() == out.m_Samples.size() && in.m_Float == out.m_Float;
+        for(size_t i = 0; bSame && i < in.m_Samples.size(); i++)
+            bSame = SameBits(in.m_Samples[i], out.m_Samples[i]);
+        CHECK(bSame);
+    }
+}
+
+class Integers : public json::CJSONValueObject<Integers>
+{
+    public:
+        Integers() : CJSONValueObject("", this), m_Int(0), m_Size(0), m_Int64(0), m_UInt64(0), m_Int16(0), m_UInt8(0) {}
+        void SetupJSONObject()
+        {
+            AddIntegerValue("int", &m_Int);
+            AddUIntegerValue("size", &m_Size);
+            AddInt64Value("int64", &m_Int64);
+            AddUInt64Value("uint64", &m_UInt64);
+            AddInt16Value("int16", &m_Int16);
+            AddUInt8Value("uint8", &m_UInt8);
+        }
+
+        int         m_Int;
+        size_t      m_Size;
+        int64_t     m_Int64;
+        uint64_t    m_UInt64;
+        int16_t     m_Int16;
+        uint8_t     m_UInt8;
+};
+
+static bool ParseIntegers(const string& text, Integers& integers, bool bStreaming)
+{
+    integers.SetupJSONObject();
+    json::CJSONParser parser(0, bStreaming);
+    return parser.LoadFromString(text) && parser.ParseObject(&integers);
+}
+
+// user-013: integer members are read exactly over their whole range, and a
+// value that does not fit the member is an error instead of wrapping.
+static void CheckIntegers()
+{
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        bool bStreaming = mode != 0;
+        Integers integers;
+        CHECK(ParseIntegers("{\"int\":-2147483648,\"size\":9007199254740993,\"int64\":-9223372036854775808,\"int16\":-32768,\"uint8\":255}", integers, bStreaming));
+        CHECK(integers.m_Int == INT32_MIN && integers.m_Size == 9007199254740993ULL && integers.m_Int64 == INT64_MIN && integers.m_Int16 == -32768 && integers.m_UInt8 == 255);
+        CHECK(ParseIntegers("{\"int64\":9223372036854775807}", integers, bStreaming) && integers.m_Int64 == INT64_MAX);
+
+        const char* bad[] = { "{\"uint8\":256}", "{\"uint8\":-1}", "{\"int16\":32768}", "{\"int16\":-32769}", "{\"int\":2147483648}", "{\"size\":-1}", "{\"uint64\":-1}", "{\"int64\":99999999999999999999}", "{\"int64\":-9223372036854775809}" };
+        for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        {
+            Integers rejected;
+            rejected.m_UInt8 = 7;
+            rejected.m_Int16 = 7;
+            CHECK(!ParseIntegers(bad[i], rejected, bStreaming));
+            CHECK(rejected.m_UInt8 == 7 && rejected.m_Int16 == 7);
+        }
+    }
+
+    // Above json_int_t only the streaming parse and writer can go.
+    Integers integers;
+    CHECK(ParseIntegers("{\"uint64\":18446744073709551615}", integers, true) && integers.m_UInt64 == UINT64_MAX);
+    json::CJSONParser writer(0, true);
+    string text;
+    CHECK(writer.DumpObjectToString(text, &integers) && text.find("18446744073709551615") != string::npos);
+}
+
+// user-014: what is bound, and the unknown keys kept, come back the same
+// from CBOR; numeric vectors go out as one typed array and typed arrays
+// of other element types read element by element.
+static void CheckCbor()
+{
+    json::CJSONParser text(JSON_SORT_KEYS, false);
+    Document original, copy;
+    original.SetupJSONObject();
+    copy.SetupJSONObject();
+    string data, before, after;
+    json::CJSONParser cbor(JSON_SORT_KEYS, true);
+    cbor.SetFormat(json::JSON_FORMAT_CBOR);
+    CHECK(text.LoadFromString(s_DocumentText) && text.ParseObject(&original));
+    CHECK(cbor.DumpObjectToString(data, &original));
+    CHECK(cbor.LoadFromString(data) && cbor.ParseObject(&copy));
+    CHECK(text.DumpObjectToString(before, &original) && text.DumpObjectToString(after, &copy));
+    CHECK(before == after && after.find("\"unknown\"") != string::npos);
+
+    Samples samples;
+    samples.SetupJSONObject();
+    double values[] = { 0.1, -2.5, 1e300, 0.0 };
+    samples.m_Samples.assign(values, values + 4);
+    CHECK(cbor.DumpObjectToString(data, &samples));
+    size_t at = data.find(string((const char*)values, sizeof(values)));
+    CHECK(at != string::npos && at >= 4);
+    CHECK(at >= 4 && (unsigned char)data[at - 4] == 0xD8 && (unsigned char)data[at - 3] == json::CJSONCbor::TypedArrayTag<double>());
+    CHECK(at >= 4 && (unsigned char)data[at - 2] == 0x58 && (unsigned char)data[at - 1] == sizeof(values));
+    Samples samplesCopy;
+    samplesCopy.SetupJSONObject();
+    CHECK(cbor.LoadFromString(data) && cbor.ParseObject(&samplesCopy) && samplesCopy.m_Samples == samples.m_Samples);
+
+    // {"ints": big endian int16 typed array (tag 73) of 1, -2}
+    const char other[] = "\xA1\x64ints\xD8\x49\x44\x00\x01\xFF\xFE";
+    Document document;
+    document.SetupJSONObject();
+    CHECK(cbor.LoadFromString(string(other, sizeof(other) - 1)) && cbor.ParseObject(&document));
+    CHECK(document.m_Ints.size() == 2 && document.m_Ints[0] == 1 && document.m_Ints[1] == -2);
+
+    Integers integers;
+    integers.SetupJSONObject();
+    integers.m_UInt64 = UINT64_MAX;
+    integers.m_Int64 = INT64_MIN;
+    Integers integersCopy;
+    integersCopy.SetupJSONObject();
+    CHECK(cbor.DumpObjectToString(data, &integers) && cbor.LoadFromString(data) && cbor.ParseObject(&integersCopy));
+    CHECK(integersCopy.m_UInt64 == UINT64_MAX && integersCopy.m_Int64 == INT64_MIN);
+
+    CHECK(!cbor.LoadFromString(data.substr(0, data.size() / 2)) || !cbor.ParseObject(&integersCopy));
+}
+
+// user-015: the arena is opt in, and a value from an arena is never given
+// to free, whichever thread frees it and whatever arena is current then.
+static void CheckArena()
+{
+    json::CJSONParser parser(0, false);
+    CHECK(!parser.IsArena());
+
+#if __cplusplus >= 201103L
+    parser.SetArena(true);
+    Document document;
+    document.SetupJSONObject();
+    CHECK(parser.LoadFromString(s_DocumentText) && parser.ParseObject(&document));
+    CHECK(parser.GetArenaStats().allocations > 0);
+    CHECK(parser.LoadFromString("{}")); // releases the arena, the unknown keys were copied out.
+    string text;
+    json::CJSONParser writer;
+    CHECK(writer.DumpObjectToString(text, &document) && text.find("\"b\"") != string::npos);
+
+    json::CJSONArena arena, other;
+    json_t* pValues[3];
+    {
+        json::CJSONArena::CScope scope(&arena);
+        for(size_t i = 0; i < 3; i++)
+        {
+            pValues[i] = json_object();
+            json_object_set_new(pValues[i], "a", json_string("a string"));
+        }
+    }
+    CHECK(arena.Owns(pValues[0]) && arena.Owns(pValues[1]) && arena.Owns(pValues[2]));
+    json_decref(pValues[0]); // no arena current.
+    {
+        json::CJSONArena::CScope scope(&other);
+        json_decref(pValues[1]); // another one current.
+        json_t* pHeap = NULL;
+        {
+            json::CJSONArena::CScope heap(NULL);
+            pHeap = json_array();
+        }
+        json_decref(pHeap); // a heap value freed in an arena's scope.
+    }
+    std::thread thread([&]() { json_decref(pValues[2]); });
+    thread.join();
+    CHECK(arena.GetStats().frees == 0 && other.GetStats().frees == 0);
+#endif
+}
+
+#if __cplusplus >= 201103L
+static size_t s_CountedMallocs = 0;
+static size_t s_CountedFrees = 0;
+
+static void* CountedMalloc(size_t size)
+{
+    s_CountedMallocs++;
+    return malloc(size);
+}
+
+static void CountedFree(void* p)
+{
+    s_CountedFrees += (p != NULL);
+    free(p);
+}
+#endif
+
+// The arena's hooks call through to the functions set before them and put
+// those back when the last arena is gone.
+static void CheckArenaChain()
+{
+#if __cplusplus >= 201103L && defined(JANSSON_VERSION_HEX) && JANSSON_VERSION_HEX >= 0x020800
+    json_malloc_t pMalloc = NULL;
+    json_free_t pFree = NULL;
+    json_get_alloc_funcs(&pMalloc, &pFree);
+    json_set_alloc_funcs(&CountedMalloc, &CountedFree);
+    {
+        json::CJSONArena arena;
+        json_t* pHeap = NULL;
+        {
+            json::CJSONArena::CScope scope(&arena);
+            json_decref(json_object()); // from the arena.
+            CHECK(s_CountedMallocs == 0 && s_CountedFrees == 0);
+            json::CJSONArena::CScope heap(NULL);
+            pHeap = json_array();
+        }
+        CHECK(s_CountedMallocs == 1);
+        json_decref(pHeap);
+        CHECK(s_CountedFrees == 1);
+
+        json_malloc_t pHook = NULL;
+        json_get_alloc_funcs(&pHook, NULL);
+        CHECK(pHook != &CountedMalloc);
+    }
+    json_malloc_t pRestored = NULL;
+    json_free_t pRestoredFree = NULL;
+    json_get_alloc_funcs(&pRestored, &pRestoredFree);
+    CHECK(pRestored == &CountedMalloc && pRestoredFree == &CountedFree);
+    json_set_alloc_funcs(pMalloc, pFree);
+#endif
+}
+
+#ifdef JSON_HAS_MKSTEMP
+static string ReadText(const string& Path)
+{
+    string text;
+    FILE* pFile = fopen(Path.c_str(), "rb");
+    if(!pFile)
+        return text;
+    char buffer[4096];
+    size_t size = 0;
+    while((size = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+        text.append(buffer, size);
+    fclose(pFile);
+    return text;
+}
+
+static void WriteText(const string& Path, const string& text)
+{
+    FILE* pFile = fopen(Path.c_str(), "wb");
+    if(pFile)
+    {
+        fwrite(text.data(), 1, text.size(), pFile);
+        fclose(pFile);
+    }
+}
+
+static size_t CountFiles(const string& Directory)
+{
+    size_t count = 0;
+    DIR* pDir = opendir(Directory.c_str());
+    for(struct dirent* pEntry = pDir ? readdir(pDir) : NULL; pEntry; pEntry = readdir(pDir))
+        count += (pEntry->d_name[0] != '.');
+    if(pDir)
+        closedir(pDir);
+    return count;
+}
+
+static mode_t FileMode(const string& Path)
+{
+    struct stat info;
+    return stat(Path.c_str(), &info) == 0 ? (info.st_mode & 07777) : 0;
+}
+
+static bool IsLink(const string& Path)
+{
+    struct stat info;
+    return lstat(Path.c_str(), &info) == 0 && S_ISLNK(info.st_mode);
+}
+
+// Changes when the file is replaced rather than written to.
+static ino_t FileInode(const string& Path)
+{
+    struct stat info;
+    return stat(Path.c_str(), &info) == 0 ? info.st_ino : 0;
+}
+#endif
+
+// user-011: a streamed dump replaces the file through a unique temporary
+// file in its directory, keeping its mode and the links that lead to it.
+static void CheckReplaceFile()
+{
+#ifdef JSON_HAS_MKSTEMP
+    char directory[] = "json_check.XXXXXX";
+    CHECK(mkdtemp(directory) != NULL);
+    const string dir = directory;
+    const string path = dir + "/leaf.json";
+
+    Leaf leaf;
+    leaf.SetupJSONObject();
+    leaf.m_Int = 3;
+    json::CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS, true);
+
+    WriteText(path, "{}");
+    chmod(path.c_str(), 0640);
+    WriteText(path + ".tmp", "someone else's");
+    CHECK(parser.DumpObjectToFile(path, &leaf));
+    CHECK(ReadText(path).find("\"int\": 3") != string::npos);
+    CHECK(FileMode(path) == 0640);
+    CHECK(ReadText(path + ".tmp") == "someone else's");
+    CHECK(CountFiles(dir) == 2);
+
+    // Through a relative link, twice: the link stays and leads to the new text.
+    CHECK(mkdir((dir + "/sub").c_str(), 0755) == 0 && symlink("../leaf.json", (dir + "/sub/link.json").c_str()) == 0);
+    leaf.m_Int = 4;
+    CHECK(parser.DumpObjectToFile(dir + "/sub/link.json", &leaf));
+    CHECK(IsLink(dir + "/sub/link.json") && ReadText(path).find("\"int\": 4") != string::npos);
+    CHECK(FileMode(path) == 0640);
+
+    // A new member makes the update a rewrite, through the link as well.
+    leaf.m_String = "new";
+    CHECK(parser.UpdateObjectToFile(dir + "/sub/link.json", &leaf));
+    CHECK(IsLink(dir + "/sub/link.json") && ReadText(path).find("\"new\"") != string::npos);
+    CHECK(FileMode(path) == 0640);
+    CHECK(CountFiles(dir) == 3 && CountFiles(dir + "/sub") == 1);
+
+    // A new file gets the mode fopen gives it.
+    mode_t mask = umask(0);
+    umask(mask);
+    CHECK(parser.DumpObjectToFile(dir + "/new.json", &leaf) && FileMode(dir + "/new.json") == (0666 & ~mask));
+
+    CHECK(!parser.DumpObjectToFile(dir + "/missing/leaf.json", &leaf));
+    CHECK(CountFiles(dir) == 4);
+
+    remove((dir + "/sub/link.json").c_str());
+    rmdir((dir + "/sub").c_str());
+    remove(path.c_str());
+    remove((path + ".tmp").c_str());
+    remove((dir + "/new.json").c_str());
+    CHECK(rmdir(directory) == 0);
+#endif
+}
+
+class Request : public json::CJSONValueObject<Request>
+{
+    public:
+        Request() : CJSONValueObject("", this), m_Id(0), m_Amount(0), m_bPriority(false) {}
+        Request(const Request& src) : CJSONValueObject("", this) { *this = src; }
+        Request& operator=(const Request& src)
+        {
+            m_Id = src.m_Id;
+            m_Amount = src.m_Amount;
+            m_Reference = src.m_Reference;
+            m_bPriority = src.m_bPriority;
+            m_Items = src.m_Items;
+            return *this;
+        }
+
+        void SetupJSONObject()
+        {
+            AddIntegerValue("id", &m_Id);
+            AddFloatingPointValue("amount", &m_Amount);
+            AddStringValue("customer_reference", &m_Reference);
+            AddBoolValue("priority", &m_bPriority);
+            AddNameValuePair<vector<int>, json::CJSONValueArray<int, json::CJSONValueInt> >("items", &m_Items);
+        }
+
+        int             m_Id;
+        double          m_Amount;
+        string          m_Reference;
+        bool            m_bPriority;
+        vector<int>     m_Items;
+};
+
+// user-016: a parser and object reused for one small document after the
+// other read each one as a new pair would, and the streaming parse stops
+// allocating once the buffers have grown.
+static void CheckReuse()
+{
+    vector<string> payloads;
+    for(size_t i = 0; i < 16; i++)
+    {
+        char value[192];
+        if(i % 4 == 3) // leaves out what the others set.
+            snprintf(value, sizeof(value), "{\"id\":%zu}", i);
+        else
+            snprintf(value, sizeof(value), "{\"id\":%zu,\"amount\":%zu.25,\"customer_reference\":\"customer %zu of the region\",\"priority\":true,\"items\":[%zu,2,3]}", i, i * 10, i, i);
+        payloads.push_back(value);
+    }
+
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        vector<Request> expected(payloads.size());
+        for(size_t i = 0; i < payloads.size(); i++)
+        {
+            json::CJSONParser fresh(0, mode != 0);
+            expected[i].SetupJSONObject();
+            CHECK(fresh.LoadFromString(payloads[i]) && fresh.ParseObject(&expected[i]));
+        }
+
+        json::CJSONParser parser(0, mode != 0);
+        Request request;
+        request.SetupJSONObject();
+        for(size_t pass = 0; pass < 4; pass++)
+        {
+            bool bSame = true;
+        #if __cplusplus >= 201103L
+            size_t news = s_News;
+        #endif
+            for(size_t i = 0; i < payloads.size(); i++)
+            {
+                request.Reset();
+                parser.Reset(pass != 1);
+                bSame = parser.LoadFromString(payloads[i]) && parser.ParseObject(&request) && bSame;
+                bSame = bSame && request.m_Id == expected[i].m_Id && request.m_Amount == expected[i].m_Amount && request.m_Reference == expected[i].m_Reference;
+                bSame = bSame && request.m_bPriority == expected[i].m_bPriority && request.m_Items == expected[i].m_Items;
+            }
+            CHECK(bSame);
+        #if __cplusplus >= 201103L
+            if(pass == 3 && mode == 1) // pass 1 freed the buffers, pass 2 grew them again.
+                CHECK(s_News == news);
+        #endif
+        }
+
+        parser.Reset(false);
+        CHECK(!parser.ParseObject(&request));
+        CHECK(parser.LoadFromString(payloads[1]) && parser.ParseObject(&request) && request.m_Id == 1);
+    }
+}
+
+// user-018: the values at JSON Pointers are parsed into their bindings,
+// nested targets and escaped keys included, and a pointer that is
+// malformed or not in the document fails without stopping the others.
+// user-017: what a lazy parse left is not read from the parser's text
+// once that text is replaced or freed.
+static void CheckLazy()
+{
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        Leaf leaf;
+        leaf.SetupJSONObject();
+        leaf.SetLazy(true);
+        json::CJSONParser parser(0, true);
+        CHECK(parser.LoadFromString("{\"int\":1,\"string\":\"a\"}") && parser.ParseObject(&leaf));
+        CHECK(!leaf.IsMaterialized() && leaf.m_Int == 0);
+        CHECK(leaf.Materialize("int") && leaf.m_Int == 1);
+
+        // The parser loads another text, the value left is not taken from it.
+        CHECK(parser.LoadFromString("{\"int\":9,\"string\":\"b\"}"));
+        CHECK(!leaf.Materialize() && leaf.IsMaterialized() && leaf.m_String.empty());
+        CHECK(parser.ParseObject(&leaf) && leaf.Materialize() && leaf.m_Int == 9 && leaf.m_String == "b");
+
+        // The parser is gone, the dump (streamed or through jansson) fails
+        // instead of reading freed text.
+        json::CJSONParser* pParser = new json::CJSONParser(0, true);
+        CHECK(pParser->LoadFromString("{\"int\":2,\"string\":\"c\"}") && pParser->ParseObject(&leaf));
+        delete pParser;
+        string text;
+        json::CJSONParser writer(0, mode != 0);
+        CHECK(!writer.DumpObjectToString(text, &leaf) && leaf.m_Int == 9 && leaf.IsMaterialized());
+        CHECK(writer.DumpObjectToString(text, &leaf) && text.find("\"b\"") != string::npos);
+    }
+}
+
+static void CheckPointers()
+{
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        json::CJSONParser parser(0, mode != 0);
+        CHECK(parser.LoadFromString(s_DocumentText));
+
+        int leafInt = 0, count = 0;
+        string name, leafString;
+        Leaf element, leaf;
+        element.SetupJSONObject();
+        leaf.SetupJSONObject();
+        json::CJSONValueInt leafIntValue("int", &leafInt);
+        json::CJSONValueInt countValue("count", &count);
+        json::CJSONValueString nameValue("name", &name);
+        json::CJSONValueString leafStringValue("string", &leafString);
+        std::vector< std::pair<std::string, json::CJSONValue*> > targets;
+        targets.push_back(std::make_pair(std::string("/leaves/1"), (json::CJSONValue*)&element));
+        targets.push_back(std::make_pair(std::string("/leaf/int"), (json::CJSONValue*)&leafIntValue));
+        targets.push_back(std::make_pair(std::string("/names/2"), (json::CJSONValue*)&nameValue));
+        targets.push_back(std::make_pair(std::string("/leaf"), (json::CJSONValue*)&leaf));
+        targets.push_back(std::make_pair(std::string("/leaf/string"), (json::CJSONValue*)&leafStringValue));
+        targets.push_back(std::make_pair(std::string("/count"), (json::CJSONValue*)&countValue));
+        CHECK(parser.ParsePointers(targets));
+        CHECK(element.m_Int == 2 && !element.m_bFlag && leafInt == -7 && name == "c" && count == 3);
+        CHECK(leaf.m_Int == -7 && leaf.m_Real == 2.5 && leafString == leaf.m_String && !leafString.empty());
+
+        int escaped = 0, tilde = 0;
+        json::CJSONValueInt escapedValue("escaped", &escaped);
+        json::CJSONValueInt tildeValue("tilde", &tilde);
+        CHECK(parser.LoadFromString("{\"a/b\":{\"m~n\":[5,6]},\"~\":7}"));
+        CHECK(parser.ParsePointer("/a~1b/m~0n/1", &escapedValue) && escaped == 6);
+        CHECK(parser.ParsePointer("/~0", &tildeValue) && tilde == 7);
+
+        const char* bad[] = { "a~1b", "/a~1b/m~0n/2", "/a~1b/m~0n/01", "/a~1b/m~0n/-", "/nope", "/a~2b" };
+        for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+            CHECK(!parser.ParsePointer(bad[i], &escapedValue));
+
+        escaped = tilde = 0;
+        targets.clear();
+        targets.push_back(std::make_pair(std::string("/missing"), (json::CJSONValue*)&escapedValue));
+        targets.push_back(std::make_pair(std::string("/~0"), (json::CJSONValue*)&tildeValue));
+        CHECK(!parser.ParsePointers(targets) && tilde == 7);
+
+        escaped = tilde = 0;
+        targets.clear();
+        targets.push_back(std::make_pair(std::string("/a~1b/m~0n/0"), (json::CJSONValue*)&escapedValue));
+        targets.push_back(std::make_pair(std::string("~0"), (json::CJSONValue*)&countValue)); // malformed, skipped.
+        targets.push_back(std::make_pair(std::string("/~0"), (json::CJSONValue*)&tildeValue));
+        CHECK(!parser.ParsePointers(targets) && escaped == 5 && tilde == 7);
+    }
+}
+
+// user-019: an update writes only what changed and keeps the rest of the
+// file byte for byte. It replaces the file unless patching in place was
+// asked for, and then only when the new values fit.
+static void CheckUpdate()
+{
+#ifdef JSON_HAS_MKSTEMP
+    char directory[] = "json_check.XXXXXX";
+    CHECK(mkdtemp(directory) != NULL);
+    const string path = string(directory) + "/leaf.json";
+    const string text = "{ \"string\" :\"old\",\n  \"other\": [1,  2],\n  \"int\":   12345 , \"real\": 1.5, \"flag\": true }";
+
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        bool bInPlace = mode != 0;
+        json::CJSONParser parser(JSON_INDENT(2) | JSON_SORT_KEYS, true);
+        parser.SetPatchInPlace(bInPlace);
+        CHECK(parser.IsPatchInPlace() == bInPlace);
+        Leaf leaf;
+        leaf.SetupJSONObject();
+        WriteText(path, text);
+        CHECK(parser.LoadFromFile(path) && parser.ParseObject(&leaf) && leaf.m_Int == 12345);
+
+        // Nothing changed, nothing is written.
+        ino_t inode = FileInode(path);
+        CHECK(parser.UpdateObjectToFile(path, &leaf) && ReadText(path) == text && FileInode(path) == inode);
+
+        // Fits: patched in place, padded with spaces, only when asked for.
+        leaf.m_Int = 7;
+        CHECK(parser.UpdateObjectToFile(path, &leaf));
+        string expected = text;
+        expected.replace(expected.find("12345"), 5, bInPlace ? "7    " : "7");
+        CHECK(ReadText(path) == expected);
+        CHECK((FileInode(path) == inode) == bInPlace);
+
+        // Does not fit: rewritten either way, the rest kept as it was.
+        inode = FileInode(path);
+        leaf.m_String = "a longer string";
+        CHECK(parser.UpdateObjectToFile(path, &leaf));
+        expected.replace(expected.find("\"old\""), 5, "\"a longer string\"");
+        CHECK(ReadText(path) == expected && FileInode(path) != inode);
+
+        Leaf back;
+        back.SetupJSONObject();
+        json::CJSONParser reader;
+        CHECK(reader.LoadFromFile(path) && reader.ParseObject(&back));
+        CHECK(back.m_Int == 7 && back.m_String == "a longer string" && back.m_Real == 1.5 && back.m_bFlag);
+        CHECK(ReadText(path).find("\"other\": [1,  2]") != string::npos);
+    }
+
+    // A new file is dumped.
+    remove(path.c_str());
+    Leaf leaf;
+    leaf.SetupJSONObject();
+    leaf.m_Int = 9;
+    CHECK(leaf.UpdateFile(path) && ReadText(path).find("\"int\": 9") != string::npos);
+    CHECK(CountFiles(directory) == 1);
+
+    remove(path.c_str());
+    CHECK(rmdir(directory) == 0);
+#endif
+}
+
+// user-020: cached dumps follow the changes the objects are told of,
+// whatever the path to the change: a member, a bound object or an element
+// of an array. What is behind a pointer is written again every time.
+class Cached : public json::CJSONValueObject<Cached>
+{
+    public:
+        Cached() : CJSONValueObject("", this), m_Count(0), m_pLeaf(&m_Pointed) {}
+
+        void SetupJSONObject()
+        {
+            AddIntegerValue("count", &m_Count);
+            AddObjectValue("document", &m_Document);
+            m_Document.SetupJSONObject();
+            AddNameValuePair<Leaf*, json::CJSONValuePointer<Leaf, json::CJSONValueObject<Leaf> > >("pointer", &m_pLeaf);
+        }
+
+        int         m_Count;
+        Document    m_Document;
+        Leaf        m_Pointed;
+        Leaf*       m_pLeaf;
+};
+
+// The cached dump, which must be the one made without the cache.
+template<class TVal>
+static bool DumpsAsNew(json::CJSONParser& parser, TVal& value)
+{
+    string cached, full;
+    bool bDumpSuccess = parser.DumpObjectToString(cached, &value);
+    bool bCache = value.CachesDumps();
+    value.SetCacheDumps(false);
+    bDumpSuccess = parser.DumpObjectToString(full, &value) && bDumpSuccess;
+    value.SetCacheDumps(bCache);
+    bDumpSuccess = parser.DumpObjectToString(full, &value) && bDumpSuccess; // caches it again.
+    return bDumpSuccess && cached == full && !cached.empty();
+}
+
+static void CheckDumpCache()
+{
+    for(size_t mode = 0; mode < 2; mode++)
+    {
+        json::CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER, mode != 0);
+        Cached cached;
+        cached.SetupJSONObject();
+        Document& document = cached.m_Document;
+        CHECK(Parse(s_DocumentText, document, mode != 0));
+        cached.SetCacheDumps(true);
+        CHECK(cached.CachesDumps() && document.CachesDumps() && document.m_Leaf.CachesDumps());
+        CHECK(DumpsAsNew(parser, cached));
+        CHECK(DumpsAsNew(parser, cached));
+        CHECK(DumpsAsNew(parser, document));
+        CHECK(DumpsAsNew(parser, document));
+
+        // The changes are counted and passed on to the owners.
+        size_t modifications = cached.GetModifications();
+        cached.SetMember(cached.m_Count, 11);
+        CHECK(cached.GetModifications() == modifications + 1);
+        CHECK(DumpsAsNew(parser, cached));
+        document.m_Leaf.SetMember(document.m_Leaf.m_String, "changed");
+        CHECK(cached.GetModifications() == modifications + 2);
+        CHECK(DumpsAsNew(parser, document));
+        CHECK(DumpsAsNew(parser, cached));
+        modifications = document.GetModifications();
+        document.m_Leaves[1].SetMember(document.m_Leaves[1].m_Int, 22);
+        CHECK(document.GetModifications() == modifications + 1);
+        CHECK(DumpsAsNew(parser, document));
+        document.ModifyMember(document.m_Ints).push_back(4);
+        CHECK(DumpsAsNew(parser, cached));
+        document.ModifyMember(document.m_Leaves).push_back(Leaf());
+        CHECK(DumpsAsNew(parser, document));
+        document.m_Leaves.back().SetMember(document.m_Leaves.back().m_Int, 5);
+        CHECK(DumpsAsNew(parser, document));
+        cached.m_pLeaf->m_Real = 3.25;
+        CHECK(DumpsAsNew(parser, cached));
+
+        // Elements and pointed objects that cache themselves.
+        document.m_Leaves[0].SetCacheDumps(true);
+        cached.m_Pointed.SetCacheDumps(true);
+        CHECK(DumpsAsNew(parser, cached));
+        document.m_Leaves[0].SetMember(document.m_Leaves[0].m_bFlag, true);
+        CHECK(DumpsAsNew(parser, document));
+        cached.m_Pointed.SetMember(cached.m_Pointed.m_Int, 33);
+        CHECK(DumpsAsNew(parser, cached));
+
+        // A bound object dumped on its own after its owner was, at
+        // another depth than the one its owner splices it in at.
+        document.m_Leaf.SetMember(document.m_Leaf.m_Int, 44);
+        CHECK(DumpsAsNew(parser, document));
+        CHECK(DumpsAsNew(parser, document.m_Leaf));
+        CHECK(DumpsAsNew(parser, document));
+        document.m_Leaf.SetModified();
+        CHECK(DumpsAsNew(parser, cached));
+
+        // A change made without telling is not seen, unless checked.
+        string before, after;
+        CHECK(parser.DumpObjectToString(before, &document));
+        document.m_Leaf.m_Int = 45;
+        CHECK(parser.DumpObjectToString(after, &document) && after == before);
+        json::CJSONDumpCheck::SetEnabled(true);
+        CHECK(DumpsAsNew(parser, document));
+        document.m_Leaves[1].m_String = "unchecked";
+        CHECK(DumpsAsNew(parser, cached));
+        json::CJSONDumpCheck::SetEnabled(false);
+        CHECK(!json::CJSONDumpCheck::IsChecking());
+
+        string text;
+        Cached back;
+        back.SetupJSONObject();
+        json::CJSONParser reader;
+        CHECK(parser.DumpObjectToString(text, &cached) && reader.LoadFromString(text) && reader.ParseObject(&back));
+        CHECK(back.m_Count == 11 && back.m_Document.m_Leaf.m_Int == 45 && back.m_Document.m_Leaves[1].m_Int == 22);
+        CHECK(back.m_Document.m_Leaves[1].m_String == "unchecked" && back.m_Document.m_Leaves.size() == 3);
+        CHECK(back.m_Document.m_Ints.size() == 4 && back.m_Pointed.m_Int == 33 && back.m_Pointed.m_Real == 3.25);
+    }
+}
+
+int main(int argc, const char * argv[])
+{
+    CheckStreaming();
+    CheckStructuralIndex();
+    CheckStreamingDefault();
+    CheckRecordReader();
+    CheckSharedFields();
+    CheckArrayInPlace();
+    CheckReals();
+    CheckIntegers();
+    CheckCbor();
+    CheckArena();
+    CheckArenaChain();
+    CheckReplaceFile();
+    CheckReuse();
+    CheckLazy();
+    CheckPointers();
+    CheckUpdate();
+    CheckDumpCache();
+
+    printf("%zu checks, %zu failed\n", s_Checks, s_Failures);
+    return s_Failures ? 1 : 0;
+}
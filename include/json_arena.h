@@ -0,0 +1,406 @@
+//
+//  json_arena.h
+//
+//  Monotonic (bump) allocator for the jansson values a CJSONParser builds
+//  and drops within one load: the tree of a DOM load. Allocating is a
+//  pointer bump in the current block, freeing does nothing, and all of it
+//  goes back in one go when the parser releases its root.
+//
+//  jansson is pointed at the arena with json_set_alloc_funcs, the first
+//  time a CJSONArena::CScope is made for an arena; nothing is installed
+//  for a program that never uses one. The hooks allocate from the arena
+//  made current on the calling thread by the scope and from the functions
+//  that were set before everywhere else. What they free is looked up in
+//  the blocks of the current arena and then in those of every live arena,
+//  so a value freed on another thread, in the scope of another arena or
+//  in none is still told apart: an arena's is left alone, anything else
+//  goes to the previous free. The lookup takes no lock. A value from the
+//  arena must not be kept past the scope's parser call; CJSONArena::Keep
+//  copies one that has to be.
+//
+//  The previous functions are put back when the last arena that used the
+//  hooks is destroyed, unless something else was installed since. jansson
+//  before 2.8 can not report them, malloc and free are assumed. The hooks
+//  need c++11 (thread_local); without it CScope does nothing.
+//
+
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <jansson.h>
+
+#include "json_stats.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#if __cplusplus >= 201103L
+    #include <atomic>
+    #include <mutex>
+#endif
+
+namespace json {
+
+// The first block, later ones double up to JSON_ARENA_MAX_BLOCK_SIZE.
+#ifndef JSON_ARENA_BLOCK_SIZE
+#define JSON_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+#ifndef JSON_ARENA_MAX_BLOCK_SIZE
+#define JSON_ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+#endif
+
+// Blocks all arenas together may hold. An arena that finds no room left
+// hands out memory from the previous allocation functions instead.
+#ifndef JSON_ARENA_MAX_BLOCKS
+#define JSON_ARENA_MAX_BLOCKS 1024
+#endif
+
+class CJSONArena
+{
+    public:
+        // For sizing JSON_ARENA_BLOCK_SIZE. The counts are since the last
+        // Release; peakBytesUsed and releases are for the arena's life.
+        struct CStats
+        {
+            size_t  allocations;
+            size_t  frees;          // ignored, the memory stays in use.
+            size_t  bytesUsed;      // handed out, alignment included.
+            size_t  bytesReserved;  // in blocks.
+            size_t  blocks;
+            size_t  peakBytesUsed;
+            size_t  releases;
+        };
+
+        CJSONArena(size_t blockSize = JSON_ARENA_BLOCK_SIZE) : m_NextBlockSize(blockSize ? blockSize : 1), m_pCur(NULL), m_pEnd(NULL), m_bHooked(false)
+        {
+            m_Stats.allocations = 0;
+            m_Stats.frees = 0;
+            m_Stats.bytesUsed = 0;
+            m_Stats.bytesReserved = 0;
+            m_Stats.blocks = 0;
+            m_Stats.peakBytesUsed = 0;
+            m_Stats.releases = 0;
+        }
+
+        ~CJSONArena()
+        {
+            FreeBlocks();
+        #if __cplusplus >= 201103L
+            if(m_bHooked)
+                UseHooks(false);
+        #endif
+        }
+
+        // Aligned for any type, like malloc. NULL when out of memory.
+        void* Allocate(size_t size)
+        {
+            const size_t align = 16;
+            size = (size + align - 1) & ~(align - 1);
+            if(size == 0)
+                size = align;
+
+            if(size_t(m_pEnd - m_pCur) < size && !AddBlock(size))
+                return NULL;
+            void* p = m_pCur;
+            m_pCur += size;
+            m_Stats.allocations++;
+            m_Stats.bytesUsed += size;
+            return p;
+        }
+
+        bool Owns(const void* p) const
+        {
+            const char* c = (const char*)p;
+            for(size_t i = m_Blocks.size(); i > 0; i--) // the newest are the likeliest.
+            {
+                if(c >= m_Blocks[i - 1].pBegin && c < m_Blocks[i - 1].pEnd)
+                    return true;
+            }
+            return false;
+        }
+
+        // Everything allocated is gone. One block is kept for the next use;
+        // if more were needed it is made as large as all of them together.
+        void Release()
+        {
+            if(m_Stats.bytesUsed > m_Stats.peakBytesUsed)
+                m_Stats.peakBytesUsed = m_Stats.bytesUsed;
+            m_Stats.releases++;
+            m_Stats.allocations = 0;
+            m_Stats.frees = 0;
+            m_Stats.bytesUsed = 0;
+
+            if(m_Blocks.size() == 1)
+            {
+                m_pCur = m_Blocks[0].pBegin;
+                return;
+            }
+            size_t reserved = m_Stats.bytesReserved;
+            FreeBlocks();
+            if(reserved > m_NextBlockSize)
+                m_NextBlockSize = reserved < JSON_ARENA_MAX_BLOCK_SIZE ? reserved : JSON_ARENA_MAX_BLOCK_SIZE;
+        }
+
+        // Release that frees the kept block as well.
+        void Purge()
+        {
+            Release();
+            FreeBlocks();
+        }
+
+        const CStats& GetStats() const { return m_Stats; }
+
+        // Makes pArena (or none, with NULL) the one jansson allocates from
+        // on this thread until the scope ends.
+        class CScope
+        {
+            public:
+            #if __cplusplus >= 201103L
+                CScope(CJSONArena* pArena) : m_pPrevious(Current())
+                {
+                    if(pArena && !pArena->m_bHooked)
+                        pArena->m_bHooked = UseHooks(true);
+                    Current() = pArena;
+                }
+                ~CScope() { Current() = m_pPrevious; }
+
+            private:
+                CScope(const CScope&);
+                CScope& operator=(const CScope&);
+                CJSONArena* m_pPrevious;
+            #else
+                CScope(CJSONArena*) {}
+            #endif
+        };
+
+        // A value to be kept after the parser call: a reference to it, or a
+        // copy on the heap if it is in an arena.
+        static json_t* Keep(json_t* pVal)
+        {
+        #if __cplusplus >= 201103L
+            if(pVal && GetRegistry().Find(pVal))
+            {
+                CScope heap(NULL);
+                return json_deep_copy(pVal);
+            }
+        #endif
+            return json_incref(pVal);
+        }
+
+    private:
+        struct CBlock
+        {
+            char*   pBegin;
+            char*   pEnd;
+        };
+
+        bool AddBlock(size_t size)
+        {
+            size_t blockSize = m_NextBlockSize;
+            if(blockSize < size)
+                blockSize = size;
+            char* p = (char*)malloc(blockSize);
+            if(!p)
+                return false;
+            CBlock block = { p, p + blockSize };
+        #if __cplusplus >= 201103L
+            if(!GetRegistry().Add(block, this))
+            {
+                free(p);
+                return false;
+            }
+        #endif
+            m_Blocks.push_back(block);
+            m_pCur = p;
+            m_pEnd = p + blockSize;
+            m_Stats.bytesReserved += blockSize;
+            m_Stats.blocks++;
+            if(m_NextBlockSize < JSON_ARENA_MAX_BLOCK_SIZE)
+                m_NextBlockSize *= 2;
+            return true;
+        }
+
+        void FreeBlocks()
+        {
+            for(size_t i = 0; i < m_Blocks.size(); i++)
+            {
+            #if __cplusplus >= 201103L
+                GetRegistry().Remove(m_Blocks[i]);
+            #endif
+                free(m_Blocks[i].pBegin);
+            }
+            m_Blocks.clear();
+            m_pCur = m_pEnd = NULL;
+            m_Stats.bytesReserved = 0;
+            m_Stats.blocks = 0;
+        }
+
+    #if __cplusplus >= 201103L
+        // The blocks of every arena, for Free and Keep. A fixed set of slots
+        // that a block takes and gives back with atomics, so looking up is
+        // a scan of the slots used so far and never waits. Its end is set
+        // last and cleared first: a slot with no end matches nothing.
+        class CRegistry
+        {
+            public:
+                CRegistry() : m_Used(0)
+                {
+                    for(size_t i = 0; i < JSON_ARENA_MAX_BLOCKS; i++)
+                    {
+                        m_Slots[i].pBegin.store(NULL, std::memory_order_relaxed);
+                        m_Slots[i].pEnd.store(NULL, std::memory_order_relaxed);
+                        m_Slots[i].pArena.store(NULL, std::memory_order_relaxed);
+                    }
+                }
+
+                // False when every slot is taken.
+                bool Add(const CBlock& block, CJSONArena* pArena)
+                {
+                    for(size_t i = 0; i < JSON_ARENA_MAX_BLOCKS; i++)
+                    {
+                        CJSONArena* pFree = NULL;
+                        if(!m_Slots[i].pArena.compare_exchange_strong(pFree, pArena))
+                            continue;
+                        m_Slots[i].pBegin.store(block.pBegin);
+                        m_Slots[i].pEnd.store(block.pEnd);
+                        size_t used = m_Used.load();
+                        while(used <= i && !m_Used.compare_exchange_weak(used, i + 1))
+                            ;
+                        return true;
+                    }
+                    return false;
+                }
+
+                void Remove(const CBlock& block)
+                {
+                    size_t used = m_Used.load();
+                    for(size_t i = 0; i < used; i++)
+                    {
+                        if(m_Slots[i].pBegin.load() != block.pBegin)
+                            continue;
+                        m_Slots[i].pEnd.store(NULL);
+                        m_Slots[i].pBegin.store(NULL);
+                        m_Slots[i].pArena.store(NULL);
+                        return;
+                    }
+                }
+
+                // The arena p was allocated from, NULL if none.
+                CJSONArena* Find(const void* p) const
+                {
+                    const char* c = (const char*)p;
+                    size_t used = m_Used.load();
+                    for(size_t i = 0; i < used; i++)
+                    {
+                        const char* pEnd = m_Slots[i].pEnd.load();
+                        if(c < pEnd && c >= m_Slots[i].pBegin.load())
+                            return m_Slots[i].pArena.load();
+                    }
+                    return NULL;
+                }
+
+            private:
+                struct CSlot
+                {
+                    std::atomic<char*>          pBegin;
+                    std::atomic<char*>          pEnd;
+                    std::atomic<CJSONArena*>    pArena;     // NULL for a free slot.
+                };
+
+                std::atomic<size_t>     m_Used;     // no slot at or past it has been taken.
+                CSlot                   m_Slots[JSON_ARENA_MAX_BLOCKS];
+        };
+
+        // Never destroyed: arenas with static storage may outlive it.
+        static CRegistry& GetRegistry()
+        {
+            static CRegistry* pRegistry = new CRegistry();
+            return *pRegistry;
+        }
+
+        static CJSONArena*& Current()
+        {
+            static thread_local CJSONArena* pCurrent = NULL;
+            return pCurrent;
+        }
+
+        // The functions jansson had before the hooks.
+        static std::atomic<json_malloc_t>& PreviousMalloc()
+        {
+            static std::atomic<json_malloc_t> pMalloc(&malloc);
+            return pMalloc;
+        }
+
+        static std::atomic<json_free_t>& PreviousFree()
+        {
+            static std::atomic<json_free_t> pFree(&free);
+            return pFree;
+        }
+
+        // Counts the arenas that use the hooks. The first installs them,
+        // saving what was set before, the last puts that back if the hooks
+        // are still the ones installed. Always true.
+        static bool UseHooks(bool bUse)
+        {
+            static std::mutex* pMutex = new std::mutex(); // never destroyed, like the registry.
+            static size_t users = 0;
+            std::lock_guard<std::mutex> lock(*pMutex);
+
+            json_malloc_t pMalloc = &malloc;
+            json_free_t pFree = &free;
+        #if defined(JANSSON_VERSION_HEX) && JANSSON_VERSION_HEX >= 0x020800
+            json_get_alloc_funcs(&pMalloc, &pFree);
+        #endif
+            if(bUse && users++ == 0)
+            {
+                PreviousMalloc() = pMalloc;
+                PreviousFree() = pFree;
+                json_set_alloc_funcs(&Malloc, &Free);
+            }
+            else if(!bUse && --users == 0 && pMalloc == &Malloc && pFree == &Free)
+            {
+                json_set_alloc_funcs(PreviousMalloc(), PreviousFree());
+            }
+            return true;
+        }
+
+        static void* Malloc(size_t size)
+        {
+            JSON_STATS_ADD(allocations, 1);
+            CJSONArena* pArena = Current();
+            void* p = pArena ? pArena->Allocate(size) : NULL;
+            return p ? p : PreviousMalloc().load()(size);
+        }
+
+        static void Free(void* p)
+        {
+            if(!p)
+                return;
+            CJSONArena* pArena = Current();
+            if(!pArena || !pArena->Owns(p)) // this thread's blocks first.
+                pArena = GetRegistry().Find(p);
+            if(!pArena)
+                PreviousFree().load()(p);
+            else if(pArena == Current()) // the stats are the owner thread's.
+                pArena->m_Stats.frees++;
+        }
+    #endif
+
+    private:
+        CJSONArena(const CJSONArena&);
+        CJSONArena& operator=(const CJSONArena&);
+
+        size_t              m_NextBlockSize;
+        char*               m_pCur;     // free space in the newest block.
+        char*               m_pEnd;
+        std::vector<CBlock> m_Blocks;
+        CStats              m_Stats;
+        bool                m_bHooked;  // counted by UseHooks.
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+//
+//  json_async_file.h
+//
+//  LoadFromFile and SaveToFile off the calling thread, for event loops
+//  that can not block on the file or the parse. The call returns at once;
+//  a worker thread does the load or save and then fulfils a future or
+//  calls a callback.
+//
+//  The object goes with the operation: it is handed over in a
+//  std::unique_ptr and given back in the result, so nothing else can
+//  touch it while the worker does. To reload, load into a new object
+//  and swap it in when it comes back; to save a live object, save a
+//  copy of it.
+//
+//  Example:
+//
+//      json::CJSONAsyncFile files;
+//      std::unique_ptr<Config> pConfig(new Config());  // CJSONValueObject<Config>
+//      pConfig->SetupJSONObject();
+//      files.LoadFromFile("config.json", std::move(pConfig), [](json::CJSONAsyncResult<Config> result) {
+//          if(result.bSuccess)
+//              PostToLoop(...);                        // runs on the worker
+//      });
+//
+//  Needs c++11, see json_thread_pool.h.
+//
+
+#ifndef JSON_ASYNC_FILE_H
+#define JSON_ASYNC_FILE_H
+
+#include "json_wrapper.h"
+
+#if __cplusplus >= 201103L
+
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace json {
+
+template<class TVal>
+struct CJSONAsyncResult
+{
+    typedef std::function<void(CJSONAsyncResult)> Callback;
+
+    CJSONAsyncResult() : bSuccess(false) {}
+
+    std::string             path;
+    std::unique_ptr<TVal>   pObject;    // given back, whether or not it succeeded.
+    bool                    bSuccess;
+};
+
+class CJSONAsyncFile
+{
+    public:
+        // Worker threads the loads and saves run on, in the order they were
+        // made when there is one. The destructor waits for the operations
+        // in flight, so it must not run in one of the callbacks.
+        CJSONAsyncFile(size_t threads = 1) : m_Pool((threads > 0 ? threads : 1) + 1)
+        {
+        }
+
+        // TVal derives from CJSONValueObject<TVal>, with its bindings set up.
+        // The callback runs on the worker thread.
+        template<class TVal>
+        void LoadFromFile(const std::string& Path, std::unique_ptr<TVal> pObject, typename CJSONAsyncResult<TVal>::Callback done)
+        {
+            Submit(Path, std::move(pObject), false, std::move(done));
+        }
+
+        template<class TVal>
+        std::future< CJSONAsyncResult<TVal> > LoadFromFile(const std::string& Path, std::unique_ptr<TVal> pObject)
+        {
+            return SubmitFuture(Path, std::move(pObject), false);
+        }
+
+        template<class TVal>
+        void SaveToFile(const std::string& Path, std::unique_ptr<TVal> pObject, typename CJSONAsyncResult<TVal>::Callback done)
+        {
+            Submit(Path, std::move(pObject), true, std::move(done));
+        }
+
+        template<class TVal>
+        std::future< CJSONAsyncResult<TVal> > SaveToFile(const std::string& Path, std::unique_ptr<TVal> pObject)
+        {
+            return SubmitFuture(Path, std::move(pObject), true);
+        }
+
+    private:
+        CJSONAsyncFile(const CJSONAsyncFile&);
+        CJSONAsyncFile& operator=(const CJSONAsyncFile&);
+
+        // Held by a shared_ptr, std::function can not hold the unique_ptr.
+        template<class TVal>
+        struct COperation
+        {
+            void Run()
+            {
+                if(result.pObject)
+                    result.bSuccess = bSave ? result.pObject->SaveToFile(result.path) : result.pObject->LoadFromFile(result.path);
+                done(std::move(result));
+            }
+
+            CJSONAsyncResult<TVal>                          result;
+            bool                                            bSave;
+            typename CJSONAsyncResult<TVal>::Callback       done;
+        };
+
+        template<class TVal>
+        void Submit(const std::string& Path, std::unique_ptr<TVal> pObject, bool bSave, typename CJSONAsyncResult<TVal>::Callback done)
+        {
+            std::shared_ptr< COperation<TVal> > pOperation = std::make_shared< COperation<TVal> >();
+            pOperation->result.path = Path;
+            pOperation->result.pObject = std::move(pObject);
+            pOperation->bSave = bSave;
+            pOperation->done = std::move(done);
+            m_Pool.Submit([pOperation]() { pOperation->Run(); });
+        }
+
+        template<class TVal>
+        std::future< CJSONAsyncResult<TVal> > SubmitFuture(const std::string& Path, std::unique_ptr<TVal> pObject, bool bSave)
+        {
+            std::shared_ptr< std::promise< CJSONAsyncResult<TVal> > > pPromise = std::make_shared< std::promise< CJSONAsyncResult<TVal> > >();
+            std::future< CJSONAsyncResult<TVal> > future = pPromise->get_future();
+            Submit<TVal>(Path, std::move(pObject), bSave, [pPromise](CJSONAsyncResult<TVal> result) { pPromise->set_value(std::move(result)); });
+            return future;
+        }
+
+        // Its destructor runs what is still queued before joining. The
+        // calling thread only works in ParallelFor, hence the one more.
+        CJSONThreadPool     m_Pool;
+};
+
+}
+
+#endif // c++11
+
+#endif
@@ -0,0 +1,212 @@
+//
+//  json_batch_loader.h
+//
+//  Loads many files, each into its own bound object, on a thread pool:
+//  while one thread reads a file the others parse the ones they read, so
+//  the startup loop over thousands of small files is no longer one read
+//  and one parse after the other.
+//
+//  A thread reserves a file's size out of the memory budget before
+//  reading it and gives it back once the file is parsed, so the buffers
+//  in flight stay under the budget. A file larger than the whole budget
+//  is loaded once nothing else is in flight.
+//
+//  Example:
+//
+//      json::CJSONThreadPool pool(8);
+//      json::CJSONBatchLoader loader(&pool);
+//      for(size_t i = 0; i < configs.size(); i++)
+//          loader.Add(paths[i], &configs[i]);    // CJSONValueObject<Config>
+//      if(!loader.Load())
+//          for(auto& result : loader.GetResults())
+//              if(!result.bSuccess) ...
+//
+//  Needs c++11, see json_thread_pool.h.
+//
+
+#ifndef JSON_BATCH_LOADER_H
+#define JSON_BATCH_LOADER_H
+
+#include "json_wrapper.h"
+
+#if __cplusplus >= 201103L
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace json {
+
+#ifndef JSON_BATCH_LOADER_BUDGET_DEFAULT
+#define JSON_BATCH_LOADER_BUDGET_DEFAULT (64 * 1024 * 1024)
+#endif
+
+class CJSONBatchLoader
+{
+    public:
+        struct CResult
+        {
+            std::string     path;
+            bool            bSuccess;
+            size_t          size;           // of the file, 0 if it could not be opened.
+            std::string     error;          // empty on success.
+        };
+
+        // pPool == NULL loads on the calling thread. The pool is not owned,
+        // it must outlive Load.
+        CJSONBatchLoader(CJSONThreadPool* pPool = NULL, size_t memoryBudget = JSON_BATCH_LOADER_BUDGET_DEFAULT) : m_pThreadPool(pPool), m_MemoryBudget(memoryBudget), m_bStreaming(JSON_PARSER_STREAMING_DEFAULT), m_InFlight(0), m_PeakInFlight(0)
+        {
+        }
+
+        // The object is parsed into by Load, it must not be used until Load
+        // returns. Its bindings must be set up.
+        template<class TVal>
+        void Add(const std::string& Path, CJSONValueObject<TVal>* pObject)
+        {
+            CFile file;
+            file.path = Path;
+            file.parse = [pObject](CJSONParser& parser) {
+                return parser.ParseObject(pObject) && pObject->Materialize();
+            };
+            m_Files.push_back(file);
+        }
+
+        // Loads every file added since the last Clear. true if all of them
+        // loaded; GetResults tells which did not and why.
+        bool Load()
+        {
+            m_Results.assign(m_Files.size(), CResult());
+            m_InFlight = 0;
+            m_PeakInFlight = 0;
+
+            std::function<void(size_t)> loadFile = [this](size_t i) { LoadFile(i); };
+            if(m_pThreadPool)
+            {
+                m_pThreadPool->ParallelFor(m_Files.size(), loadFile);
+            }
+            else
+            {
+                for(size_t i = 0; i < m_Files.size(); i++)
+                    loadFile(i);
+            }
+
+            bool bLoadSuccess = true;
+            for(size_t i = 0; i < m_Results.size(); i++)
+                bLoadSuccess = m_Results[i].bSuccess && bLoadSuccess;
+            return bLoadSuccess;
+        }
+
+        void Clear()
+        {
+            m_Files.clear();
+            m_Results.clear();
+        }
+
+        // One per file added, in the order they were added.
+        const std::vector<CResult>& GetResults() const { return m_Results; }
+
+        CJSONThreadPool* GetThreadPool() const { return m_pThreadPool; }
+        void SetThreadPool(CJSONThreadPool* pPool) { m_pThreadPool = pPool; }
+
+        // Bytes of the files being read and parsed at once.
+        size_t GetMemoryBudget() const { return m_MemoryBudget; }
+        void SetMemoryBudget(size_t memoryBudget) { m_MemoryBudget = memoryBudget; }
+
+        // The most that was in flight during the last Load.
+        size_t GetPeakInFlight() const { return m_PeakInFlight; }
+
+        // Mode of the parsers the files are loaded with, see CJSONParser.
+        bool IsStreaming() const { return m_bStreaming; }
+        void SetStreaming(bool bStreaming) { m_bStreaming = bStreaming; }
+
+    private:
+        CJSONBatchLoader(const CJSONBatchLoader&);
+        CJSONBatchLoader& operator=(const CJSONBatchLoader&);
+
+        struct CFile
+        {
+            std::string                         path;
+            std::function<bool(CJSONParser&)>   parse;
+        };
+
+        void LoadFile(size_t i)
+        {
+            CResult& result = m_Results[i];
+            result.path = m_Files[i].path;
+            result.bSuccess = false;
+            result.size = 0;
+
+            long size = FileSize(result.path);
+            if(size < 0)
+            {
+                result.error = "unable to open " + result.path + ": " + strerror(errno);
+                fprintf(stderr, "warning: %s \n", result.error.c_str());
+                return;
+            }
+            result.size = size_t(size);
+
+            Reserve(result.size);
+            {
+                // A parser per file: the text, the DOM and the arena go
+                // with it before the budget is given back.
+                CJSONParser parser(JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER, m_bStreaming);
+                if(!parser.LoadFromFile(result.path))
+                    result.error = parser.GetLastError().text;
+                else if(!parser.IsRootObject())
+                    result.error = "expected an object in " + result.path;
+                else if(!m_Files[i].parse(parser))
+                    result.error = "unable to parse " + result.path;
+                else
+                    result.bSuccess = true;
+            }
+            Release(result.size);
+        }
+
+        void Reserve(size_t size)
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Released.wait(lock, [&]() { return m_InFlight == 0 || m_InFlight + size <= m_MemoryBudget; });
+            m_InFlight += size;
+            if(m_InFlight > m_PeakInFlight)
+                m_PeakInFlight = m_InFlight;
+        }
+
+        void Release(size_t size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_InFlight -= size;
+            }
+            m_Released.notify_all();
+        }
+
+        // -1 if it can not be opened.
+        static long FileSize(const std::string& Path)
+        {
+            FILE* pFile = fopen(Path.c_str(), "rb");
+            if(!pFile)
+                return -1;
+            long size = 0;
+            if(fseek(pFile, 0, SEEK_END) == 0)
+                size = ftell(pFile);
+            fclose(pFile);
+            return size > 0 ? size : 0;
+        }
+
+        CJSONThreadPool*            m_pThreadPool;
+        size_t                      m_MemoryBudget;
+        bool                        m_bStreaming;
+        std::vector<CFile>          m_Files;
+        std::vector<CResult>        m_Results;
+
+        std::mutex                  m_Mutex;
+        std::condition_variable     m_Released;
+        size_t                      m_InFlight;         // guarded by m_Mutex
+        size_t                      m_PeakInFlight;     // guarded by m_Mutex
+};
+
+}
+
+#endif // c++11
+
+#endif
@@ -0,0 +1,271 @@
+//
+//  json_cbor.h
+//
+//  CBOR (RFC 8949) encoding helpers for the binary format of CJSONWriter
+//  and CJSONReader. The JSON data model is kept: maps have text keys, and
+//  there are no byte strings or undefined. Containers are written with
+//  indefinite length since the writer streams. Arrays of numbers bound
+//  to a vector are written as one typed array (RFC 8746), a tag and a
+//  byte string holding the elements in the writer's byte order.
+//
+
+#ifndef JSON_CBOR_H
+#define JSON_CBOR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <limits>
+
+namespace json {
+
+// Encoding used by CJSONParser, CJSONReader and CJSONWriter.
+enum CJSONFormat
+{
+    JSON_FORMAT_TEXT,
+    JSON_FORMAT_CBOR
+};
+
+// Element types a typed array can hold: integers of 1, 2, 4 or 8 bytes
+// and float/double. bool is an integer to numeric_limits but not here.
+template<class T>
+struct CJSONCborTypedArray
+{
+    enum
+    {
+        value = std::numeric_limits<T>::is_specialized
+            && (std::numeric_limits<T>::is_integer ? (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) : (sizeof(T) == 4 || sizeof(T) == 8))
+    };
+};
+
+template<>
+struct CJSONCborTypedArray<bool> { enum { value = false }; };
+
+class CJSONCbor
+{
+    public:
+        enum
+        {
+            MAJOR_UNSIGNED  = 0,
+            MAJOR_NEGATIVE  = 1,
+            MAJOR_BYTES     = 2,
+            MAJOR_TEXT      = 3,
+            MAJOR_ARRAY     = 4,
+            MAJOR_MAP       = 5,
+            MAJOR_TAG       = 6,
+            MAJOR_SIMPLE    = 7
+        };
+
+        enum
+        {
+            INFO_INDEFINITE = 31,
+            SIMPLE_FALSE    = 20,
+            SIMPLE_TRUE     = 21,
+            SIMPLE_NULL     = 22,
+            SIMPLE_UNDEFINED= 23,
+            SIMPLE_HALF     = 25,
+            SIMPLE_FLOAT    = 26,
+            SIMPLE_DOUBLE   = 27,
+            BREAK           = 0xFF
+        };
+
+        // Typed array tags are 0b010fsell: f float, s signed, e little
+        // endian, ll the size (1, 2, 4, 8 bytes; 2, 4, 8, 16 for floats).
+        enum
+        {
+            TAG_TYPED_FIRST = 64,
+            TAG_TYPED_LAST  = 87
+        };
+
+        struct CElementType
+        {
+            bool        bFloat;
+            bool        bSigned;
+            bool        bLittle;
+            size_t      size;
+        };
+
+        // The head of a data item with the argument in its shortest form.
+        static void AppendHead(std::string& out, int major, uint64_t value)
+        {
+            unsigned char head[9];
+            size_t length = 1;
+            if(value < 24)
+            {
+                head[0] = (unsigned char)((major << 5) | int(value));
+            }
+            else if(value <= 0xFF)
+            {
+                head[0] = (unsigned char)((major << 5) | 24);
+                length = 2;
+            }
+            else if(value <= 0xFFFF)
+            {
+                head[0] = (unsigned char)((major << 5) | 25);
+                length = 3;
+            }
+            else if(value <= 0xFFFFFFFFu)
+            {
+                head[0] = (unsigned char)((major << 5) | 26);
+                length = 5;
+            }
+            else
+            {
+                head[0] = (unsigned char)((major << 5) | 27);
+                length = 9;
+            }
+            for(size_t i = length - 1; i > 0; i--)
+            {
+                head[i] = (unsigned char)(value & 0xFF);
+                value >>= 8;
+            }
+            out.append((const char*)head, length);
+        }
+
+        // A double as float when that is exact, CBOR's preferred form.
+        static void AppendReal(std::string& out, double value)
+        {
+            float single = float(value);
+            if(double(single) == value || value != value)
+            {
+                AppendFloat(out, single);
+                return;
+            }
+            uint64_t bits = 0;
+            memcpy(&bits, &value, sizeof(bits));
+            out += char((MAJOR_SIMPLE << 5) | SIMPLE_DOUBLE);
+            AppendBigEndian(out, bits, 8);
+        }
+
+        static void AppendFloat(std::string& out, float value)
+        {
+            uint32_t bits = 0;
+            memcpy(&bits, &value, sizeof(bits));
+            out += char((MAJOR_SIMPLE << 5) | SIMPLE_FLOAT);
+            AppendBigEndian(out, bits, 4);
+        }
+
+        static bool IsLittleEndian()
+        {
+            const uint16_t one = 1;
+            unsigned char first = 0;
+            memcpy(&first, &one, 1);
+            return first == 1;
+        }
+
+        template<class T>
+        static unsigned int TypedArrayTag()
+        {
+            unsigned int sizeBits = (sizeof(T) == 1) ? 0 : (sizeof(T) == 2) ? 1 : (sizeof(T) == 4) ? 2 : 3;
+            if(!std::numeric_limits<T>::is_integer)
+                sizeBits--; // floats start at 2 bytes.
+            unsigned int tag = TAG_TYPED_FIRST | sizeBits;
+            if(!std::numeric_limits<T>::is_integer)
+                tag |= 0x10;
+            else if(std::numeric_limits<T>::is_signed)
+                tag |= 0x08;
+            if(sizeof(T) > 1 && IsLittleEndian())
+                tag |= 0x04;
+            return tag;
+        }
+
+        // false for tags that are not typed arrays or hold elements that
+        // are not read (quad floats, clamped bytes).
+        static bool DecodeTypedArrayTag(uint64_t tag, CElementType& type)
+        {
+            if(tag < TAG_TYPED_FIRST || tag > TAG_TYPED_LAST)
+                return false;
+            unsigned int bits = unsigned(tag) & 0x1F;
+            type.bFloat = (bits & 0x10) != 0;
+            type.bSigned = type.bFloat || (bits & 0x08) != 0;
+            type.bLittle = (bits & 0x04) != 0;
+            if(type.bFloat)
+            {
+                if((bits & 0x08) || (bits & 0x03) == 3)
+                    return false;
+                type.size = size_t(2) << (bits & 0x03);
+            }
+            else
+            {
+                if(tag == 68 || tag == 76) // clamped uint8, reserved.
+                    return false;
+                type.size = size_t(1) << (bits & 0x03);
+            }
+            return true;
+        }
+
+        // The element at p, widened.
+        static double TypedElementAsDouble(const unsigned char* p, const CElementType& type)
+        {
+            uint64_t bits = LoadElement(p, type);
+            if(type.bFloat)
+                return BitsToDouble(bits, type.size);
+            if(type.bSigned)
+                return double(SignExtend(bits, type.size));
+            return double(bits);
+        }
+
+        static uint64_t LoadElement(const unsigned char* p, const CElementType& type)
+        {
+            uint64_t bits = 0;
+            for(size_t i = 0; i < type.size; i++)
+            {
+                size_t byte = type.bLittle ? type.size - 1 - i : i;
+                bits = (bits << 8) | p[byte];
+            }
+            return bits;
+        }
+
+        static int64_t SignExtend(uint64_t bits, size_t size)
+        {
+            if(size < 8 && (bits >> (size * 8 - 1)) & 1)
+                bits |= ~uint64_t(0) << (size * 8);
+            return int64_t(bits);
+        }
+
+        // size is 2 (half), 4 or 8.
+        static double BitsToDouble(uint64_t bits, size_t size)
+        {
+            if(size == 8)
+            {
+                double value = 0;
+                memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+            if(size == 4)
+            {
+                uint32_t single = uint32_t(bits);
+                float value = 0;
+                memcpy(&value, &single, sizeof(value));
+                return value;
+            }
+            // half: 1 sign, 5 exponent, 10 mantissa bits.
+            int exponent = int((bits >> 10) & 0x1F);
+            double mantissa = double(bits & 0x3FF);
+            double value;
+            if(exponent == 0)
+                value = ldexp(mantissa, -24);
+            else if(exponent != 31)
+                value = ldexp(mantissa + 1024, exponent - 25);
+            else
+                value = (mantissa == 0) ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+            return (bits & 0x8000) ? -value : value;
+        }
+
+    private:
+        static void AppendBigEndian(std::string& out, uint64_t value, size_t size)
+        {
+            char bytes[8];
+            for(size_t i = size; i > 0; i--)
+            {
+                bytes[i - 1] = char(value & 0xFF);
+                value >>= 8;
+            }
+            out.append(bytes, size);
+        }
+};
+
+}
+
+#endif
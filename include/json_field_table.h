@@ -0,0 +1,235 @@
+//
+//  json_field_table.h
+//
+//  Field bindings shared by every instance of one CJSONValueObject type.
+//  Every instance of a class binds the same members under the same names,
+//  only the address of the object changes. The table keeps, for each key,
+//  the offset of the member in the object and the functions that parse,
+//  dump and reset it, so an instance does not need a map of heap allocated
+//  CJSONValue bindings of its own. Types opt out with CJSONSharedFields in
+//  json_wrapper.h, and instances of classes derived from the type keep
+//  their own map.
+//
+//  The table is filled by the Add* calls of the first instance that runs
+//  SetupJSONObject and is ready once that instance is first parsed, dumped
+//  or reset. If a binding can not be described by an offset (a member of
+//  another object, a pointer binding that allocates) or two instances bind
+//  differently the type stays on the per instance map.
+//
+//  When the table is ready the keys are put in a perfect hash: a seed is
+//  searched for so that every key lands in its own slot, and a lookup is
+//  one hash of the key, one slot and one compare. Nothing is allocated.
+//
+
+#ifndef JSON_FIELD_TABLE_H
+#define JSON_FIELD_TABLE_H
+
+#include <jansson.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "json_reader.h"
+#include "json_writer.h"
+
+#if __cplusplus >= 201103L
+    #include <atomic>
+    #include <mutex>
+#endif
+
+namespace json {
+
+class CJSONFieldTable
+{
+    public:
+        // p is the address of the member, name the key it is bound to.
+        typedef bool (*ParseFunc)(const std::string& name, void* p, const json_t* pVal);
+        typedef bool (*ReadFunc)(const std::string& name, void* p, CJSONReader& reader);
+        typedef bool (*DumpFunc)(const std::string& name, void* p, json_t*& pRet);
+        typedef bool (*WriteFunc)(const std::string& name, void* p, CJSONWriter& writer);
+        typedef void (*ResetFunc)(const std::string& name, void* p);
+        typedef void (*ClearFunc)(void* p);
+
+        struct CField
+        {
+            std::string     name;
+            size_t          offset;
+            ParseFunc       parse;
+            ReadFunc        read;
+            DumpFunc        dump;
+            WriteFunc       write;
+            ResetFunc       reset;
+            ClearFunc       clear;  // drops a buffered json_t, NULL if there is none.
+        };
+
+        enum
+        {
+            STATE_COLLECTING,   // the first instance is adding its fields.
+            STATE_READY,        // Find and GetFields may be used.
+            STATE_DYNAMIC       // not usable, instances keep their own map.
+        };
+
+        CJSONFieldTable() : m_State(STATE_COLLECTING), m_Seed(0), m_Mask(0) {}
+
+        bool IsReady() const { return m_State == STATE_READY; }
+        bool IsDynamic() const { return m_State == STATE_DYNAMIC; }
+
+        // Records a field while collecting. The same name may be added again
+        // by other instances; it must describe the same binding.
+        void Add(const CField& field)
+        {
+            if(m_State != STATE_COLLECTING)
+                return;
+            Lock lock(*this);
+            if(m_State != STATE_COLLECTING)
+                return;
+
+            std::vector<CField>::iterator iter = std::lower_bound(m_Fields.begin(), m_Fields.end(), field.name, NameLess());
+            if(iter == m_Fields.end() || iter->name != field.name)
+            {
+                m_Fields.insert(iter, field);
+            }
+            else if(iter->offset != field.offset || iter->parse != field.parse)
+            {
+                m_State = STATE_DYNAMIC;
+            }
+        }
+
+        // The binding can not be shared, every instance keeps its own map.
+        void SetDynamic()
+        {
+            Lock lock(*this);
+            if(m_State == STATE_COLLECTING)
+                m_State = STATE_DYNAMIC;
+        }
+
+        // Called with the keys of an instance that has finished its setup.
+        // The table is ready if it holds exactly those keys.
+        template<class Iter>
+        void Finish(Iter first, Iter last)
+        {
+            if(m_State != STATE_COLLECTING)
+                return;
+            Lock lock(*this);
+            if(m_State != STATE_COLLECTING)
+                return;
+
+            size_t n = 0;
+            for(; first != last; ++first, ++n)
+            {
+                if(!FindSorted(first->first))
+                {
+                    m_State = STATE_DYNAMIC;
+                    return;
+                }
+            }
+            if(n != m_Fields.size())
+            {
+                m_State = STATE_DYNAMIC;
+                return;
+            }
+            BuildHash();
+            m_State = STATE_READY;
+        }
+
+        // Sorted by name, the order the per instance map dumps in.
+        const std::vector<CField>& GetFields() const { return m_Fields; }
+
+        // key does not need to be nul terminated.
+        const CField* Find(const char* key, size_t length) const
+        {
+            if(m_Slots.empty())
+                return FindSorted(std::string(key, length));
+
+            uint32_t slot = m_Slots[Hash(key, length, m_Seed) & m_Mask];
+            if(slot == 0)
+                return NULL;
+            const CField& field = m_Fields[slot - 1];
+            if(field.name.size() == length && memcmp(field.name.data(), key, length) == 0)
+                return &field;
+            return NULL;
+        }
+
+    private:
+        const CField* FindSorted(const std::string& name) const
+        {
+            std::vector<CField>::const_iterator iter = std::lower_bound(m_Fields.begin(), m_Fields.end(), name, NameLess());
+            if(iter != m_Fields.end() && iter->name == name)
+                return &(*iter);
+            return NULL;
+        }
+
+        // FNV-1a with the seed mixed into the start value.
+        static uint32_t Hash(const char* key, size_t length, uint32_t seed)
+        {
+            uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+            for(size_t i = 0; i < length; i++)
+            {
+                h ^= (unsigned char)key[i];
+                h *= 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+
+        // Tries seeds until no two keys share a slot, doubling the slots
+        // (starting at twice the number of keys) when that takes too long.
+        // If it still fails Find falls back to a binary search.
+        void BuildHash()
+        {
+            m_Slots.clear();
+            size_t size = 8;
+            while(size < m_Fields.size() * 2)
+                size *= 2;
+
+            for(; size <= (size_t(1) << 20); size *= 2)
+            {
+                for(uint32_t seed = 1; seed <= 256; seed++)
+                {
+                    m_Slots.assign(size, 0);
+                    size_t i = 0;
+                    for(; i < m_Fields.size(); i++)
+                    {
+                        uint32_t& slot = m_Slots[Hash(m_Fields[i].name.data(), m_Fields[i].name.size(), seed) & (size - 1)];
+                        if(slot != 0)
+                            break;
+                        slot = uint32_t(i + 1);
+                    }
+                    if(i == m_Fields.size())
+                    {
+                        m_Seed = seed;
+                        m_Mask = uint32_t(size - 1);
+                        return;
+                    }
+                }
+            }
+            m_Slots.clear();
+        }
+
+        struct NameLess
+        {
+            bool operator()(const CField& field, const std::string& name) const { return field.name < name; }
+        };
+
+    #if __cplusplus >= 201103L
+        struct Lock
+        {
+            Lock(CJSONFieldTable& table) : guard(table.m_Mutex) {}
+            std::lock_guard<std::mutex> guard;
+        };
+        std::mutex              m_Mutex;
+        std::atomic<int>        m_State;
+    #else
+        struct Lock { Lock(CJSONFieldTable&) {} };
+        int                     m_State;
+    #endif
+        std::vector<CField>     m_Fields;   // only changes while collecting.
+        std::vector<uint32_t>   m_Slots;    // index into m_Fields + 1, 0 for an empty slot.
+        uint32_t                m_Seed;
+        uint32_t                m_Mask;
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+//
+//  json_mapped_file.h
+//
+//  Read only memory mapping of a file for the streaming parse mode. The
+//  pages come straight from the page cache so nothing is copied until the
+//  values are stored in the bound members, and processes that load the
+//  same file share those pages.
+//
+//  The file must not be truncated while it is mapped.
+//
+
+#ifndef JSON_MAPPED_FILE_H
+#define JSON_MAPPED_FILE_H
+
+#include <string>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define JSON_HAS_MMAP
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace json {
+
+class CJSONMappedFile
+{
+    public:
+        CJSONMappedFile() : m_pData(NULL), m_Size(0) {}
+        ~CJSONMappedFile() { Close(); }
+
+        // Maps the whole file. On failure errno is left set for the caller.
+        bool Open(const std::string& Path)
+        {
+            Close();
+        #ifdef JSON_HAS_MMAP
+            int fd = open(Path.c_str(), O_RDONLY);
+            if(fd < 0)
+                return false;
+
+            struct stat info;
+            if(fstat(fd, &info) != 0)
+            {
+                int err = errno;
+                close(fd);
+                errno = err;
+                return false;
+            }
+
+            m_Size = size_t(info.st_size);
+            if(m_Size > 0)
+            {
+                void* pMap = mmap(NULL, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(pMap == MAP_FAILED)
+                {
+                    int err = errno;
+                    close(fd);
+                    m_Size = 0;
+                    errno = err;
+                    return false;
+                }
+                m_pData = (const char*)pMap;
+                madvise(pMap, m_Size, MADV_SEQUENTIAL); // only a hint, ignore failures.
+            }
+            close(fd); // the mapping keeps its own reference.
+            return true;
+        #else
+            (void)Path;
+            errno = ENOSYS;
+            return false;
+        #endif
+        }
+
+        void Close()
+        {
+        #ifdef JSON_HAS_MMAP
+            if(m_pData)
+                munmap((void*)m_pData, m_Size);
+        #endif
+            m_pData = NULL;
+            m_Size = 0;
+        }
+
+        static bool IsSupported()
+        {
+        #ifdef JSON_HAS_MMAP
+            return true;
+        #else
+            return false;
+        #endif
+        }
+
+        const char* GetData() const { return m_pData ? m_pData : ""; }
+        size_t GetSize() const { return m_Size; }
+
+    private:
+        // owns a mapping, do not copy.
+        CJSONMappedFile(const CJSONMappedFile&);
+        CJSONMappedFile& operator=(const CJSONMappedFile&);
+
+    private:
+        const char*     m_pData;
+        size_t          m_Size;
+};
+
+}
+
+#endif
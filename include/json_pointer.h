@@ -0,0 +1,73 @@
+//
+//  json_pointer.h
+//
+//  JSON Pointer (RFC 6901) paths for the partial parse of CJSONParser:
+//  "/indent/length" is the member length of the member indent of the root,
+//  "/ObjectArray/3" the fourth element of the array ObjectArray and ""
+//  the whole document. In a token "~1" stands for '/' and "~0" for '~'.
+//
+
+#ifndef JSON_POINTER_H
+#define JSON_POINTER_H
+
+#include <string>
+#include <vector>
+
+namespace json {
+
+class CJSONPointer
+{
+    public:
+        // Splits pointer into its unescaped tokens. false if it is not a
+        // pointer: it does not start with '/' or has a '~' not followed by
+        // '0' or '1'.
+        static bool Split(const std::string& pointer, std::vector<std::string>& tokens)
+        {
+            tokens.clear();
+            if(pointer.empty())
+                return true;
+            if(pointer[0] != '/')
+                return false;
+
+            std::string token;
+            for(size_t i = 1; i <= pointer.size(); i++)
+            {
+                if(i == pointer.size() || pointer[i] == '/')
+                {
+                    tokens.push_back(token);
+                    token.clear();
+                }
+                else if(pointer[i] == '~')
+                {
+                    if(i + 1 == pointer.size() || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+                        return false;
+                    token += (pointer[++i] == '0') ? '~' : '/';
+                }
+                else
+                {
+                    token += pointer[i];
+                }
+            }
+            return true;
+        }
+
+        // The array index a token stands for: digits without a leading zero.
+        // "-" (past the end) and anything else are not an element.
+        static bool ToIndex(const std::string& token, size_t& index)
+        {
+            if(token.empty() || token.size() > 19 || (token[0] == '0' && token.size() > 1))
+                return false;
+            index = 0;
+            for(size_t i = 0; i < token.size(); i++)
+            {
+                if(token[i] < '0' || token[i] > '9')
+                    return false;
+                index = index * 10 + size_t(token[i] - '0');
+            }
+            return true;
+        }
+};
+
+}
+
+#endif
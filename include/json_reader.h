@@ -0,0 +1,1519 @@
+//
+//  json_reader.h
+//
+//  Pull style tokenizer used by the streaming (DOM-free) parse mode of
+//  CJSONParser. The CJSONValue classes walk the text through this class
+//  and write straight into the bound members, so no jansson tree is
+//  built for the values that have a binding.
+//
+//  With JSON_FORMAT_CBOR the reader walks CBOR (see json_cbor.h) through
+//  the same calls. Typed arrays read as arrays of numbers, other tags are
+//  skipped, byte strings and simple values other than false, true and null
+//  are errors.
+//
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <jansson.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "json_structural_index.h"
+#include "json_number.h"
+#include "json_cbor.h"
+#include "json_utf8.h"
+
+#if __cplusplus >= 201103L
+    #include <atomic>
+#endif
+
+namespace json {
+
+class CJSONThreadPool; // json_thread_pool.h
+
+// jansson does not limit the nesting but we recurse when building
+// values for m_MissingValues so put a cap on it.
+#define JSON_READER_MAX_DEPTH 2048
+
+// Whether a text is still the one a reader was made over. The owner of
+// the text (a CJSONParser) makes one per text and invalidates it when the
+// text is replaced or freed; whoever keeps a CJSONReader::CSource past the
+// read takes a reference, so it can ask after the owner is gone.
+class CJSONTextToken
+{
+    public:
+        // The owner's reference.
+        CJSONTextToken() : m_Refs(1), m_bValid(true) {}
+
+        static CJSONTextToken* AddRef(CJSONTextToken* pToken)
+        {
+            if(pToken)
+                pToken->m_Refs++;
+            return pToken;
+        }
+
+        static void Release(CJSONTextToken* pToken)
+        {
+            if(pToken && --pToken->m_Refs == 0)
+                delete pToken;
+        }
+
+        bool IsValid() const { return m_bValid; }
+        void Invalidate() { m_bValid = false; }
+
+        // Referenced by more than the owner, which may reuse it otherwise.
+        bool IsShared() const { return m_Refs > 1; }
+
+    private:
+        CJSONTextToken(const CJSONTextToken&);
+        CJSONTextToken& operator=(const CJSONTextToken&);
+
+    #if __cplusplus >= 201103L
+        std::atomic<size_t>     m_Refs;     // lazy objects parsed on the thread pool take them too.
+        std::atomic<bool>       m_bValid;
+    #else
+        size_t                  m_Refs;
+        bool                    m_bValid;
+    #endif
+};
+
+class CJSONReader
+{
+    public:
+        // pIndex is optional. When given it must have been built from the
+        // same text and the reader uses it to go from token to token. There
+        // is no index for CBOR.
+        CJSONReader(const char* pBuffer, size_t size, const CJSONStructuralIndex* pIndex = NULL, CJSONFormat format = JSON_FORMAT_TEXT) : m_pStart(pBuffer), m_pCur(pBuffer), m_pEnd(pBuffer + size), m_Prev(0), m_bError(false), m_pIndex(NULL), m_Chunk(NO_CHUNK), m_Next(0), m_pThreadPool(NULL), m_Format(format), m_pKeyBuffer(NULL), m_pTokenBuffer(NULL), m_bBorrowedTokens(false), m_pTextToken(NULL)
+        {
+            if(pIndex && !pIndex->IsEmpty() && format == JSON_FORMAT_TEXT)
+                m_pIndex = pIndex;
+            ClearError();
+        }
+
+        // A copy reads on from the same place, to look ahead. Until it goes
+        // on to another chunk it reads the tokens listed by the original, so
+        // it must be done with before the original reads on.
+        CJSONReader(const CJSONReader& src) : m_pStart(src.m_pStart), m_pCur(src.m_pCur), m_pEnd(src.m_pEnd), m_Prev(src.m_Prev), m_bError(src.m_bError), m_Error(src.m_Error), m_pIndex(src.m_pIndex), m_Chunk(src.m_Chunk), m_Next(src.m_Next), m_pThreadPool(src.m_pThreadPool), m_Format(src.m_Format), m_Levels(src.m_Levels), m_Key(src.m_Key), m_pKeyBuffer(src.m_pKeyBuffer), m_pTokenBuffer(const_cast<std::vector<uint32_t>*>(&src.GetTokens())), m_bBorrowedTokens(true), m_pTextToken(src.m_pTextToken)
+        {
+        }
+
+        // Reader over the byte range [begin, end) of the parent's text, which
+        // must hold exactly one value. It shares the parent's index and
+        // reports errors at positions in the whole text. Used to parse array
+        // elements on other threads; the thread pool is not passed on.
+        CJSONReader(const CJSONReader& parent, size_t begin, size_t end) : m_pStart(parent.m_pStart), m_pCur(parent.m_pStart + begin), m_pEnd(parent.m_pStart + end), m_Prev(0), m_bError(false), m_pIndex(parent.m_pIndex), m_Chunk(NO_CHUNK), m_Next(0), m_pThreadPool(NULL), m_Format(parent.m_Format), m_pKeyBuffer(NULL), m_pTokenBuffer(NULL), m_bBorrowedTokens(false), m_pTextToken(parent.m_pTextToken)
+        {
+            ClearError();
+        }
+
+        // What is needed to read a value of the text again later with the
+        // constructor below. Valid as long as the text and its index are,
+        // which pToken tells when the text has an owner that made one.
+        struct CSource
+        {
+            const char*                     pStart;
+            size_t                          size;
+            const CJSONStructuralIndex*     pIndex;
+            CJSONFormat                     format;
+            CJSONTextToken*                 pToken;     // not referenced, NULL if there is none.
+        };
+
+        // Like the one above, over [begin, end) of the source's text.
+        CJSONReader(const CSource& source, size_t begin, size_t end) : m_pStart(source.pStart), m_pCur(source.pStart + begin), m_pEnd(source.pStart + end), m_Prev(0), m_bError(false), m_pIndex(source.pIndex), m_Chunk(NO_CHUNK), m_Next(0), m_pThreadPool(NULL), m_Format(source.format), m_pKeyBuffer(NULL), m_pTokenBuffer(NULL), m_bBorrowedTokens(false), m_pTextToken(source.pToken)
+        {
+            ClearError();
+        }
+
+        ~CJSONReader() {}
+
+    // Inspection
+        // Type of the next value without consuming it. Both JSON_TRUE and
+        // JSON_FALSE are reported, numbers are JSON_INTEGER unless they have
+        // a fraction or exponent.
+        bool Peek(json_type& type)
+        {
+            if(m_bError)
+                return false;
+            if(IsCbor())
+                return CborPeek(type);
+
+            SkipWhitespace();
+            if(m_pCur >= m_pEnd)
+                return SetError("unexpected end of input");
+
+            switch(*m_pCur)
+            {
+                case '{': type = JSON_OBJECT; return true;
+                case '[': type = JSON_ARRAY; return true;
+                case '"': type = JSON_STRING; return true;
+                case 't': type = JSON_TRUE; return true;
+                case 'f': type = JSON_FALSE; return true;
+                case 'n': type = JSON_NULL; return true;
+                default: break;
+            }
+
+            const char* pEnd = NULL;
+            bool bReal = false;
+            if(ScanNumber(pEnd, bReal))
+            {
+                type = bReal ? JSON_REAL : JSON_INTEGER;
+                return true;
+            }
+            return SetError("invalid token");
+        }
+
+        // true once only whitespace is left. Used for the end of file check.
+        bool AtEnd()
+        {
+            if(IsCbor())
+                return m_pCur >= m_pEnd;
+            SkipWhitespace();
+            return m_pCur >= m_pEnd;
+        }
+
+        bool HasError() const { return m_bError; }
+        const json_error_t& GetError() const { return m_Error; }
+        size_t GetPosition() const { return size_t(m_pCur - m_pStart); }
+        CJSONFormat GetFormat() const { return m_Format; }
+        CSource GetSource() const
+        {
+            CSource source = { m_pStart, size_t(m_pEnd - m_pStart), m_pIndex, m_Format, m_pTextToken };
+            return source;
+        }
+        bool IsCbor() const { return m_Format == JSON_FORMAT_CBOR; }
+
+        // Pool for parsing large arrays of objects in parallel, NULL for serial.
+        CJSONThreadPool* GetThreadPool() const { return m_pThreadPool; }
+        void SetThreadPool(CJSONThreadPool* pPool) { m_pThreadPool = pPool; }
+
+        // Scratch for the keys of the objects being parsed, it only has to
+        // hold one key at a time. A CJSONParser lends its own so that it is
+        // allocated once for all the documents it loads rather than once per
+        // object; the reader's own is used otherwise.
+        std::string& GetKeyBuffer() { return m_pKeyBuffer ? *m_pKeyBuffer : m_Key; }
+        void SetKeyBuffer(std::string* pKey) { m_pKeyBuffer = pKey; }
+
+        // Where the offsets of the tokens of the current chunk are listed,
+        // so a parser reading many documents keeps it. No other reader may
+        // use it while this one does.
+        void SetTokenBuffer(std::vector<uint32_t>* pTokens) { m_pTokenBuffer = pTokens; }
+
+        // The token of the text, passed on to the readers made from this
+        // one and to GetSource. Not owned.
+        CJSONTextToken* GetTextToken() const { return m_pTextToken; }
+        void SetTextToken(CJSONTextToken* pToken) { m_pTextToken = pToken; }
+
+    // Containers
+        bool BeginObject()
+        {
+            if(IsCbor())
+                return CborBeginContainer(CJSONCbor::MAJOR_MAP, "'{' expected");
+            if(!Expect('{', "'{' expected"))
+                return false;
+            m_Prev = '{';
+            return true;
+        }
+
+        // Reads the next key of the current object and the ':' after it.
+        // Returns false at the closing '}' (which is consumed) or on error.
+        bool NextKey(std::string& key)
+        {
+            if(IsCbor())
+                return CborNextItem('{', "'}' expected") && CborReadText(key, "string or '}' expected");
+            if(!NextItem('}', "'}' expected"))
+                return false;
+
+            SkipWhitespace();
+            if(m_pCur >= m_pEnd || *m_pCur != '"')
+                return SetError("string or '}' expected");
+
+            if(!ScanString(key))
+                return false;
+
+            if(!Expect(':', "':' expected"))
+                return false;
+            m_Prev = ':';
+            return true;
+        }
+
+        bool BeginArray()
+        {
+            if(IsCbor())
+                return CborBeginContainer(CJSONCbor::MAJOR_ARRAY, "'[' expected");
+            if(!Expect('[', "'[' expected"))
+                return false;
+            m_Prev = '[';
+            return true;
+        }
+
+        // Positions the reader on the next element of the current array.
+        // Returns false at the closing ']' (which is consumed) or on error.
+        bool NextElement()
+        {
+            if(IsCbor())
+                return CborNextItem('[', "']' expected");
+            return NextItem(']', "']' expected");
+        }
+
+        // true when the next value is a CBOR typed array of T in host byte
+        // order, which ReadTypedArray copies in one go.
+        template<class T>
+        bool IsTypedArrayOf()
+        {
+            if(!IsCbor() || !CJSONCborTypedArray<T>::value || m_bError || InTypedArray() || !CborSkipTags())
+                return false;
+            int major = 0;
+            uint64_t tag = 0;
+            bool bIndefinite = false;
+            const char* pNext = NULL;
+            return CborDecodeHead(m_pCur, major, tag, bIndefinite, pNext) && major == CJSONCbor::MAJOR_TAG && tag == CJSONCbor::TypedArrayTag<T>();
+        }
+
+        // Appends the elements of the typed array to values.
+        template<class T>
+        bool ReadTypedArray(std::vector<T>& values)
+        {
+            if(!IsTypedArrayOf<T>())
+                return SetError("typed array expected");
+            uint64_t length = 0;
+            CJSONCbor::CElementType element;
+            if(!CborBeginTypedArray(length, element))
+                return false;
+
+            size_t count = size_t(length / sizeof(T));
+            size_t first = values.size();
+            values.resize(first + count);
+            if(count > 0)
+                memcpy(&values[first], m_pCur, count * sizeof(T));
+            if(!std::numeric_limits<T>::is_integer)
+            {
+                for(size_t i = first; i < values.size(); i++)
+                {
+                    if(!std::isfinite(double(values[i])))
+                        return SetError("nan or inf is not a number");
+                }
+            }
+            m_pCur += count * sizeof(T);
+            return true;
+        }
+
+    // Values
+        bool ReadNull()
+        {
+            if(IsCbor())
+                return CborReadSimple(CJSONCbor::SIMPLE_NULL, CJSONCbor::SIMPLE_NULL) >= 0;
+            if(!ReadLiteral("null", 4))
+                return false;
+            m_Prev = 'v';
+            return true;
+        }
+
+        bool ReadBool(bool& value)
+        {
+            if(m_bError)
+                return false;
+            if(IsCbor())
+            {
+                int simple = CborReadSimple(CJSONCbor::SIMPLE_FALSE, CJSONCbor::SIMPLE_TRUE);
+                value = (simple == CJSONCbor::SIMPLE_TRUE);
+                return simple >= 0;
+            }
+            SkipWhitespace();
+            if(m_pCur < m_pEnd && *m_pCur == 't')
+            {
+                value = true;
+                if(!ReadLiteral("true", 4))
+                    return false;
+            }
+            else
+            {
+                value = false;
+                if(!ReadLiteral("false", 5))
+                    return false;
+            }
+            m_Prev = 'v';
+            return true;
+        }
+
+        // Integer tokens are read as json_int_t and reported the same way
+        // jansson would (too big integer). Reals go through CJSONNumber.
+        bool ReadInteger(json_int_t& value)
+        {
+            if(IsCbor())
+            {
+                bool bNegative = false;
+                uint64_t magnitude = 0;
+                return CborReadInteger(bNegative, magnitude) && MagnitudeToInteger(bNegative, magnitude, value);
+            }
+            bool bReal = false;
+            const char* pEnd = NULL;
+            if(!BeginNumber(pEnd, bReal))
+                return false;
+            if(bReal)
+                return SetError("integer expected");
+            if(!ConvertInteger(m_pCur, pEnd, value))
+                return false;
+            m_pCur = pEnd;
+            m_Prev = 'v';
+            return true;
+        }
+
+        // An integer token as sign and magnitude, so the caller can check
+        // it against the range of its own type. Magnitudes up to 2^64-1
+        // are read, above json_int_t too.
+        bool ReadInteger(bool& bNegative, uint64_t& magnitude)
+        {
+            if(IsCbor())
+                return CborReadInteger(bNegative, magnitude);
+            bool bReal = false;
+            const char* pEnd = NULL;
+            if(!BeginNumber(pEnd, bReal))
+                return false;
+            if(bReal)
+                return SetError("integer expected");
+            if(!ConvertMagnitude(m_pCur, pEnd, bNegative, magnitude))
+                return false;
+            m_pCur = pEnd;
+            m_Prev = 'v';
+            return true;
+        }
+
+        bool ReadNumber(double& value, bool* pIsReal = NULL)
+        {
+            if(IsCbor())
+                return CborReadNumber(value, pIsReal);
+            bool bReal = false;
+            const char* pEnd = NULL;
+            if(!BeginNumber(pEnd, bReal))
+                return false;
+            if(bReal)
+            {
+                if(!ConvertReal(m_pCur, pEnd, value))
+                    return false;
+            }
+            else
+            {
+                json_int_t i = 0;
+                if(!ConvertInteger(m_pCur, pEnd, i))
+                    return false;
+                value = double(i); // same as json_number_value()
+            }
+            if(pIsReal)
+                *pIsReal = bReal;
+            m_pCur = pEnd;
+            m_Prev = 'v';
+            return true;
+        }
+
+        bool ReadString(std::string& value)
+        {
+            if(m_bError)
+                return false;
+            if(IsCbor())
+                return CborReadText(value, "string expected");
+            SkipWhitespace();
+            if(m_pCur >= m_pEnd || *m_pCur != '"')
+                return SetError("string expected");
+            if(!ScanString(value))
+                return false;
+            m_Prev = 'v';
+            return true;
+        }
+
+        // Skips the next value, whatever it is. Does not allocate.
+        bool SkipValue()
+        {
+            if(IsCbor())
+                return CborSkipValue(0);
+
+            json_type type;
+            if(!Peek(type))
+                return false;
+
+            if(type != JSON_OBJECT && type != JSON_ARRAY)
+                return SkipScalar(type);
+
+            // Containers are skipped iteratively. One bit per level records
+            // whether it is an object so we know when a string is a key.
+            unsigned char objects[JSON_READER_MAX_DEPTH / 8];
+            size_t depth = 0;
+            do
+            {
+                SkipWhitespace();
+                if(m_pCur >= m_pEnd)
+                    return SetError("unexpected end of input");
+
+                char c = *m_pCur;
+                bool bInObject = depth > 0 && (objects[(depth - 1) / 8] & (1 << ((depth - 1) % 8)));
+                if(c == '{' || c == '[')
+                {
+                    if(m_Prev == 'v' || (bInObject && m_Prev != ':'))
+                        return SetError("',' expected");
+                    if(depth >= JSON_READER_MAX_DEPTH)
+                        return SetError("maximum parsing depth reached");
+                    if(c == '{')
+                        objects[depth / 8] |= (unsigned char)(1 << (depth % 8));
+                    else
+                        objects[depth / 8] &= (unsigned char)~(1 << (depth % 8));
+                    depth++;
+                    m_Prev = c;
+                    m_pCur++;
+                }
+                else if(c == '}' || c == ']')
+                {
+                    if(bInObject != (c == '}') || (m_Prev != 'v' && m_Prev != '{' && m_Prev != '['))
+                        return SetError(bInObject ? "'}' expected" : "']' expected");
+                    depth--;
+                    m_Prev = 'v';
+                    m_pCur++;
+                }
+                else if(c == ',')
+                {
+                    if(m_Prev != 'v')
+                        return SetError("value expected");
+                    m_Prev = ',';
+                    m_pCur++;
+                }
+                else if(m_Prev == 'v')
+                {
+                    return SetError(bInObject ? "'}' expected" : "']' expected");
+                }
+                else if(bInObject && m_Prev != ':')
+                {
+                    if(c != '"')
+                        return SetError("string or '}' expected");
+                    if(!SkipString() || !Expect(':', "':' expected"))
+                        return false;
+                    m_Prev = ':';
+                }
+                else
+                {
+                    json_type inner;
+                    if(!Peek(inner) || !SkipScalar(inner))
+                        return false;
+                }
+            } while(depth > 0);
+
+            return true;
+        }
+
+        // Builds a jansson value for the next value in the text. Used for
+        // data that has no binding (m_MissingValues) and for CJSONValue
+        // classes that do not implement the streaming parse. Caller owns
+        // the returned reference.
+        json_t* ReadValue(size_t depth = 0)
+        {
+            json_type type;
+            if(!Peek(type))
+                return NULL;
+
+            if(depth > JSON_READER_MAX_DEPTH)
+            {
+                SetError("maximum parsing depth reached");
+                return NULL;
+            }
+
+            json_t* pRet = NULL;
+            switch(type)
+            {
+                case JSON_OBJECT:
+                {
+                    if(!BeginObject())
+                        return NULL;
+                    pRet = json_object();
+                    std::string key;
+                    while(NextKey(key))
+                    {
+                        json_t* pVal = ReadValue(depth + 1);
+                        if(!pVal)
+                            break;
+                        json_object_set_new(pRet, key.c_str(), pVal);
+                    }
+                    break;
+                }
+                case JSON_ARRAY:
+                {
+                    if(!BeginArray())
+                        return NULL;
+                    pRet = json_array();
+                    while(NextElement())
+                    {
+                        json_t* pVal = ReadValue(depth + 1);
+                        if(!pVal)
+                            break;
+                        json_array_append_new(pRet, pVal);
+                    }
+                    break;
+                }
+                case JSON_STRING:
+                {
+                    std::string value;
+                    if(ReadString(value))
+                        pRet = json_string(value.c_str());
+                    break;
+                }
+                case JSON_INTEGER:
+                {
+                    json_int_t value = 0;
+                    if(ReadInteger(value))
+                        pRet = json_integer(value);
+                    break;
+                }
+                case JSON_REAL:
+                {
+                    double value = 0;
+                    if(ReadNumber(value))
+                        pRet = json_real(value);
+                    break;
+                }
+                case JSON_TRUE:
+                case JSON_FALSE:
+                {
+                    bool value = false;
+                    if(ReadBool(value))
+                        pRet = value ? json_true() : json_false();
+                    break;
+                }
+                case JSON_NULL:
+                {
+                    if(ReadNull())
+                        pRet = json_null();
+                    break;
+                }
+            }
+
+            if(m_bError)
+            {
+                json_decref(pRet);
+                pRet = NULL;
+            }
+            return pRet;
+        }
+
+        // Records a parse error at the current position. Always returns false.
+        bool SetError(const char* text)
+        {
+            if(m_bError) // keep the first error.
+                return false;
+
+            m_bError = true;
+            int line = 1, column = IsCbor() ? int(m_pCur - m_pStart) : 0; // CBOR has no lines.
+            for(const char* p = m_pStart; !IsCbor() && p < m_pCur && p < m_pEnd; p++)
+            {
+                if(*p == '\n')
+                {
+                    line++;
+                    column = 0;
+                }
+                else
+                {
+                    column++;
+                }
+            }
+            m_Error.line = line;
+            m_Error.column = column;
+            m_Error.position = int(m_pCur - m_pStart);
+            snprintf(m_Error.source, sizeof(m_Error.source), "<stream>");
+            snprintf(m_Error.text, sizeof(m_Error.text), "%s", text);
+            return false;
+        }
+
+        // Takes the error from another reader, e.g. one made for an element.
+        bool SetError(const json_error_t& error)
+        {
+            if(m_bError)
+                return false;
+            m_bError = true;
+            m_Error = error;
+            return false;
+        }
+
+    private:
+        void ClearError()
+        {
+            m_Error.line = -1;
+            m_Error.column = -1;
+            m_Error.position = 0;
+            m_Error.source[0] = '\0';
+            m_Error.text[0] = '\0';
+        }
+
+        void SkipWhitespace()
+        {
+            if(m_pIndex)
+            {
+                // Every non whitespace character that follows whitespace is
+                // in the index so we can jump to the next entry. When we are
+                // not on whitespace (e.g. "12x") stay and let the caller fail.
+                const std::vector<uint32_t>& tokens = GetTokens();
+                size_t offset = size_t(m_pCur - m_pStart);
+                while(m_Next < tokens.size() && tokens[m_Next] < offset)
+                    m_Next++;
+                bool bToken = m_Next < tokens.size() || SeekChunk(offset);
+                if(m_pCur < m_pEnd && IsWhitespace(*m_pCur))
+                    m_pCur = bToken ? std::min(m_pStart + tokens[m_Next], m_pEnd) : m_pEnd;
+                return;
+            }
+
+            while(m_pCur < m_pEnd && IsWhitespace(*m_pCur))
+                m_pCur++;
+        }
+
+        std::vector<uint32_t>& GetTokens() { return m_pTokenBuffer ? *m_pTokenBuffer : m_Tokens; }
+        const std::vector<uint32_t>& GetTokens() const { return m_pTokenBuffer ? *m_pTokenBuffer : m_Tokens; }
+
+        // The tokens listed are all before offset: lists those of the chunk
+        // of offset, or of the following ones, until one is at or after it.
+        // false if there is none.
+        bool SeekChunk(size_t offset)
+        {
+            if(m_bBorrowedTokens)
+            {
+                m_pTokenBuffer = NULL;
+                m_bBorrowedTokens = false;
+            }
+            std::vector<uint32_t>& tokens = GetTokens();
+            size_t chunk = offset / JSON_STRUCTURAL_INDEX_CHUNK;
+            if(m_Chunk != NO_CHUNK && chunk <= m_Chunk)
+                chunk = m_Chunk + 1;
+            for(; chunk < m_pIndex->GetChunkCount(); chunk++)
+            {
+                m_pIndex->ScanChunk(chunk, tokens);
+                m_Chunk = chunk;
+                m_Next = size_t(std::lower_bound(tokens.begin(), tokens.end(), uint32_t(offset)) - tokens.begin());
+                if(m_Next < tokens.size())
+                    return true;
+            }
+            tokens.clear();
+            m_Next = 0;
+            return false;
+        }
+
+        // With an index the entry after an opening quote is its closing
+        // quote. Returns NULL when that is not known, e.g. the string goes
+        // on in the next chunk.
+        const char* IndexedStringEnd() const
+        {
+            const std::vector<uint32_t>& tokens = GetTokens();
+            if(m_pIndex && m_Next + 1 < tokens.size() && m_pStart + tokens[m_Next] == m_pCur)
+            {
+                const char* pClose = m_pStart + tokens[m_Next + 1];
+                if(*pClose == '"')
+                    return pClose;
+            }
+            return NULL;
+        }
+
+        bool Expect(char c, const char* text)
+        {
+            if(m_bError)
+                return false;
+            SkipWhitespace();
+            if(m_pCur >= m_pEnd || *m_pCur != c)
+                return SetError(text);
+            m_pCur++;
+            return true;
+        }
+
+        // Handles the ',' between items and the closing bracket. m_Prev is the
+        // last token class seen: '{' or '[' right after an open, 'v' after a
+        // value, ',' and ':' after those characters.
+        bool NextItem(char close, const char* text)
+        {
+            if(m_bError)
+                return false;
+
+            SkipWhitespace();
+            if(m_pCur >= m_pEnd)
+                return SetError(text);
+
+            if(*m_pCur == close && (m_Prev == '{' || m_Prev == '[' || m_Prev == 'v'))
+            {
+                m_pCur++;
+                m_Prev = 'v'; // the container is now a complete value.
+                return false;
+            }
+
+            if(m_Prev == 'v')
+            {
+                if(*m_pCur != ',')
+                    return SetError(text);
+                m_pCur++;
+                m_Prev = ',';
+            }
+            else if(m_Prev != '{' && m_Prev != '[')
+            {
+                return SetError(text);
+            }
+            return true;
+        }
+
+        bool SkipScalar(json_type type)
+        {
+            switch(type)
+            {
+                case JSON_STRING:
+                    if(!SkipString())
+                        return false;
+                    break;
+                case JSON_TRUE:
+                    if(!ReadLiteral("true", 4))
+                        return false;
+                    break;
+                case JSON_FALSE:
+                    if(!ReadLiteral("false", 5))
+                        return false;
+                    break;
+                case JSON_NULL:
+                    if(!ReadLiteral("null", 4))
+                        return false;
+                    break;
+                default:
+                {
+                    const char* pEnd = NULL;
+                    bool bReal = false;
+                    if(!ScanNumber(pEnd, bReal))
+                        return SetError("invalid token");
+                    m_pCur = pEnd;
+                    break;
+                }
+            }
+            m_Prev = 'v';
+            return true;
+        }
+
+        bool ReadLiteral(const char* literal, size_t len)
+        {
+            if(m_bError)
+                return false;
+            SkipWhitespace();
+            if(size_t(m_pEnd - m_pCur) < len || strncmp(m_pCur, literal, len) != 0)
+                return SetError("invalid token");
+            m_pCur += len;
+            return true;
+        }
+
+        bool BeginNumber(const char*& pEnd, bool& bReal)
+        {
+            if(m_bError)
+                return false;
+            SkipWhitespace();
+            if(!ScanNumber(pEnd, bReal))
+                return SetError("number expected");
+            return true;
+        }
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        bool ScanNumber(const char*& pEnd, bool& bReal) const
+        {
+            const char* p = m_pCur;
+            bReal = false;
+            if(p < m_pEnd && *p == '-')
+                p++;
+            if(p >= m_pEnd || !IsDigit(*p))
+                return false;
+            if(*p == '0')
+                p++;
+            else
+                while(p < m_pEnd && IsDigit(*p)) p++;
+
+            if(p < m_pEnd && *p == '.')
+            {
+                bReal = true;
+                p++;
+                if(p >= m_pEnd || !IsDigit(*p))
+                    return false;
+                while(p < m_pEnd && IsDigit(*p)) p++;
+            }
+
+            if(p < m_pEnd && (*p == 'e' || *p == 'E'))
+            {
+                bReal = true;
+                p++;
+                if(p < m_pEnd && (*p == '+' || *p == '-'))
+                    p++;
+                if(p >= m_pEnd || !IsDigit(*p))
+                    return false;
+                while(p < m_pEnd && IsDigit(*p)) p++;
+            }
+            pEnd = p;
+            return true;
+        }
+
+        // The digits are added up in place. Up to 19 of them can not
+        // overflow a uint64_t so only longer tokens are checked per digit.
+        bool ConvertMagnitude(const char* pBegin, const char* pEnd, bool& bNegative, uint64_t& magnitude)
+        {
+            const char* p = pBegin;
+            bNegative = (*p == '-');
+            if(bNegative)
+                p++;
+
+            uint64_t value = 0;
+            if(pEnd - p <= 19)
+            {
+                for(; p < pEnd; p++)
+                    value = value * 10 + uint64_t(*p - '0');
+            }
+            else
+            {
+                for(; p < pEnd; p++)
+                {
+                    uint64_t digit = uint64_t(*p - '0');
+                    if(value > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+                        return SetError("too big integer");
+                    value = value * 10 + digit;
+                }
+            }
+            magnitude = value;
+            return true;
+        }
+
+        bool ConvertInteger(const char* pBegin, const char* pEnd, json_int_t& value)
+        {
+            bool bNegative = false;
+            uint64_t magnitude = 0;
+            return ConvertMagnitude(pBegin, pEnd, bNegative, magnitude) && MagnitudeToInteger(bNegative, magnitude, value);
+        }
+
+        bool MagnitudeToInteger(bool bNegative, uint64_t magnitude, json_int_t& value)
+        {
+            const uint64_t max = uint64_t(std::numeric_limits<json_int_t>::max());
+            if(magnitude > max + (bNegative ? 1 : 0))
+                return SetError("too big integer");
+            if(bNegative && magnitude > 0)
+                value = -json_int_t(magnitude - 1) - 1; // -2^63 has no positive.
+            else
+                value = json_int_t(magnitude);
+            return true;
+        }
+
+        bool ConvertReal(const char* pBegin, const char* pEnd, double& value)
+        {
+            if(!CJSONNumber::ParseDouble(pBegin, pEnd, value))
+                return SetError("real number overflow");
+            return true;
+        }
+
+        // m_pCur is on the opening quote. Decodes into value.
+        bool ScanString(std::string& value)
+        {
+            const char* pClose = IndexedStringEnd();
+            if(pClose && !memchr(m_pCur + 1, '\\', size_t(pClose - m_pCur - 1)))
+            {
+                // No escapes, and the index build already rejected control
+                // characters, so the bytes can be taken as they are.
+                value.assign(m_pCur + 1, pClose);
+                m_pCur = pClose + 1;
+                if(!CJSONUTF8::IsValid(value))
+                    return SetError("unable to decode byte in string");
+                return true;
+            }
+
+            value.clear();
+            m_pCur++;
+            for(;;)
+            {
+                const char* pChunk = m_pCur;
+                while(m_pCur < m_pEnd && *m_pCur != '"' && *m_pCur != '\\' && (unsigned char)(*m_pCur) >= 0x20)
+                    m_pCur++;
+                value.append(pChunk, m_pCur);
+
+                if(m_pCur >= m_pEnd)
+                    return SetError("premature end of input");
+
+                char c = *m_pCur;
+                if(c == '"')
+                {
+                    m_pCur++;
+                    break;
+                }
+                if(c != '\\')
+                    return SetError("control character in string");
+
+                if(!ScanEscape(value))
+                    return false;
+            }
+
+            if(!CJSONUTF8::IsValid(value))
+                return SetError("unable to decode byte in string");
+            return true;
+        }
+
+        bool SkipString()
+        {
+            const char* pClose = IndexedStringEnd();
+            if(pClose)
+            {
+                m_pCur = pClose + 1;
+                return true;
+            }
+
+            m_pCur++;
+            while(m_pCur < m_pEnd)
+            {
+                char c = *m_pCur++;
+                if(c == '"')
+                    return true;
+                if(c == '\\')
+                {
+                    if(m_pCur >= m_pEnd)
+                        break;
+                    m_pCur++;
+                }
+                else if((unsigned char)c < 0x20)
+                {
+                    m_pCur--;
+                    return SetError("control character in string");
+                }
+            }
+            return SetError("premature end of input");
+        }
+
+        bool ScanEscape(std::string& value)
+        {
+            m_pCur++; // the backslash
+            if(m_pCur >= m_pEnd)
+                return SetError("premature end of input");
+
+            char c = *m_pCur++;
+            switch(c)
+            {
+                case '"':  value += '"';  return true;
+                case '\\': value += '\\'; return true;
+                case '/':  value += '/';  return true;
+                case 'b':  value += '\b'; return true;
+                case 'f':  value += '\f'; return true;
+                case 'n':  value += '\n'; return true;
+                case 'r':  value += '\r'; return true;
+                case 't':  value += '\t'; return true;
+                case 'u':  break;
+                default:   return SetError("invalid escape");
+            }
+
+            unsigned long codepoint = 0;
+            if(!ScanHex(codepoint))
+                return false;
+
+            if(codepoint >= 0xD800 && codepoint <= 0xDBFF)
+            {
+                // surrogate pair.
+                unsigned long low = 0;
+                if(m_pEnd - m_pCur < 2 || m_pCur[0] != '\\' || m_pCur[1] != 'u')
+                    return SetError("invalid Unicode");
+                m_pCur += 2;
+                if(!ScanHex(low))
+                    return false;
+                if(low < 0xDC00 || low > 0xDFFF)
+                    return SetError("invalid Unicode");
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if(codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+            {
+                return SetError("invalid Unicode");
+            }
+            else if(codepoint == 0)
+            {
+                return SetError("\\u0000 is not allowed");
+            }
+
+            if(codepoint < 0x80)
+            {
+                value += char(codepoint);
+            }
+            else if(codepoint < 0x800)
+            {
+                value += char(0xC0 | (codepoint >> 6));
+                value += char(0x80 | (codepoint & 0x3F));
+            }
+            else if(codepoint < 0x10000)
+            {
+                value += char(0xE0 | (codepoint >> 12));
+                value += char(0x80 | ((codepoint >> 6) & 0x3F));
+                value += char(0x80 | (codepoint & 0x3F));
+            }
+            else
+            {
+                value += char(0xF0 | (codepoint >> 18));
+                value += char(0x80 | ((codepoint >> 12) & 0x3F));
+                value += char(0x80 | ((codepoint >> 6) & 0x3F));
+                value += char(0x80 | (codepoint & 0x3F));
+            }
+            return true;
+        }
+
+        bool ScanHex(unsigned long& value)
+        {
+            if(m_pEnd - m_pCur < 4)
+                return SetError("invalid escape");
+            value = 0;
+            for(size_t i = 0; i < 4; i++)
+            {
+                char c = *m_pCur++;
+                value <<= 4;
+                if(c >= '0' && c <= '9')
+                    value |= (unsigned long)(c - '0');
+                else if(c >= 'a' && c <= 'f')
+                    value |= (unsigned long)(c - 'a' + 10);
+                else if(c >= 'A' && c <= 'F')
+                    value |= (unsigned long)(c - 'A' + 10);
+                else
+                    return SetError("invalid escape");
+            }
+            return true;
+        }
+
+    // CBOR
+        // One open map, array or typed array.
+        struct CCborLevel
+        {
+            char                        kind;       // '{', '[' or 't' for a typed array.
+            bool                        bIndefinite;
+            uint64_t                    remaining;  // pairs or elements left when not indefinite.
+            CJSONCbor::CElementType     element;    // of a typed array.
+        };
+
+        bool InTypedArray() const { return !m_Levels.empty() && m_Levels.back().kind == 't'; }
+
+        // Decodes the head at p without consuming it. The argument of a
+        // float is its bits.
+        bool CborDecodeHead(const char* p, int& major, uint64_t& value, bool& bIndefinite, const char*& pNext) const
+        {
+            if(p >= m_pEnd)
+                return false;
+            unsigned char initial = (unsigned char)*p++;
+            major = initial >> 5;
+            int info = initial & 0x1F;
+            bIndefinite = false;
+            value = 0;
+            if(info < 24)
+            {
+                value = uint64_t(info);
+            }
+            else if(info <= 27)
+            {
+                size_t n = size_t(1) << (info - 24);
+                if(size_t(m_pEnd - p) < n)
+                    return false;
+                for(size_t i = 0; i < n; i++)
+                    value = (value << 8) | (unsigned char)p[i];
+                p += n;
+            }
+            else if(info == CJSONCbor::INFO_INDEFINITE && ((major >= CJSONCbor::MAJOR_BYTES && major <= CJSONCbor::MAJOR_MAP) || major == CJSONCbor::MAJOR_SIMPLE))
+            {
+                bIndefinite = true;
+            }
+            else
+            {
+                return false;
+            }
+            pNext = p;
+            return true;
+        }
+
+        // Consumes the head of the next item, which must be of type major.
+        bool CborHead(int major, uint64_t& value, bool& bIndefinite, const char* text)
+        {
+            if(m_bError || !CborSkipTags())
+                return false;
+            int actual = 0;
+            const char* pNext = NULL;
+            if(!CborDecodeHead(m_pCur, actual, value, bIndefinite, pNext))
+                return SetError(m_pCur >= m_pEnd ? "unexpected end of input" : "invalid CBOR");
+            if(actual != major)
+                return SetError(text);
+            m_pCur = pNext;
+            return true;
+        }
+
+        // Tags other than typed arrays say nothing JSON can hold.
+        bool CborSkipTags()
+        {
+            while(m_pCur < m_pEnd && ((unsigned char)*m_pCur >> 5) == CJSONCbor::MAJOR_TAG)
+            {
+                int major = 0;
+                uint64_t tag = 0;
+                bool bIndefinite = false;
+                const char* pNext = NULL;
+                if(!CborDecodeHead(m_pCur, major, tag, bIndefinite, pNext))
+                    return SetError("invalid CBOR");
+                CJSONCbor::CElementType element;
+                if(CJSONCbor::DecodeTypedArrayTag(tag, element))
+                    break;
+                m_pCur = pNext;
+            }
+            return true;
+        }
+
+        bool CborPeek(json_type& type)
+        {
+            if(InTypedArray())
+            {
+                type = m_Levels.back().element.bFloat ? JSON_REAL : JSON_INTEGER;
+                return true;
+            }
+            if(!CborSkipTags())
+                return false;
+            if(m_pCur >= m_pEnd)
+                return SetError("unexpected end of input");
+
+            unsigned char initial = (unsigned char)*m_pCur;
+            switch(initial >> 5)
+            {
+                case CJSONCbor::MAJOR_UNSIGNED:
+                case CJSONCbor::MAJOR_NEGATIVE: type = JSON_INTEGER; return true;
+                case CJSONCbor::MAJOR_TEXT:     type = JSON_STRING; return true;
+                case CJSONCbor::MAJOR_ARRAY:
+                case CJSONCbor::MAJOR_TAG:      type = JSON_ARRAY; return true; // only typed arrays are left.
+                case CJSONCbor::MAJOR_MAP:      type = JSON_OBJECT; return true;
+                case CJSONCbor::MAJOR_SIMPLE:
+                    switch(initial & 0x1F)
+                    {
+                        case CJSONCbor::SIMPLE_FALSE:   type = JSON_FALSE; return true;
+                        case CJSONCbor::SIMPLE_TRUE:    type = JSON_TRUE; return true;
+                        case CJSONCbor::SIMPLE_NULL:    type = JSON_NULL; return true;
+                        case CJSONCbor::SIMPLE_HALF:
+                        case CJSONCbor::SIMPLE_FLOAT:
+                        case CJSONCbor::SIMPLE_DOUBLE:  type = JSON_REAL; return true;
+                        default: break;
+                    }
+                    break;
+                default: break;
+            }
+            return SetError("invalid token");
+        }
+
+        bool CborPush(char kind, bool bIndefinite, uint64_t remaining)
+        {
+            if(m_Levels.size() >= JSON_READER_MAX_DEPTH)
+                return SetError("maximum parsing depth reached");
+            CCborLevel level;
+            level.kind = kind;
+            level.bIndefinite = bIndefinite;
+            level.remaining = remaining;
+            level.element.bFloat = level.element.bSigned = level.element.bLittle = false;
+            level.element.size = 0;
+            m_Levels.push_back(level);
+            return true;
+        }
+
+        bool CborBeginContainer(int major, const char* text)
+        {
+            if(m_bError || !CborSkipTags())
+                return false;
+            if(major == CJSONCbor::MAJOR_ARRAY && m_pCur < m_pEnd && ((unsigned char)*m_pCur >> 5) == CJSONCbor::MAJOR_TAG)
+            {
+                uint64_t length = 0;
+                CJSONCbor::CElementType element;
+                if(!CborBeginTypedArray(length, element) || !CborPush('t', false, length / element.size))
+                    return false;
+                m_Levels.back().element = element;
+                return true;
+            }
+
+            uint64_t count = 0;
+            bool bIndefinite = false;
+            return CborHead(major, count, bIndefinite, text) && CborPush(major == CJSONCbor::MAJOR_MAP ? '{' : '[', bIndefinite, count);
+        }
+
+        // Consumes the tag and byte string head, m_pCur is left on the data.
+        bool CborBeginTypedArray(uint64_t& length, CJSONCbor::CElementType& element)
+        {
+            int major = 0;
+            uint64_t tag = 0;
+            bool bIndefinite = false;
+            const char* pNext = NULL;
+            if(!CborDecodeHead(m_pCur, major, tag, bIndefinite, pNext) || !CJSONCbor::DecodeTypedArrayTag(tag, element))
+                return SetError("invalid CBOR");
+            m_pCur = pNext;
+            if(!CborHead(CJSONCbor::MAJOR_BYTES, length, bIndefinite, "typed array expected"))
+                return false;
+            if(bIndefinite || length % element.size != 0)
+                return SetError("invalid typed array");
+            if(length > uint64_t(m_pEnd - m_pCur))
+                return SetError("unexpected end of input");
+            return true;
+        }
+
+        // The break or count that ends a container. Returns false at the
+        // end (the level is closed) or on error.
+        bool CborNextItem(char kind, const char* text)
+        {
+            if(m_bError)
+                return false;
+            if(m_Levels.empty() || (m_Levels.back().kind != kind && !(kind == '[' && InTypedArray())))
+                return SetError(text);
+
+            CCborLevel& level = m_Levels.back();
+            if(level.bIndefinite)
+            {
+                if(m_pCur >= m_pEnd)
+                    return SetError(text);
+                if((unsigned char)*m_pCur == CJSONCbor::BREAK)
+                {
+                    m_pCur++;
+                    m_Levels.pop_back();
+                    return false;
+                }
+                return true;
+            }
+            if(level.remaining == 0)
+            {
+                m_Levels.pop_back();
+                return false;
+            }
+            level.remaining--;
+            return true;
+        }
+
+        // Definite and indefinite (chunked) text strings.
+        bool CborReadText(std::string& value, const char* text)
+        {
+            uint64_t length = 0;
+            bool bIndefinite = false;
+            if(!CborHead(CJSONCbor::MAJOR_TEXT, length, bIndefinite, text))
+                return false;
+
+            value.clear();
+            for(;;)
+            {
+                if(!bIndefinite)
+                {
+                    if(length > uint64_t(m_pEnd - m_pCur))
+                        return SetError("premature end of input");
+                    value.append(m_pCur, size_t(length));
+                    m_pCur += length;
+                    break;
+                }
+                if(m_pCur >= m_pEnd)
+                    return SetError("premature end of input");
+                if((unsigned char)*m_pCur == CJSONCbor::BREAK)
+                {
+                    m_pCur++;
+                    break;
+                }
+                bool bChunkIndefinite = false;
+                if(!CborHead(CJSONCbor::MAJOR_TEXT, length, bChunkIndefinite, "string chunk expected"))
+                    return false;
+                if(bChunkIndefinite)
+                    return SetError("invalid CBOR");
+                if(length > uint64_t(m_pEnd - m_pCur))
+                    return SetError("premature end of input");
+                value.append(m_pCur, size_t(length));
+                m_pCur += length;
+            }
+
+            if(memchr(value.data(), '\0', value.size()))
+                return SetError("\\u0000 is not allowed");
+            if(!CJSONUTF8::IsValid(value))
+                return SetError("unable to decode byte in string");
+            return true;
+        }
+
+        // The simple value read, which must be in [first, last], or -1.
+        int CborReadSimple(int first, int last)
+        {
+            if(m_bError || !CborSkipTags())
+                return -1;
+            unsigned char initial = (m_pCur < m_pEnd) ? (unsigned char)*m_pCur : 0;
+            int simple = initial & 0x1F;
+            if(m_pCur >= m_pEnd || (initial >> 5) != CJSONCbor::MAJOR_SIMPLE || simple < first || simple > last)
+            {
+                SetError(m_pCur >= m_pEnd ? "unexpected end of input" : "invalid token");
+                return -1;
+            }
+            m_pCur++;
+            return simple;
+        }
+
+        bool CborReadInteger(bool& bNegative, uint64_t& magnitude)
+        {
+            if(m_bError)
+                return false;
+            if(InTypedArray())
+            {
+                const CJSONCbor::CElementType& element = m_Levels.back().element;
+                if(element.bFloat)
+                    return SetError("integer expected");
+                uint64_t bits = CJSONCbor::LoadElement((const unsigned char*)m_pCur, element);
+                m_pCur += element.size;
+                int64_t value = element.bSigned ? CJSONCbor::SignExtend(bits, element.size) : 0;
+                bNegative = value < 0;
+                magnitude = !element.bSigned ? bits : bNegative ? uint64_t(-(value + 1)) + 1 : uint64_t(value);
+                return true;
+            }
+
+            json_type type;
+            if(!CborPeek(type))
+                return false;
+            if(type != JSON_INTEGER)
+                return SetError("integer expected");
+            bNegative = ((unsigned char)*m_pCur >> 5) == CJSONCbor::MAJOR_NEGATIVE;
+            bool bIndefinite = false;
+            if(!CborHead(bNegative ? CJSONCbor::MAJOR_NEGATIVE : CJSONCbor::MAJOR_UNSIGNED, magnitude, bIndefinite, "integer expected"))
+                return false;
+            if(bNegative)
+            {
+                if(magnitude == std::numeric_limits<uint64_t>::max())
+                    return SetError("too big integer"); // -2^64
+                magnitude++; // the argument is -1 - n.
+            }
+            return true;
+        }
+
+        bool CborReadNumber(double& value, bool* pIsReal)
+        {
+            if(m_bError)
+                return false;
+            bool bReal = false;
+            if(InTypedArray())
+            {
+                const CJSONCbor::CElementType& element = m_Levels.back().element;
+                value = CJSONCbor::TypedElementAsDouble((const unsigned char*)m_pCur, element);
+                m_pCur += element.size;
+                bReal = element.bFloat;
+            }
+            else
+            {
+                json_type type;
+                if(!CborPeek(type))
+                    return false;
+                if(type == JSON_INTEGER)
+                {
+                    json_int_t i = 0;
+                    if(!ReadInteger(i))
+                        return false;
+                    value = double(i); // same as json_number_value()
+                }
+                else if(type == JSON_REAL)
+                {
+                    int info = (unsigned char)*m_pCur & 0x1F;
+                    uint64_t bits = 0;
+                    bool bIndefinite = false;
+                    if(!CborHead(CJSONCbor::MAJOR_SIMPLE, bits, bIndefinite, "number expected"))
+                        return false;
+                    value = CJSONCbor::BitsToDouble(bits, info == CJSONCbor::SIMPLE_HALF ? 2 : info == CJSONCbor::SIMPLE_FLOAT ? 4 : 8);
+                    bReal = true;
+                }
+                else
+                {
+                    return SetError("number expected");
+                }
+            }
+            if(bReal && !std::isfinite(value))
+                return SetError("nan or inf is not a number");
+            if(pIsReal)
+                *pIsReal = bReal;
+            return true;
+        }
+
+        // Tagged items, byte strings and the elements of typed arrays are
+        // skipped as well.
+        bool CborSkipValue(size_t depth)
+        {
+            if(m_bError)
+                return false;
+            if(InTypedArray())
+            {
+                m_pCur += m_Levels.back().element.size;
+                return true;
+            }
+            if(depth > JSON_READER_MAX_DEPTH)
+                return SetError("maximum parsing depth reached");
+
+            int major = 0;
+            uint64_t value = 0;
+            bool bIndefinite = false;
+            const char* pNext = NULL;
+            if(!CborDecodeHead(m_pCur, major, value, bIndefinite, pNext))
+                return SetError(m_pCur >= m_pEnd ? "unexpected end of input" : "invalid CBOR");
+            if(major == CJSONCbor::MAJOR_SIMPLE && bIndefinite)
+                return SetError("invalid token"); // a break where a value should be.
+            m_pCur = pNext;
+
+            switch(major)
+            {
+                case CJSONCbor::MAJOR_BYTES:
+                case CJSONCbor::MAJOR_TEXT:
+                    if(!bIndefinite)
+                    {
+                        if(value > uint64_t(m_pEnd - m_pCur))
+                            return SetError("premature end of input");
+                        m_pCur += value;
+                        return true;
+                    }
+                    return CborSkipItems(depth, 0, true);
+                case CJSONCbor::MAJOR_ARRAY:
+                    return CborSkipItems(depth, value, bIndefinite);
+                case CJSONCbor::MAJOR_MAP:
+                    if(!bIndefinite && value > std::numeric_limits<uint64_t>::max() / 2)
+                        return SetError("invalid CBOR");
+                    return CborSkipItems(depth, value * 2, bIndefinite);
+                case CJSONCbor::MAJOR_TAG:
+                    return CborSkipValue(depth + 1);
+                default:
+                    return true;
+            }
+        }
+
+        bool CborSkipItems(size_t depth, uint64_t count, bool bIndefinite)
+        {
+            for(uint64_t i = 0; bIndefinite || i < count; i++)
+            {
+                if(bIndefinite)
+                {
+                    if(m_pCur >= m_pEnd)
+                        return SetError("unexpected end of input");
+                    if((unsigned char)*m_pCur == CJSONCbor::BREAK)
+                    {
+                        m_pCur++;
+                        return true;
+                    }
+                }
+                if(!CborSkipValue(depth + 1))
+                    return false;
+            }
+            return true;
+        }
+
+        static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+        static bool IsWhitespace(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+
+    private:
+        CJSONReader& operator=(const CJSONReader&);
+
+        static const size_t NO_CHUNK = size_t(-1);
+
+        const char*     m_pStart;
+        const char*     m_pCur;
+        const char*     m_pEnd;
+        char            m_Prev;
+        bool            m_bError;
+        json_error_t    m_Error;
+        const CJSONStructuralIndex* m_pIndex;
+        std::vector<uint32_t> m_Tokens; // offsets of the tokens of chunk m_Chunk.
+        size_t          m_Chunk;        // NO_CHUNK before the first.
+        size_t          m_Next;         // first of m_Tokens not before m_pCur.
+        CJSONThreadPool* m_pThreadPool;
+        CJSONFormat     m_Format;
+        std::vector<CCborLevel> m_Levels;   // open containers of CBOR.
+        std::string     m_Key;
+        std::string*    m_pKeyBuffer;   // not owned, NULL for m_Key.
+        std::vector<uint32_t>* m_pTokenBuffer; // not owned, NULL for m_Tokens.
+        bool            m_bBorrowedTokens;  // m_pTokenBuffer is the original's, see the copy constructor.
+        CJSONTextToken* m_pTextToken;   // not owned, NULL if the text has none.
+};
+
+}
+
+#endif
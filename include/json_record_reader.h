@@ -0,0 +1,333 @@
+//
+//  json_record_reader.h
+//
+//  Reads a stream of JSON documents, one after the other (NDJSON / JSON
+//  lines or plain concatenation), and parses each one into the same bound
+//  object. Only a read-ahead buffer is kept in memory, it grows only when
+//  a single record does not fit in it.
+//
+//  Example:
+//
+//      LogRecord rec;              // CJSONValueObject<LogRecord>
+//      rec.SetupJSONObject();      // bindings are set up once
+//      json::CJSONRecordReader reader;
+//      reader.Open("events.log");
+//      while(reader.Next(&rec))
+//      {
+//          if(!reader.HasRecordError())
+//              Process(rec);
+//      }
+//      if(reader.HasError()) ...
+//
+
+#ifndef JSON_RECORD_READER_H
+#define JSON_RECORD_READER_H
+
+#include "json_wrapper.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define JSON_HAS_POSIX_IO
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace json {
+
+#ifndef JSON_RECORD_READER_BUFFER_DEFAULT
+#define JSON_RECORD_READER_BUFFER_DEFAULT (64 * 1024)
+#endif
+
+class CJSONRecordReader
+{
+    public:
+        CJSONRecordReader(size_t readAhead = JSON_RECORD_READER_BUFFER_DEFAULT) : m_ReadAhead(readAhead > 0 ? readAhead : 1), m_fd(-1), m_bOwnsFd(false), m_pSource(NULL), m_Begin(0), m_End(0), m_bEOF(true), m_bError(false), m_bRecordError(false), m_RecordCount(0)
+        {
+            ClearError();
+        }
+
+        ~CJSONRecordReader()
+        {
+            Close();
+        }
+
+    #ifdef JSON_HAS_POSIX_IO
+        bool Open(const std::string& Path)
+        {
+            Close();
+            int fd = open(Path.c_str(), O_RDONLY);
+            if(fd < 0)
+            {
+                snprintf(m_LastError.text, sizeof(m_LastError.text), "unable to open %s: %s", Path.c_str(), strerror(errno));
+                fprintf(stderr, "warning: %s \n", m_LastError.text);
+                m_bError = true;
+                return false;
+            }
+            Attach(fd);
+            m_bOwnsFd = true;
+            return true;
+        }
+
+        // Reads from fd, which stays owned by the caller.
+        void Attach(int fd)
+        {
+            Close();
+            m_fd = fd;
+            m_Buffer.resize(m_ReadAhead);
+            m_bEOF = false;
+        }
+    #endif
+
+        // Parses the records straight out of pBuffer, nothing is copied.
+        // The buffer must stay valid while the reader uses it.
+        void AttachBuffer(const char* pBuffer, size_t size)
+        {
+            Close();
+            m_pSource = pBuffer;
+            m_End = size;
+            m_bEOF = true; // all the data is already there.
+        }
+
+        void Close()
+        {
+        #ifdef JSON_HAS_POSIX_IO
+            if(m_bOwnsFd && m_fd >= 0)
+                close(m_fd);
+        #endif
+            m_fd = -1;
+            m_bOwnsFd = false;
+            m_pSource = NULL;
+            m_Begin = m_End = 0;
+            m_bEOF = true;
+            m_bError = false;
+            m_bRecordError = false;
+            m_RecordCount = 0;
+            ClearError();
+        }
+
+        // Parses the next record into pObject. The object is Reset() first
+        // so values from the previous record do not leak into this one.
+        // Returns false at the end of the stream or when the stream itself
+        // is broken (HasError()). A record that is read but does not parse
+        // still returns true with HasRecordError() set, the next call moves
+        // on to the record after it.
+        template<class TVal>
+        bool Next(CJSONValueObject<TVal>* pObject)
+        {
+            size_t start = 0, end = 0;
+            m_bRecordError = false;
+            if(!NextRecord(start, end))
+                return false;
+
+            m_RecordCount++;
+            const char* pData = Data();
+            CJSONReader reader(pData + start, end - start);
+
+            pObject->Reset();
+            bool bParseSuccess = pObject->Parse(reader);
+            m_Begin = end;
+
+            if(reader.HasError())
+            {
+                m_LastError = reader.GetError();
+                snprintf(m_LastError.source, sizeof(m_LastError.source), "record %lu", (unsigned long)m_RecordCount);
+                fprintf(stderr, "warning: %s (%s) \n", m_LastError.text, m_LastError.source);
+                bParseSuccess = false;
+            }
+            else if(!bParseSuccess)
+            {
+                snprintf(m_LastError.text, sizeof(m_LastError.text), "record does not match the object");
+                snprintf(m_LastError.source, sizeof(m_LastError.source), "record %lu", (unsigned long)m_RecordCount);
+            }
+            m_bRecordError = !bParseSuccess;
+            return true;
+        }
+
+        // true once every record has been returned.
+        bool IsEOF()
+        {
+            if(m_bError)
+                return true;
+            size_t start = 0;
+            return !SkipWhitespace(start);
+        }
+
+        bool HasError() const { return m_bError; }
+        // The record the last Next returned did not parse, see GetLastError.
+        bool HasRecordError() const { return m_bRecordError; }
+        const json_error_t& GetLastError() const { return m_LastError; }
+        size_t GetRecordCount() const { return m_RecordCount; }
+        size_t GetBufferSize() const { return m_Buffer.size(); }
+
+    private:
+        const char* Data() const
+        {
+            return m_pSource ? m_pSource : (m_Buffer.empty() ? "" : &m_Buffer[0]);
+        }
+
+        void ClearError()
+        {
+            m_LastError.line = -1;
+            m_LastError.column = -1;
+            m_LastError.position = 0;
+            m_LastError.source[0] = '\0';
+            m_LastError.text[0] = '\0';
+        }
+
+        bool SetError(const char* text)
+        {
+            m_bError = true;
+            snprintf(m_LastError.text, sizeof(m_LastError.text), "%s", text);
+            snprintf(m_LastError.source, sizeof(m_LastError.source), "record %lu", (unsigned long)(m_RecordCount + 1));
+            fprintf(stderr, "warning: %s (%s) \n", m_LastError.text, m_LastError.source);
+            return false;
+        }
+
+        // Moves the unread bytes to the front and reads more. The buffer
+        // only grows when it is already full of a single record.
+        bool Fill()
+        {
+        #ifdef JSON_HAS_POSIX_IO
+            if(m_bEOF || m_fd < 0)
+                return false;
+
+            if(m_Begin > 0)
+            {
+                memmove(&m_Buffer[0], &m_Buffer[m_Begin], m_End - m_Begin);
+                m_End -= m_Begin;
+                m_Begin = 0;
+            }
+            if(m_End == m_Buffer.size())
+                m_Buffer.resize(m_Buffer.size() * 2);
+
+            ssize_t n;
+            do
+            {
+                n = read(m_fd, &m_Buffer[m_End], m_Buffer.size() - m_End);
+            } while(n < 0 && errno == EINTR);
+
+            if(n < 0)
+            {
+                m_bEOF = true;
+                return SetError(strerror(errno));
+            }
+            if(n == 0)
+            {
+                m_bEOF = true;
+                return false;
+            }
+            m_End += size_t(n);
+            return true;
+        #else
+            return false;
+        #endif
+        }
+
+        // Finds the first non whitespace byte at or after m_Begin, reading
+        // as needed. Offsets are relative to m_Begin since Fill moves data.
+        bool SkipWhitespace(size_t& offset)
+        {
+            offset = 0;
+            for(;;)
+            {
+                const char* pData = Data();
+                while(m_Begin + offset < m_End)
+                {
+                    char c = pData[m_Begin + offset];
+                    if(c != ' ' && c != '\n' && c != '\t' && c != '\r')
+                        return true;
+                    offset++;
+                }
+                // drop the whitespace so the buffer does not fill up with it.
+                m_Begin += offset;
+                offset = 0;
+                if(!Fill())
+                    return false;
+            }
+        }
+
+        // Frames the next document by matching brackets outside strings.
+        bool NextRecord(size_t& start, size_t& end)
+        {
+            if(m_bError)
+                return false;
+
+            size_t offset = 0;
+            if(!SkipWhitespace(offset))
+                return false;
+            m_Begin += offset;
+
+            char first = Data()[m_Begin];
+            if(first != '{' && first != '[')
+                return SetError("'[' or '{' expected");
+
+            size_t depth = 0;
+            bool bInString = false;
+            bool bEscape = false;
+            size_t pos = 0; // relative to m_Begin
+            for(;;)
+            {
+                const char* pData = Data() + m_Begin;
+                size_t avail = m_End - m_Begin;
+                for(; pos < avail; pos++)
+                {
+                    char c = pData[pos];
+                    if(bInString)
+                    {
+                        if(bEscape)
+                            bEscape = false;
+                        else if(c == '\\')
+                            bEscape = true;
+                        else if(c == '"')
+                            bInString = false;
+                    }
+                    else if(c == '"')
+                    {
+                        bInString = true;
+                    }
+                    else if(c == '{' || c == '[')
+                    {
+                        depth++;
+                    }
+                    else if(c == '}' || c == ']')
+                    {
+                        if(--depth == 0)
+                        {
+                            start = m_Begin;
+                            end = m_Begin + pos + 1;
+                            return true;
+                        }
+                    }
+                }
+
+                if(!Fill())
+                {
+                    if(!m_bError)
+                        SetError("premature end of input");
+                    return false;
+                }
+            }
+        }
+
+    private:
+        // owns a file descriptor, do not copy.
+        CJSONRecordReader(const CJSONRecordReader&);
+        CJSONRecordReader& operator=(const CJSONRecordReader&);
+
+    private:
+        size_t              m_ReadAhead;
+        int                 m_fd;
+        bool                m_bOwnsFd;
+        const char*         m_pSource;      // AttachBuffer data, else NULL.
+        std::vector<char>   m_Buffer;       // read-ahead buffer for fd input.
+        size_t              m_Begin;        // first unread byte.
+        size_t              m_End;          // end of the valid data.
+        bool                m_bEOF;
+        bool                m_bError;       // the stream is broken, no more records.
+        bool                m_bRecordError; // the last record did not parse.
+        size_t              m_RecordCount;
+        json_error_t        m_LastError;
+};
+
+}
+
+#endif
@@ -0,0 +1,184 @@
+//
+//  json_replace_file.h
+//
+//  Replaces a file with new contents without a window in which it is
+//  missing or half written: the contents go to a temporary file made with
+//  mkstemp in the same directory, which is synced and renamed over the
+//  file once it is complete. If the write fails the temporary file is
+//  removed and the file is left as it was.
+//
+//  Symbolic links are followed, the file they lead to is the one that is
+//  replaced and the link stays. The new file gets the old one's mode (and
+//  owner, where that is allowed), a new file gets what fopen would have
+//  given it. Other names the file has through hard links keep the old
+//  contents.
+//
+//  Without POSIX the file is written in place, as fopen would.
+//
+
+#ifndef JSON_REPLACE_FILE_H
+#define JSON_REPLACE_FILE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define JSON_HAS_MKSTEMP
+    #include <sys/stat.h>
+    #include <sys/types.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <stdlib.h>
+#endif
+
+namespace json {
+
+class CJSONReplaceFile
+{
+    public:
+        CJSONReplaceFile() : m_pFile(NULL) {}
+        ~CJSONReplaceFile() { Abort(); }
+
+        // The file to write the contents to, NULL on failure with errno set.
+        FILE* Open(const std::string& Path, bool bBinary)
+        {
+            Abort();
+        #ifdef JSON_HAS_MKSTEMP
+            if(!ResolveLinks(Path, m_Target))
+                return NULL;
+
+            std::vector<char> temp(m_Target.begin(), m_Target.end());
+            const char suffix[] = ".XXXXXX";
+            temp.insert(temp.end(), suffix, suffix + sizeof(suffix)); // with the nul.
+            int fd = mkstemp(&temp[0]);
+            if(fd < 0)
+                return NULL;
+            m_TempPath = &temp[0];
+
+            struct stat info;
+            if(stat(m_Target.c_str(), &info) == 0)
+            {
+                // Keeps the owner where that is allowed, the mode either way.
+                if(fchown(fd, info.st_uid, info.st_gid) != 0)
+                    errno = 0;
+                fchmod(fd, info.st_mode & 07777);
+            }
+            else
+            {
+                mode_t mask = umask(0);
+                umask(mask);
+                fchmod(fd, 0666 & ~mask);
+            }
+
+            m_pFile = fdopen(fd, bBinary ? "wb" : "w");
+            if(!m_pFile)
+            {
+                int err = errno;
+                close(fd);
+                remove(m_TempPath.c_str());
+                m_TempPath.clear();
+                errno = err;
+            }
+        #else
+            m_Target = Path;
+            m_pFile = fopen(Path.c_str(), bBinary ? "wb" : "w");
+        #endif
+            return m_pFile;
+        }
+
+        // Puts what was written in place of the file. On failure the file is
+        // left as it was and errno tells why.
+        bool Commit()
+        {
+            if(!m_pFile)
+                return false;
+            bool bCommitSuccess = fflush(m_pFile) == 0;
+        #ifdef JSON_HAS_MKSTEMP
+            bCommitSuccess = bCommitSuccess && fsync(fileno(m_pFile)) == 0;
+        #endif
+            bCommitSuccess = (fclose(m_pFile) == 0) && bCommitSuccess;
+            m_pFile = NULL;
+        #ifdef JSON_HAS_MKSTEMP
+            bCommitSuccess = bCommitSuccess && rename(m_TempPath.c_str(), m_Target.c_str()) == 0;
+            if(!bCommitSuccess)
+            {
+                int err = errno;
+                remove(m_TempPath.c_str());
+                errno = err;
+            }
+            m_TempPath.clear();
+        #endif
+            return bCommitSuccess;
+        }
+
+        // Drops what was written, the file is left as it was.
+        void Abort()
+        {
+            if(m_pFile)
+                fclose(m_pFile);
+            m_pFile = NULL;
+        #ifdef JSON_HAS_MKSTEMP
+            if(!m_TempPath.empty())
+                remove(m_TempPath.c_str());
+            m_TempPath.clear();
+        #endif
+        }
+
+        FILE* GetFile() const { return m_pFile; }
+
+        // The file that is replaced, Path with the links followed.
+        const std::string& GetTarget() const { return m_Target; }
+
+    private:
+        // owns a temporary file, do not copy.
+        CJSONReplaceFile(const CJSONReplaceFile&);
+        CJSONReplaceFile& operator=(const CJSONReplaceFile&);
+
+    #ifdef JSON_HAS_MKSTEMP
+        // Follows Path while it is a symbolic link. The last one may lead
+        // to a file that does not exist yet, it is made there.
+        static bool ResolveLinks(const std::string& Path, std::string& target)
+        {
+            target = Path;
+            for(int links = 0; ; links++)
+            {
+                struct stat info;
+                if(lstat(target.c_str(), &info) != 0 || !S_ISLNK(info.st_mode))
+                    return true;
+                if(links == 40)
+                {
+                    errno = ELOOP;
+                    return false;
+                }
+
+                std::vector<char> link(size_t(info.st_size > 0 ? info.st_size : 255) + 1);
+                ssize_t length = readlink(target.c_str(), &link[0], link.size());
+                if(length < 0)
+                    return false;
+                if(size_t(length) >= link.size())
+                {
+                    errno = ENAMETOOLONG; // it changed under us.
+                    return false;
+                }
+                std::string next(&link[0], size_t(length));
+                if(next.empty() || next[0] != '/')
+                {
+                    std::string::size_type slash = target.rfind('/');
+                    next = (slash == std::string::npos ? std::string() : target.substr(0, slash + 1)) + next;
+                }
+                target = next;
+            }
+        }
+    #endif
+
+    private:
+        FILE*           m_pFile;
+        std::string     m_Target;
+        std::string     m_TempPath;     // empty when there is none.
+};
+
+}
+
+#endif
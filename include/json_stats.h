@@ -0,0 +1,285 @@
+//
+//  json_stats.h
+//
+//  Counters and timings of what a CJSONParser does, to find out where a
+//  slow load spends its time: reading the file, tokenizing it, binding
+//  the values to the members, dumping, writing out or printing errors.
+//  A CJSONStats is attached with CJSONParser::SetStats and read back (or
+//  printed) after the calls of interest.
+//
+//  Recording is built in with JSON_STATS (and c++11). Without it the
+//  hooks below are empty macros, nothing is timed or counted and a
+//  CJSONStats attached to a parser stays at zero.
+//
+//  The parser makes its stats current on the calling thread for the
+//  length of each call (CJSONStats::CScope, as CJSONArena does) and the
+//  value classes record into the current one. The elements of an array
+//  parsed on the parser's thread pool are not counted.
+//
+
+#ifndef JSON_STATS_H
+#define JSON_STATS_H
+
+#ifndef JSON_STATS
+#define JSON_STATS 0
+#endif
+
+#if JSON_STATS && __cplusplus < 201103L
+    #undef JSON_STATS
+    #define JSON_STATS 0
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#if JSON_STATS
+    #include <chrono>
+#endif
+
+namespace json {
+
+// The field paths kept by CJSONStats::GetSlowestPaths.
+#ifndef JSON_STATS_SLOWEST_PATHS
+#define JSON_STATS_SLOWEST_PATHS 10
+#endif
+
+class CJSONStats
+{
+    public:
+        // Wall time is given to one phase at a time: a phase started within
+        // another (an error reported while binding) pauses it.
+        enum
+        {
+            PHASE_READ,         // reading or mapping the file of a streaming load.
+            PHASE_TOKENIZE,     // jansson's load (file read included), or checking and indexing the text.
+            PHASE_BIND,         // parsing the loaded document into the bound members.
+            PHASE_DUMP,         // Dump or Write, json_dump_file included.
+            PHASE_OUTPUT,       // the end of a streamed file: flush, close and rename.
+            PHASE_REPORT,       // printing the parser's warnings.
+            PHASE_COUNT
+        };
+
+        // Time spent parsing the values at one path, the time of the values
+        // below it included. Array indices are left out of the path, so the
+        // elements of an array add up: "/ObjectArray/name".
+        struct CPathTime
+        {
+            std::string     path;
+            double          ms;
+            size_t          count;
+        };
+
+        CJSONStats() { Clear(); }
+
+        void Clear()
+        {
+            bytesRead = 0;
+            bytesWritten = 0;
+            nodes = 0;
+            objects = 0;
+            maxDepth = 0;
+            unknownKeys = 0;
+            skippedKeys = 0;
+            strings = 0;
+            stringBytes = 0;
+            allocations = 0;
+            errors = 0;
+            for(size_t i = 0; i < PHASE_COUNT; i++)
+                phaseMs[i] = 0;
+            m_Paths.clear();
+            m_Path.clear();
+            m_Depth = 0;
+            m_Phase = PHASE_COUNT;
+            m_PhaseStart = 0;
+        }
+
+        size_t  bytesRead;      // of the documents loaded.
+        size_t  bytesWritten;   // of the documents dumped.
+        size_t  nodes;          // object members and array elements parsed.
+        size_t  objects;        // CJSONValueObjects parsed.
+        size_t  maxDepth;       // of the members parsed, the root's are at 1.
+        size_t  unknownKeys;    // not bound, kept in the missing values.
+        size_t  skippedKeys;    // not bound and dropped.
+        size_t  strings;        // copied into bound strings,
+        size_t  stringBytes;    // and their length.
+        size_t  allocations;    // jansson's, when the arena's hooks are in (json_arena.h).
+        size_t  errors;         // warnings printed by the parser.
+        double  phaseMs[PHASE_COUNT];
+
+        static const char* PhaseName(size_t phase)
+        {
+            static const char* names[PHASE_COUNT] = { "read", "tokenize", "bind", "dump", "output", "report" };
+            return phase < PHASE_COUNT ? names[phase] : "";
+        }
+
+        // The paths that took the longest, slowest first.
+        std::vector<CPathTime> GetSlowestPaths(size_t count = JSON_STATS_SLOWEST_PATHS) const
+        {
+            std::vector<CPathTime> paths;
+            paths.reserve(m_Paths.size());
+            for(std::map<std::string, CPathTime>::const_iterator iter = m_Paths.begin(); iter != m_Paths.end(); iter++)
+                paths.push_back(iter->second);
+            std::sort(paths.begin(), paths.end(), SlowerThan);
+            if(paths.size() > count)
+                paths.resize(count);
+            return paths;
+        }
+
+        void Print(FILE* pFile = stdout) const
+        {
+            fprintf(pFile, "read %zu bytes, wrote %zu bytes\n", bytesRead, bytesWritten);
+            fprintf(pFile, "%zu nodes in %zu objects, depth %zu, %zu unknown keys kept, %zu skipped\n", nodes, objects, maxDepth, unknownKeys, skippedKeys);
+            fprintf(pFile, "%zu strings of %zu bytes, %zu jansson allocations, %zu errors\n", strings, stringBytes, allocations, errors);
+            for(size_t i = 0; i < PHASE_COUNT; i++)
+                fprintf(pFile, "%-8s %10.3f ms\n", PhaseName(i), phaseMs[i]);
+            std::vector<CPathTime> paths = GetSlowestPaths();
+            for(size_t i = 0; i < paths.size(); i++)
+                fprintf(pFile, "%10.3f ms %8zu x %s\n", paths[i].ms, paths[i].count, paths[i].path.c_str());
+        }
+
+    #if JSON_STATS
+        static CJSONStats*& Current()
+        {
+            static thread_local CJSONStats* pCurrent = NULL;
+            return pCurrent;
+        }
+
+        // Makes pStats (or none, with NULL) the one recorded into on this
+        // thread until the scope ends.
+        class CScope
+        {
+            public:
+                CScope(CJSONStats* pStats) : m_pPrevious(Current()) { Current() = pStats; }
+                ~CScope() { Current() = m_pPrevious; }
+
+            private:
+                CScope(const CScope&);
+                CScope& operator=(const CScope&);
+                CJSONStats* m_pPrevious;
+        };
+
+        class CPhase
+        {
+            public:
+                CPhase(size_t phase) : m_pStats(Current()), m_Previous(PHASE_COUNT)
+                {
+                    if(m_pStats)
+                        m_Previous = m_pStats->SwitchPhase(phase);
+                }
+                ~CPhase()
+                {
+                    if(m_pStats)
+                        m_pStats->SwitchPhase(m_Previous);
+                }
+
+            private:
+                CPhase(const CPhase&);
+                CPhase& operator=(const CPhase&);
+                CJSONStats* m_pStats;
+                size_t      m_Previous;
+        };
+
+        // The parse of the value of one member.
+        class CMember
+        {
+            public:
+                CMember(const std::string& name) : m_pStats(Current()) { Begin(name.data(), name.size()); }
+                CMember(const char* name) : m_pStats(Current()) { Begin(name, strlen(name)); }
+                ~CMember()
+                {
+                    if(!m_pStats)
+                        return;
+                    CJSONStats& stats = *m_pStats;
+                    CPathTime& time = stats.m_Paths[stats.m_Path];
+                    if(time.count++ == 0)
+                        time.path = stats.m_Path;
+                    time.ms += Now() - m_Start;
+                    stats.m_Path.resize(m_PathSize);
+                    stats.m_Depth--;
+                }
+
+            private:
+                CMember(const CMember&);
+                CMember& operator=(const CMember&);
+
+                void Begin(const char* name, size_t length)
+                {
+                    if(!m_pStats)
+                        return;
+                    CJSONStats& stats = *m_pStats;
+                    stats.nodes++;
+                    if(++stats.m_Depth > stats.maxDepth)
+                        stats.maxDepth = stats.m_Depth;
+                    m_PathSize = stats.m_Path.size();
+                    stats.m_Path += '/';
+                    stats.m_Path.append(name, length);
+                    m_Start = Now();
+                }
+
+                CJSONStats* m_pStats;
+                size_t      m_PathSize;
+                double      m_Start;
+        };
+
+        static double Now()
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // For the DOM loads and dumps, jansson does not tell.
+        static size_t FileSize(const std::string& Path)
+        {
+            FILE* pFile = fopen(Path.c_str(), "rb");
+            long size = 0;
+            if(pFile && fseek(pFile, 0, SEEK_END) == 0)
+                size = ftell(pFile);
+            if(pFile)
+                fclose(pFile);
+            return size > 0 ? size_t(size) : 0;
+        }
+    #endif
+
+    private:
+    #if JSON_STATS
+        // Gives the time since the last switch to the phase running so far.
+        size_t SwitchPhase(size_t phase)
+        {
+            double now = Now();
+            if(m_Phase < PHASE_COUNT)
+                phaseMs[m_Phase] += now - m_PhaseStart;
+            size_t previous = m_Phase;
+            m_Phase = phase;
+            m_PhaseStart = now;
+            return previous;
+        }
+    #endif
+
+        static bool SlowerThan(const CPathTime& a, const CPathTime& b) { return a.ms > b.ms; }
+
+        std::map<std::string, CPathTime>    m_Paths;
+        std::string                         m_Path;         // of the member being parsed.
+        size_t                              m_Depth;
+        size_t                              m_Phase;        // PHASE_COUNT for none.
+        double                              m_PhaseStart;
+};
+
+// The hooks in the parser and the value classes.
+#if JSON_STATS
+    #define JSON_STATS_SCOPE(pStats)        json::CJSONStats::CScope json_stats_scope(pStats)
+    #define JSON_STATS_PHASE(phase)         json::CJSONStats::CPhase json_stats_phase(json::CJSONStats::phase)
+    #define JSON_STATS_MEMBER(name)         json::CJSONStats::CMember json_stats_member(name)
+    #define JSON_STATS_ADD(counter, n)      do { json::CJSONStats* pStats_ = json::CJSONStats::Current(); if(pStats_) pStats_->counter += (n); } while(0)
+#else
+    #define JSON_STATS_SCOPE(pStats)
+    #define JSON_STATS_PHASE(phase)
+    #define JSON_STATS_MEMBER(name)
+    #define JSON_STATS_ADD(counter, n)      do {} while(0)
+#endif
+
+}
+
+#endif
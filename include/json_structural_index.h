@@ -0,0 +1,400 @@
+//
+//  json_structural_index.h
+//
+//  First stage of the streaming parse. The text is scanned 64 bytes at a
+//  time for quotes, backslashes, structural characters and whitespace and
+//  the offsets of the tokens (structural characters, string quotes and the
+//  first character of each scalar) are listed. CJSONReader then jumps from
+//  token to token instead of looking at every byte, which matters for
+//  files written with JSON_INDENT(n).
+//
+//  The offsets are not kept for the whole text, there can be as many as
+//  bytes. Build scans it once, checks the strings and keeps what the scan
+//  carries from one chunk of JSON_STRUCTURAL_INDEX_CHUNK bytes to the
+//  next; a reader lists the tokens of the chunk it is in when it gets
+//  there (ScanChunk). The memory is one scan state per chunk plus one
+//  chunk's offsets per reader, whatever the size of the text.
+//
+//  The block scan is picked at run time: AVX2 or SSE2 on x86 when the CPU
+//  has it, a portable byte loop otherwise. All of them produce the same
+//  index.
+//
+
+#ifndef JSON_STRUCTURAL_INDEX_H
+#define JSON_STRUCTURAL_INDEX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define JSON_STRUCTURAL_INDEX_X86
+    #include <immintrin.h>
+#endif
+
+namespace json {
+
+// Bytes of text whose tokens are listed at a time. A multiple of 64.
+#ifndef JSON_STRUCTURAL_INDEX_CHUNK
+#define JSON_STRUCTURAL_INDEX_CHUNK (16 * 1024)
+#endif
+
+// The offsets are 32 bits, larger texts can not be indexed.
+#define JSON_STRUCTURAL_INDEX_MAX_SIZE size_t(0xFFFFFFFFu)
+
+class CJSONStructuralIndex
+{
+    public:
+        CJSONStructuralIndex() : m_pText(NULL), m_Size(0) {}
+        ~CJSONStructuralIndex() {}
+
+        // Returns false (and leaves the index empty) if the text can not be
+        // indexed: an unterminated string, a control character inside a
+        // string or more than JSON_STRUCTURAL_INDEX_MAX_SIZE bytes. The
+        // reader then falls back to scanning the bytes and reports the
+        // error itself. The text must stay valid as long as the index.
+        bool Build(const char* pBuffer, size_t size)
+        {
+            Clear();
+            if(size > JSON_STRUCTURAL_INDEX_MAX_SIZE)
+                return false;
+
+            m_States.reserve(size / JSON_STRUCTURAL_INDEX_CHUNK + 1);
+            CScanState state;
+            for(size_t begin = 0; begin < size; begin += JSON_STRUCTURAL_INDEX_CHUNK)
+            {
+                m_States.push_back(state);
+                Scan(pBuffer, size, begin, state, NULL);
+            }
+
+            if(state.inString || state.error)
+            {
+                Clear();
+                return false;
+            }
+            m_pText = pBuffer;
+            m_Size = size;
+            return true;
+        }
+
+        void Clear()
+        {
+            m_States.clear();
+            m_pText = NULL;
+            m_Size = 0;
+        }
+
+        // Clear that also frees the memory, which Clear keeps for the next Build.
+        void Shrink()
+        {
+            Clear();
+            std::vector<CScanState>().swap(m_States);
+        }
+
+        bool IsEmpty() const { return m_States.empty(); }
+        size_t GetChunkCount() const { return m_States.size(); }
+
+        // The offsets of the tokens of one chunk, in the whole text.
+        void ScanChunk(size_t chunk, std::vector<uint32_t>& out) const
+        {
+            out.clear();
+            if(chunk >= m_States.size())
+                return;
+            CScanState state = m_States[chunk];
+            out.reserve(JSON_STRUCTURAL_INDEX_CHUNK / 4);
+            Scan(m_pText, m_Size, chunk * JSON_STRUCTURAL_INDEX_CHUNK, state, &out);
+        }
+
+        enum implementation { IMPL_SCALAR, IMPL_SSE2, IMPL_AVX2 };
+
+        static implementation GetImplementation()
+        {
+            static const implementation impl = DetectImplementation();
+            return impl;
+        }
+
+        static const char* GetImplementationName()
+        {
+            switch(GetImplementation())
+            {
+                case IMPL_AVX2: return "avx2";
+                case IMPL_SSE2: return "sse2";
+                default:        return "scalar";
+            }
+        }
+
+    private:
+        // Bit i of each mask describes byte i of the block.
+        struct CBlockMasks
+        {
+            uint64_t quote;
+            uint64_t backslash;
+            uint64_t op;          // { } [ ] : ,
+            uint64_t whitespace;
+            uint64_t control;     // below 0x20
+        };
+
+        // Carried from one block to the next.
+        struct CScanState
+        {
+            CScanState() : inString(0), escapeNext(0), prevScalar(0), error(false) {}
+            uint64_t    inString;   // all ones if the last block ended inside a string.
+            uint64_t    escapeNext; // 1 if the last block ended with an escaping backslash.
+            uint64_t    prevScalar; // 1 if the last block ended with a scalar character.
+            bool        error;
+        };
+
+        static implementation DetectImplementation()
+        {
+        #ifdef JSON_STRUCTURAL_INDEX_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2"))
+                return IMPL_AVX2;
+            if(__builtin_cpu_supports("sse2"))
+                return IMPL_SSE2;
+        #endif
+            return IMPL_SCALAR;
+        }
+
+        static inline unsigned CountTrailingZeros(uint64_t x)
+        {
+        #if defined(__GNUC__) || defined(__clang__)
+            return unsigned(__builtin_ctzll(x));
+        #else
+            unsigned n = 0;
+            while(!(x & 1)) { x >>= 1; n++; }
+            return n;
+        #endif
+        }
+
+        static inline uint64_t PrefixXor(uint64_t x)
+        {
+            x ^= x << 1;
+            x ^= x << 2;
+            x ^= x << 4;
+            x ^= x << 8;
+            x ^= x << 16;
+            x ^= x << 32;
+            return x;
+        }
+
+        // One chunk from begin, the tokens go to pOut unless it is NULL.
+        static void Scan(const char* pBuffer, size_t size, size_t begin, CScanState& state, std::vector<uint32_t>* pOut)
+        {
+            size_t end = std::min(size, begin + JSON_STRUCTURAL_INDEX_CHUNK);
+            switch(GetImplementation())
+            {
+        #ifdef JSON_STRUCTURAL_INDEX_X86
+                case IMPL_AVX2: ScanAVX2(pBuffer, size, begin, end, state, pOut); break;
+                case IMPL_SSE2: ScanSSE2(pBuffer, size, begin, end, state, pOut); break;
+        #endif
+                default:        ScanScalar(pBuffer, size, begin, end, state, pOut); break;
+            }
+        }
+
+        // Turns the character masks of one block into token offsets.
+        static inline void ProcessBlock(const CBlockMasks& masks, uint32_t base, CScanState& state, std::vector<uint32_t>* pOut)
+        {
+            // Characters preceded by an odd run of backslashes. Backslashes are
+            // rare so just walk them.
+            uint64_t escaped = 0;
+            uint64_t backslash = masks.backslash;
+            if(state.escapeNext)
+            {
+                escaped = 1;
+                backslash &= ~uint64_t(1);
+            }
+            state.escapeNext = 0;
+            while(backslash)
+            {
+                unsigned i = CountTrailingZeros(backslash);
+                backslash &= backslash - 1;
+                if(i == 63)
+                {
+                    state.escapeNext = 1;
+                    break;
+                }
+                escaped |= uint64_t(1) << (i + 1);
+                backslash &= ~(uint64_t(1) << (i + 1));
+            }
+
+            uint64_t quote = masks.quote & ~escaped;
+            uint64_t inString = PrefixXor(quote) ^ state.inString; // opening quote up to, not including, the closing one.
+            state.inString = uint64_t(0) - (inString >> 63);
+
+            if(masks.control & inString)
+                state.error = true;
+
+            uint64_t scalar = ~(masks.op | masks.whitespace);
+            uint64_t nonQuoteScalar = scalar & ~quote;
+            uint64_t followsScalar = (nonQuoteScalar << 1) | state.prevScalar;
+            state.prevScalar = nonQuoteScalar >> 63;
+
+            if(!pOut)
+                return;
+            uint64_t stringTail = inString ^ quote;
+            uint64_t tokens = ((masks.op | (scalar & ~followsScalar)) & ~stringTail) | quote;
+
+            while(tokens)
+            {
+                pOut->push_back(base + CountTrailingZeros(tokens));
+                tokens &= tokens - 1;
+            }
+        }
+
+        static inline void ScalarMasks(const char* pBlock, CBlockMasks& masks)
+        {
+            masks.quote = masks.backslash = masks.op = masks.whitespace = masks.control = 0;
+            for(unsigned i = 0; i < 64; i++)
+            {
+                unsigned char c = (unsigned char)pBlock[i];
+                uint64_t bit = uint64_t(1) << i;
+                switch(c)
+                {
+                    case '"':  masks.quote |= bit; break;
+                    case '\\': masks.backslash |= bit; break;
+                    case '{': case '}': case '[': case ']': case ':': case ',':
+                        masks.op |= bit; break;
+                    case ' ':  masks.whitespace |= bit; break;
+                    case '\t': case '\n': case '\r':
+                        masks.whitespace |= bit; masks.control |= bit; break;
+                    default:
+                        if(c < 0x20) masks.control |= bit;
+                        break;
+                }
+            }
+        }
+
+        // The last partial block is copied into a buffer padded with spaces.
+        static inline const char* LastBlock(const char* pBuffer, size_t size, size_t offset, char* pPadded)
+        {
+            memset(pPadded, ' ', 64);
+            memcpy(pPadded, pBuffer + offset, size - offset);
+            return pPadded;
+        }
+
+        static void ScanScalar(const char* pBuffer, size_t size, size_t begin, size_t end, CScanState& state, std::vector<uint32_t>* pOut)
+        {
+            CBlockMasks masks;
+            char padded[64];
+            for(size_t offset = begin; offset < end; offset += 64)
+            {
+                const char* pBlock = (size - offset >= 64) ? pBuffer + offset : LastBlock(pBuffer, size, offset, padded);
+                ScalarMasks(pBlock, masks);
+                ProcessBlock(masks, uint32_t(offset), state, pOut);
+            }
+        }
+
+    #ifdef JSON_STRUCTURAL_INDEX_X86
+        __attribute__((target("sse2")))
+        static inline uint64_t MaskSSE2(__m128i a, __m128i b, __m128i c, __m128i d)
+        {
+            return uint64_t(uint16_t(_mm_movemask_epi8(a)))
+                | (uint64_t(uint16_t(_mm_movemask_epi8(b))) << 16)
+                | (uint64_t(uint16_t(_mm_movemask_epi8(c))) << 32)
+                | (uint64_t(uint16_t(_mm_movemask_epi8(d))) << 48);
+        }
+
+        __attribute__((target("sse2")))
+        static void ScanSSE2(const char* pBuffer, size_t size, size_t begin, size_t end, CScanState& state, std::vector<uint32_t>* pOut)
+        {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i lower = _mm_set1_epi8(0x20);  // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+            const __m128i open = _mm_set1_epi8('{');
+            const __m128i close = _mm_set1_epi8('}');
+            const __m128i colon = _mm_set1_epi8(':');
+            const __m128i comma = _mm_set1_epi8(',');
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i newline = _mm_set1_epi8('\n');
+            const __m128i ret = _mm_set1_epi8('\r');
+            const __m128i ctrl = _mm_set1_epi8(0x1F);
+
+            CBlockMasks masks;
+            char padded[64];
+            for(size_t offset = begin; offset < end; offset += 64)
+            {
+                const char* pBlock = (size - offset >= 64) ? pBuffer + offset : LastBlock(pBuffer, size, offset, padded);
+                __m128i v[4], q[4], b[4], o[4], w[4], c[4];
+                for(int i = 0; i < 4; i++)
+                {
+                    v[i] = _mm_loadu_si128((const __m128i*)(pBlock + 16 * i));
+                    __m128i l = _mm_or_si128(v[i], lower);
+                    q[i] = _mm_cmpeq_epi8(v[i], quote);
+                    b[i] = _mm_cmpeq_epi8(v[i], backslash);
+                    o[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(l, open), _mm_cmpeq_epi8(l, close)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(v[i], colon), _mm_cmpeq_epi8(v[i], comma)));
+                    w[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v[i], space), _mm_cmpeq_epi8(v[i], tab)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(v[i], newline), _mm_cmpeq_epi8(v[i], ret)));
+                    c[i] = _mm_cmpeq_epi8(_mm_min_epu8(v[i], ctrl), v[i]);
+                }
+                masks.quote = MaskSSE2(q[0], q[1], q[2], q[3]);
+                masks.backslash = MaskSSE2(b[0], b[1], b[2], b[3]);
+                masks.op = MaskSSE2(o[0], o[1], o[2], o[3]);
+                masks.whitespace = MaskSSE2(w[0], w[1], w[2], w[3]);
+                masks.control = MaskSSE2(c[0], c[1], c[2], c[3]);
+                ProcessBlock(masks, uint32_t(offset), state, pOut);
+            }
+        }
+
+        __attribute__((target("avx2")))
+        static inline uint64_t MaskAVX2(__m256i a, __m256i b)
+        {
+            return uint64_t(uint32_t(_mm256_movemask_epi8(a))) | (uint64_t(uint32_t(_mm256_movemask_epi8(b))) << 32);
+        }
+
+        __attribute__((target("avx2")))
+        static void ScanAVX2(const char* pBuffer, size_t size, size_t begin, size_t end, CScanState& state, std::vector<uint32_t>* pOut)
+        {
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i lower = _mm256_set1_epi8(0x20);
+            const __m256i open = _mm256_set1_epi8('{');
+            const __m256i close = _mm256_set1_epi8('}');
+            const __m256i colon = _mm256_set1_epi8(':');
+            const __m256i comma = _mm256_set1_epi8(',');
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i newline = _mm256_set1_epi8('\n');
+            const __m256i ret = _mm256_set1_epi8('\r');
+            const __m256i ctrl = _mm256_set1_epi8(0x1F);
+
+            CBlockMasks masks;
+            char padded[64];
+            for(size_t offset = begin; offset < end; offset += 64)
+            {
+                const char* pBlock = (size - offset >= 64) ? pBuffer + offset : LastBlock(pBuffer, size, offset, padded);
+                __m256i v[2], q[2], b[2], o[2], w[2], c[2];
+                for(int i = 0; i < 2; i++)
+                {
+                    v[i] = _mm256_loadu_si256((const __m256i*)(pBlock + 32 * i));
+                    __m256i l = _mm256_or_si256(v[i], lower);
+                    q[i] = _mm256_cmpeq_epi8(v[i], quote);
+                    b[i] = _mm256_cmpeq_epi8(v[i], backslash);
+                    o[i] = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(l, open), _mm256_cmpeq_epi8(l, close)),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(v[i], colon), _mm256_cmpeq_epi8(v[i], comma)));
+                    w[i] = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v[i], space), _mm256_cmpeq_epi8(v[i], tab)),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(v[i], newline), _mm256_cmpeq_epi8(v[i], ret)));
+                    c[i] = _mm256_cmpeq_epi8(_mm256_min_epu8(v[i], ctrl), v[i]);
+                }
+                masks.quote = MaskAVX2(q[0], q[1]);
+                masks.backslash = MaskAVX2(b[0], b[1]);
+                masks.op = MaskAVX2(o[0], o[1]);
+                masks.whitespace = MaskAVX2(w[0], w[1]);
+                masks.control = MaskAVX2(c[0], c[1]);
+                ProcessBlock(masks, uint32_t(offset), state, pOut);
+            }
+        }
+    #endif
+
+    private:
+        const char*                 m_pText;
+        size_t                      m_Size;
+        std::vector<CScanState>     m_States;   // at the start of each chunk.
+};
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+//
+//  json_thread_pool.h
+//
+//  Fixed size pool of worker threads used to parse large arrays in
+//  parallel. Requires c++11; with an older compiler the class is not
+//  defined and everything runs on the calling thread.
+//
+
+#ifndef JSON_THREAD_POOL_H
+#define JSON_THREAD_POOL_H
+
+#if __cplusplus >= 201103L
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace json {
+
+class CJSONThreadPool
+{
+    public:
+        // threads == 0 uses one thread per hardware thread. The calling
+        // thread also does work in ParallelFor so one less is started.
+        CJSONThreadPool(size_t threads = 0) : m_bStop(false)
+        {
+            if(threads == 0)
+                threads = std::thread::hardware_concurrency();
+            if(threads == 0)
+                threads = 1;
+
+            for(size_t i = 1; i < threads; i++)
+            {
+                m_Workers.push_back(std::thread(&CJSONThreadPool::WorkerLoop, this));
+            }
+        }
+
+        ~CJSONThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_bStop = true;
+            }
+            m_Wake.notify_all();
+            for(size_t i = 0; i < m_Workers.size(); i++)
+            {
+                m_Workers[i].join();
+            }
+        }
+
+        CJSONThreadPool(const CJSONThreadPool&) = delete;
+        CJSONThreadPool& operator=(const CJSONThreadPool&) = delete;
+
+        // Number of threads that take part in ParallelFor, caller included.
+        size_t GetThreadCount() const { return m_Workers.size() + 1; }
+
+        void Submit(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Tasks.push_back(std::move(task));
+            }
+            m_Wake.notify_one();
+        }
+
+        // Calls body(i) for every i in [0, count) and returns when all of
+        // them are done. Indices are handed out one at a time from a shared
+        // counter so a thread that finishes early takes the next one; the
+        // caller works too, so nested calls can not dead lock.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& body)
+        {
+            if(count == 0)
+                return;
+
+            std::shared_ptr<CForState> state = std::make_shared<CForState>(count, body);
+            size_t helpers = std::min(m_Workers.size(), count - 1);
+            for(size_t i = 0; i < helpers; i++)
+            {
+                Submit([state]() { state->Run(); });
+            }
+
+            state->Run();
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->done.wait(lock, [&state]() { return state->finished == state->count; });
+        }
+
+    private:
+        struct CForState
+        {
+            CForState(size_t n, const std::function<void(size_t)>& fn) : count(n), next(0), finished(0), body(fn) {}
+
+            void Run()
+            {
+                size_t ran = 0;
+                for(size_t i = next++; i < count; i = next++)
+                {
+                    body(i);
+                    ran++;
+                }
+
+                if(ran > 0)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished += ran;
+                    if(finished == count)
+                        done.notify_all();
+                }
+            }
+
+            const size_t                        count;
+            std::atomic<size_t>                 next;
+            size_t                              finished;   // guarded by mutex
+            std::function<void(size_t)>         body;
+            std::mutex                          mutex;
+            std::condition_variable             done;
+        };
+
+        void WorkerLoop()
+        {
+            for(;;)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Wake.wait(lock, [this]() { return m_bStop || !m_Tasks.empty(); });
+                    if(m_Tasks.empty())
+                        return; // stopping
+                    task = std::move(m_Tasks.front());
+                    m_Tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+    private:
+        std::vector<std::thread>                m_Workers;
+        std::deque< std::function<void()> >     m_Tasks;
+        std::mutex                              m_Mutex;
+        std::condition_variable                 m_Wake;
+        bool                                    m_bStop;
+};
+
+}
+
+#endif // c++11
+
+#endif
@@ -0,0 +1,217 @@
+//
+//  json_trace.h
+//
+//  Spans around the loads, parses and dumps of CJSONParser and around the
+//  members CJSONValueObject parses and dumps, written as Chrome trace
+//  events (chrome://tracing, ui.perfetto.dev). Nested members nest, so the
+//  flame view shows which sub-object ("indent", "ObjectArray") the time
+//  goes to.
+//
+//  Built in with JSON_TRACE (and c++11); without it the hooks are empty
+//  macros. Built in, a span costs one atomic load until tracing is started
+//  with CJSONTrace::Start and two clock reads and a copy of its name into
+//  a buffer of the thread while it runs. CJSONTrace::Stop writes the file.
+//  Threads of the parser's pool record into buffers of their own.
+//
+
+#ifndef JSON_TRACE_H
+#define JSON_TRACE_H
+
+#ifndef JSON_TRACE
+#define JSON_TRACE 0
+#endif
+
+#if JSON_TRACE && __cplusplus < 201103L
+    #undef JSON_TRACE
+    #define JSON_TRACE 0
+#endif
+
+#if JSON_TRACE
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+namespace json {
+
+// Longer names are cut.
+#ifndef JSON_TRACE_NAME_SIZE
+#define JSON_TRACE_NAME_SIZE 48
+#endif
+
+class CJSONTrace
+{
+    public:
+        // Starts recording, into Path when stopped. false if already started.
+        static bool Start(const std::string& Path)
+        {
+            CState& state = GetState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if(state.bStarted)
+                return false;
+            state.path = Path;
+            state.start = Now();
+            for(size_t i = 0; i < state.threads.size(); i++)
+                state.threads[i]->events.clear();
+            state.bStarted = true;
+            return true;
+        }
+
+        // Stops recording and writes the events. Spans still open on other
+        // threads are dropped.
+        static bool Stop()
+        {
+            CState& state = GetState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if(!state.bStarted)
+                return false;
+            state.bStarted = false;
+
+            FILE* pFile = fopen(state.path.c_str(), "w");
+            if(!pFile)
+            {
+                perror("Error writing trace");
+                return false;
+            }
+            fprintf(pFile, "{\"traceEvents\":[");
+            bool bFirst = true;
+            for(size_t i = 0; i < state.threads.size(); i++)
+            {
+                std::lock_guard<std::mutex> threadLock(state.threads[i]->mutex);
+                std::vector<CEvent>& events = state.threads[i]->events;
+                for(size_t j = 0; j < events.size(); j++)
+                {
+                    fprintf(pFile, "%s\n{\"name\":\"", bFirst ? "" : ",");
+                    WriteName(pFile, events[j].name);
+                    fprintf(pFile, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu}", events[j].category, events[j].start, events[j].duration, i + 1);
+                    bFirst = false;
+                }
+                events.clear();
+            }
+            fprintf(pFile, "\n]}\n");
+            return fclose(pFile) == 0;
+        }
+
+        static bool IsStarted() { return GetState().bStarted.load(std::memory_order_relaxed); }
+
+        class CSpan
+        {
+            public:
+                CSpan(const char* category, const std::string& name) : m_Start(-1) { if(IsStarted()) Begin(category, name.data(), name.size()); }
+                CSpan(const char* category, const char* name) : m_Start(-1) { if(IsStarted()) Begin(category, name, strlen(name)); }
+                ~CSpan()
+                {
+                    if(m_Start < 0 || !IsStarted())
+                        return;
+                    CThread& thread = GetThread();
+                    std::lock_guard<std::mutex> lock(thread.mutex);
+                    CEvent event;
+                    memcpy(event.name, m_Name, sizeof(m_Name));
+                    event.category = m_Category;
+                    event.start = m_Start;
+                    event.duration = Now() - GetState().start - m_Start;
+                    thread.events.push_back(event);
+                }
+
+            private:
+                CSpan(const CSpan&);
+                CSpan& operator=(const CSpan&);
+
+                void Begin(const char* category, const char* name, size_t length)
+                {
+                    if(length >= sizeof(m_Name))
+                        length = sizeof(m_Name) - 1;
+                    memcpy(m_Name, name, length);
+                    m_Name[length] = 0;
+                    m_Category = category;
+                    m_Start = Now() - GetState().start;
+                }
+
+                char        m_Name[JSON_TRACE_NAME_SIZE];
+                const char* m_Category;
+                double      m_Start;    // microseconds since Start, -1 if not recording.
+        };
+
+    private:
+        struct CEvent
+        {
+            char        name[JSON_TRACE_NAME_SIZE];
+            const char* category;   // a literal.
+            double      start;
+            double      duration;
+        };
+
+        // The events of one thread. Kept by the state, so they outlive it.
+        struct CThread
+        {
+            std::mutex              mutex;  // only contended by Start and Stop.
+            std::vector<CEvent>     events;
+        };
+
+        struct CState
+        {
+            CState() : bStarted(false), start(0) {}
+            std::mutex                              mutex;
+            std::atomic<bool>                       bStarted;
+            std::string                             path;
+            double                                  start;
+            std::vector< std::unique_ptr<CThread> > threads;
+        };
+
+        static CState& GetState()
+        {
+            static CState state;
+            return state;
+        }
+
+        static CThread& GetThread()
+        {
+            static thread_local CThread* pThread = NULL;
+            if(!pThread)
+            {
+                CState& state = GetState();
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.threads.push_back(std::unique_ptr<CThread>(new CThread()));
+                pThread = state.threads.back().get();
+            }
+            return *pThread;
+        }
+
+        static double Now()
+        {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        static void WriteName(FILE* pFile, const char* name)
+        {
+            for(; *name; name++)
+            {
+                unsigned char c = (unsigned char)*name;
+                if(c == '"' || c == '\\')
+                    fprintf(pFile, "\\%c", c);
+                else if(c < 0x20)
+                    fprintf(pFile, "\\u%04x", c);
+                else
+                    fputc(c, pFile);
+            }
+        }
+};
+
+}
+
+#define JSON_TRACE_CONCAT_(a, b)            a##b
+#define JSON_TRACE_CONCAT(a, b)             JSON_TRACE_CONCAT_(a, b)
+#define JSON_TRACE_SPAN(category, name)     json::CJSONTrace::CSpan JSON_TRACE_CONCAT(json_trace_span_, __LINE__)(category, name)
+
+#else
+
+#define JSON_TRACE_SPAN(category, name)
+
+#endif
+
+#endif
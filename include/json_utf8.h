@@ -0,0 +1,85 @@
+//
+//  json_utf8.h
+//
+//  UTF-8 validation shared by CJSONReader and CJSONWriter, so the
+//  streaming parse takes the strings jansson takes: no overlong forms,
+//  no UTF-16 surrogates (U+D800 to U+DFFF), nothing above U+10FFFF.
+//
+
+#ifndef JSON_UTF8_H
+#define JSON_UTF8_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+namespace json {
+
+class CJSONUTF8
+{
+    public:
+        // Decodes one UTF-8 sequence at p, 0 if it is not valid.
+        static size_t Decode(const unsigned char* p, const unsigned char* pEnd, unsigned int& codepoint)
+        {
+            unsigned char c = p[0];
+            size_t length = 0;
+            if(c < 0x80)            { codepoint = c; return 1; }
+            else if(c < 0xC2)       return 0; // continuation byte or overlong.
+            else if(c < 0xE0)       { length = 2; codepoint = c & 0x1F; }
+            else if(c < 0xF0)       { length = 3; codepoint = c & 0x0F; }
+            else if(c < 0xF5)       { length = 4; codepoint = c & 0x07; }
+            else                    return 0;
+
+            if(size_t(pEnd - p) < length)
+                return 0;
+            for(size_t i = 1; i < length; i++)
+            {
+                if((p[i] & 0xC0) != 0x80)
+                    return 0;
+                codepoint = (codepoint << 6) | (p[i] & 0x3F);
+            }
+
+            if(codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+                return 0;
+            if((length == 3 && codepoint < 0x800) || (length == 4 && codepoint < 0x10000))
+                return 0; // overlong.
+            return length;
+        }
+
+        static bool IsValid(const std::string& str)
+        {
+            const unsigned char* p = (const unsigned char*)str.data();
+            const unsigned char* end = p + str.size();
+            while(p < end)
+            {
+                // ASCII runs are checked eight bytes at a time.
+                while(size_t(end - p) >= 8)
+                {
+                    uint64_t word;
+                    memcpy(&word, p, 8);
+                    if(word & 0x8080808080808080ULL)
+                        break;
+                    p += 8;
+                }
+                if(p >= end)
+                    break;
+
+                if(*p < 0x80)
+                {
+                    p++;
+                    continue;
+                }
+
+                unsigned int codepoint;
+                size_t n = Decode(p, end, codepoint);
+                if(n == 0)
+                    return false;
+                p += n;
+            }
+            return true;
+        }
+};
+
+}
+
+#endif
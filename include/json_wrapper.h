@@ -10,6 +10,16 @@
 // the only include for json. the following link shows how to install
 // https://github.com/akheron/jansson/blob/2.6/doc/gettingstarted.rst
 #include <jansson.h>
+#include "json_reader.h"
+#include "json_writer.h"
+#include "json_mapped_file.h"
+#include "json_replace_file.h"
+#include "json_thread_pool.h"
+#include "json_field_table.h"
+#include "json_arena.h"
+#include "json_pointer.h"
+#include "json_stats.h"
+#include "json_trace.h"
 
 // Standard library headers
 #include <cmath>
@@ -20,8 +30,12 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <stdarg.h>
 #include <memory>
+#include <limits>
+#include <stdint.h>
+#include <typeinfo>
 
 #if __cplusplus >= 201103L
 // Needed for the std::tuple class.
@@ -35,6 +49,13 @@
 
 #endif
 
+// Arrays of objects in streaming mode are split into chunks of at least
+// this many elements when a thread pool is set; smaller arrays stay on the
+// calling thread.
+#ifndef JSON_PARALLEL_CHUNK_MIN
+#define JSON_PARALLEL_CHUNK_MIN 256
+#endif
+
 
 namespace json {
 using namespace std;
@@ -74,8 +95,227 @@ struct memory_ptr
 
 #define JSON_OBJECT_TRACK_MISSING_VALUES_DEFAULT true
 
+// When true CJSONParser keeps the text and binds straight from it in
+// ParseObject instead of building a jansson tree at load time. The load
+// then only checks the start of the text: malformed text is found by
+// ParseObject, and the members bound before the error keep their new
+// values. Opt in per parser with SetStreaming or the constructor.
+#ifndef JSON_PARSER_STREAMING_DEFAULT
+#define JSON_PARSER_STREAMING_DEFAULT false
+#endif
+
+// When true LoadFromFile in streaming mode maps the file instead of
+// reading it into memory (see json_mapped_file.h).
+#ifndef JSON_PARSER_MEMORY_MAP_DEFAULT
+#define JSON_PARSER_MEMORY_MAP_DEFAULT false
+#endif
+
+// When true UpdateObjectToFile writes changed values over the old ones in
+// the file when they fit, instead of rewriting the file. It is faster for
+// large files but not crash safe: a crash or a full disk part way leaves a
+// file with some values changed, or a value cut short.
+#ifndef JSON_PARSER_PATCH_IN_PLACE_DEFAULT
+#define JSON_PARSER_PATCH_IN_PLACE_DEFAULT false
+#endif
+
+// When true DOM loads build the jansson tree in the parser's arena (see
+// json_arena.h). It points jansson's allocation functions at the arena
+// hooks for the whole program, so it is off unless asked for with
+// SetArena.
+#ifndef JSON_PARSER_ARENA_DEFAULT
+#define JSON_PARSER_ARENA_DEFAULT false
+#endif
+
+// When true the instances of a CJSONValueObject type share one table of
+// field bindings (see json_field_table.h) instead of each allocating a
+// map of CJSONValue objects in SetupJSONObject.
+//
+// IMPORTANT: SetupJSONObject must then bind the same members under the
+// same names for every instance of the type. A type whose instances bind
+// differently (depending on a member, say) opts out with
+// CJSONSharedFields. Instances of classes derived from the type do not
+// use its table, they keep a map of their own and may bind more.
+#ifndef JSON_OBJECT_SHARED_FIELDS
+#define JSON_OBJECT_SHARED_FIELDS true
+#endif
+
+// When true a CJSONValueObject keeps its last dump and reuses it until it
+// is told of a change (see CJSONValueObject::SetCacheDumps).
+#ifndef JSON_OBJECT_DUMP_CACHE_DEFAULT
+#define JSON_OBJECT_DUMP_CACHE_DEFAULT false
+#endif
+
+// Start value of CJSONDumpCheck, which finds the changes the dump caches
+// were not told of.
+#ifndef JSON_OBJECT_DUMP_CACHE_CHECK
+#define JSON_OBJECT_DUMP_CACHE_CHECK false
+#endif
+
 template<class DerivedClass> class CJSONValueObject;
 
+// A member of an object written on its own, see CJSONValueObject::WriteMembers.
+struct CJSONMemberText
+{
+    std::string name;
+    std::string text;       // "name": value, as inside the root object.
+    size_t      valueBegin; // where value starts in text.
+};
+
+class CJSONValue;
+
+// A piece of a kept write that is the kept write of another object, see
+// CJSONValueObject::SetCacheDumps.
+struct CJSONDumpSplice
+{
+    size_t          offset;     // in the text it is spliced into.
+    size_t          depth;      // it is written at.
+    CJSONValue*     pObject;
+    bool            (*write)(CJSONValue* pObject, CJSONWriter& writer, size_t depth);
+};
+
+// The dump on this thread of an object that caches its dumps (see
+// CJSONValueObject::SetCacheDumps): the object, which the elements of its
+// arrays tell of their changes, the writer its text goes to and where the
+// objects bound in it are spliced in, and whether what it wrote can be
+// kept. It can not once something was written through a pointer, the
+// object behind it does not tell this one of its changes.
+class CJSONDumpScope
+{
+    private:
+        struct CState
+        {
+            CJSONValue*                     pObject;
+            CJSONWriter*                    pWriter;
+            std::vector<CJSONDumpSplice>*   pSplices;
+            bool                            bKeep;
+        };
+
+        static CState& Current()
+        {
+        #if __cplusplus >= 201103L
+            static thread_local CState state = { NULL, NULL, NULL, true };
+        #else
+            static CState state = { NULL, NULL, NULL, true }; // no threads without c++11.
+        #endif
+            return state;
+        }
+
+    public:
+        CJSONDumpScope(CJSONValue* pObject, CJSONWriter* pWriter = NULL, std::vector<CJSONDumpSplice>* pSplices = NULL) : m_Previous(Current())
+        {
+            CState& state = Current();
+            state.pObject = pObject;
+            state.pWriter = pWriter;
+            state.pSplices = pSplices;
+            state.bKeep = true;
+        }
+        ~CJSONDumpScope()
+        {
+            bool bKeep = Current().bKeep;
+            Current() = m_Previous;
+            Current().bKeep = Current().bKeep && bKeep;
+        }
+
+        bool CanKeep() const { return Current().bKeep; }
+
+        static CJSONValue* GetObject() { return Current().pObject; }
+
+        // An object with a kept write that goes to writer is spliced in.
+        static bool CanSplice(const CJSONWriter& writer) { return Current().pWriter == &writer && Current().pSplices; }
+        static void AddSplice(const CJSONDumpSplice& splice) { Current().pSplices->push_back(splice); }
+
+        // The elements of arrays move and go away while the text is kept,
+        // so objects written by an array are copied into it.
+        class CElements
+        {
+            public:
+                CElements() : m_pWriter(Current().pWriter) { Current().pWriter = NULL; }
+                ~CElements() { Current().pWriter = m_pWriter; }
+
+            private:
+                CElements(const CElements&);
+                CElements& operator=(const CElements&);
+
+                CJSONWriter*    m_pWriter;
+        };
+
+        // What is written through a pointer is not kept, and the elements
+        // of the object behind it are not told of the one being written.
+        class CPointer
+        {
+            public:
+                CPointer() : m_Previous(Current())
+                {
+                    Current().pObject = NULL;
+                    Current().pWriter = NULL;
+                    Current().bKeep = false;
+                }
+                ~CPointer()
+                {
+                    m_Previous.bKeep = false;
+                    Current() = m_Previous;
+                }
+
+            private:
+                CPointer(const CPointer&);
+                CPointer& operator=(const CPointer&);
+
+                CState  m_Previous;
+        };
+
+    private:
+        CJSONDumpScope(const CJSONDumpScope&);
+        CJSONDumpScope& operator=(const CJSONDumpScope&);
+
+        CState  m_Previous;
+};
+
+// Debug check that the objects which cache their dumps are told of every
+// change. When on, such an object writes a CBOR snapshot of itself before
+// each dump and, if it is not the one of its last checked dump, drops its
+// caches, with a warning when they were still thought good. Costs a full write per caching object
+// and dump. Set it before dumping on other threads.
+class CJSONDumpCheck
+{
+    public:
+        static bool IsEnabled() { return Enabled(); }
+        static void SetEnabled(bool bEnabled) { Enabled() = bEnabled; }
+
+        // A snapshot is being written, the objects inside write themselves
+        // without their caches.
+        static bool IsChecking() { return Checking(); }
+
+        class CScope
+        {
+            public:
+                CScope() : m_bPrevious(Checking()) { Checking() = true; }
+                ~CScope() { Checking() = m_bPrevious; }
+
+            private:
+                CScope(const CScope&);
+                CScope& operator=(const CScope&);
+
+                bool    m_bPrevious;
+        };
+
+    private:
+        static bool& Enabled()
+        {
+            static bool bEnabled = JSON_OBJECT_DUMP_CACHE_CHECK;
+            return bEnabled;
+        }
+
+        static bool& Checking()
+        {
+        #if __cplusplus >= 201103L
+            static thread_local bool bChecking = false;
+        #else
+            static bool bChecking = false;
+        #endif
+            return bChecking;
+        }
+};
+
 
 class CJSONValue
 {
@@ -84,7 +324,11 @@ class CJSONValue
         {
             m_type = type;
             m_name = name;
+            m_pNameRef = NULL;
             m_pJValue = NULL;
+            m_pParent = NULL;
+            m_pOwner = NULL;
+            m_Index = 0;
         }
         virtual ~CJSONValue()
         {
@@ -95,7 +339,45 @@ class CJSONValue
         virtual bool Parse (const json_t* pVal) = 0;
         virtual bool Dump (json_t*& pRet) = 0;
 
+    // Streaming parse. The reader is positioned on the value for this
+    // object and the value must be consumed. Classes that do not override
+    // this build the jansson value and use the method above.
+        virtual bool Parse (CJSONReader& reader)
+        {
+            json_t* pVal = reader.ReadValue();
+            bool bParseSuccess = (pVal != NULL) && Parse((const json_t*)pVal);
+            json_decref(pVal);
+            return bParseSuccess;
+        }
+
+    // Streaming dump. Writes the value as text, no jansson value is kept.
+    // Classes that do not override this dump and write the jansson value.
+        virtual bool Write (CJSONWriter& writer)
+        {
+            json_t* pVal = NULL;
+            bool bWriteSuccess = Dump(pVal) && writer.WriteValue(pVal);
+            ClearJValue();
+            return bWriteSuccess;
+        }
+
         virtual void Setup(size_t argc, ...) { cout << "passed in "<< argc << " arguments." << endl; } // to make virtual abstract?
+
+        // Puts the bound value back to its default so the next Parse starts
+        // from a clean value. Used when one object is reused for many records.
+        virtual void Reset() {}
+
+        // The bound value was changed since it was last dumped. Only objects
+        // keep dumps (see CJSONValueObject::SetCacheDumps), the others pass
+        // it on to the object they are bound in.
+        virtual void SetModified()
+        {
+            if(m_pOwner)
+                m_pOwner->SetModified();
+        }
+        virtual void SetCacheDumps(bool) {}
+
+        // Drops the buffer of the last Dump unless it is kept as a cache.
+        virtual void ClearBuffer() { ClearJValue(); }
     // Class Method
         void ClearJValue()
         {
@@ -103,8 +385,29 @@ class CJSONValue
             m_pJValue = NULL;
         }
     // Accessor Methods
-        const std::string& GetName() const { return m_name; }
-        void SetName(std::string name ) { m_name = name; }
+        const std::string& GetName() const { return m_pNameRef ? *m_pNameRef : m_name; }
+        void SetName(std::string name ) { m_name = name; m_pNameRef = NULL; }
+        // Uses *pName, which must outlive the value, as its name instead of
+        // a copy. For the short lived bindings made from a field table.
+        void SetNameRef(const std::string* pName) { m_pNameRef = pName; }
+
+        // Name used in messages. Array elements are made without a name and
+        // point at their array instead; "array-index" is only put together
+        // when something has to be reported.
+        std::string GetPath() const
+        {
+            if(!m_pParent)
+                return GetName();
+            char array_number[30]; // should be enough space.
+            sprintf(&array_number[0], "-%zu", m_Index);
+            return m_pParent->GetPath() + std::string(array_number);
+        }
+        void SetParent(const CJSONValue* pParent, size_t index) { m_pParent = pParent; m_Index = index; }
+        // The object this value is bound in with AddObjectValue, or for an
+        // element the object that dumped its array while caching its dumps.
+        void SetOwner(CJSONValue* pOwner) { m_pOwner = pOwner; }
+        const CJSONValue* GetParent() const { return m_pParent; }
+        size_t GetIndex() const { return m_Index; }
 
         bool IsInt()    { return m_type == JSON_INTEGER; }
         bool IsFloat()  { return m_type == JSON_REAL; }
@@ -154,6 +457,67 @@ class CJSONValue
         json_t*         m_pJValue;  // buffer to hold values for dump on create in the dump command.
         json_type       m_type;
         std::string     m_name;
+        const std::string* m_pNameRef;  // used instead of m_name when set.
+        const CJSONValue* m_pParent;  // array this value is an element of, or NULL.
+        CJSONValue*     m_pOwner;   // object told of changes, see SetOwner, or NULL.
+        size_t          m_Index;
+};
+
+// Lends the path of one value to another for the length of a call, e.g. to
+// the value a pointer binding points to, which may outlive the array.
+class CJSONPathScope
+{
+    public:
+        CJSONPathScope(CJSONValue* pValue, const CJSONValue* pFrom) : m_pValue(pValue)
+        {
+            m_pValue->SetParent(pFrom->GetParent(), pFrom->GetIndex());
+        }
+        ~CJSONPathScope()
+        {
+            m_pValue->SetParent(NULL, 0);
+        }
+    private:
+        CJSONValue*     m_pValue;
+};
+
+// Puts an integer given as sign and magnitude into NVal if it fits, so a
+// value too big for the member is reported instead of wrapping around.
+template< class NVal, bool _integer_ = std::numeric_limits<NVal>::is_integer >
+struct CJSONIntegerRange
+{
+    static bool Convert(bool, uint64_t, NVal&) { return false; }
+    static bool FitsInJSON(const NVal&) { return true; }
+};
+
+template< class NVal >
+struct CJSONIntegerRange<NVal, true>
+{
+    static bool Convert(bool bNegative, uint64_t magnitude, NVal& value)
+    {
+        if(magnitude == 0)
+        {
+            value = 0;
+        }
+        else if(bNegative)
+        {
+            if(!std::numeric_limits<NVal>::is_signed || magnitude - 1 > uint64_t(-(std::numeric_limits<NVal>::min() + 1)))
+                return false;
+            value = NVal(-NVal(magnitude - 1) - 1);
+        }
+        else
+        {
+            if(magnitude > uint64_t(std::numeric_limits<NVal>::max()))
+                return false;
+            value = NVal(magnitude);
+        }
+        return true;
+    }
+
+    // jansson integers are json_int_t, unsigned 64 bit values may not fit.
+    static bool FitsInJSON(const NVal& value)
+    {
+        return std::numeric_limits<NVal>::is_signed || uint64_t(value) <= uint64_t(std::numeric_limits<json_int_t>::max());
+    }
 };
 
 template< class NVal, json_type _type_ >
@@ -170,13 +534,47 @@ class CJSONValueNumber : public CJSONValue // may need an unsigned version of th
         {
             bool bParseSuccess = false;
 
-            if(json_is_number(pVal))
+            if(json_is_integer(pVal) && std::numeric_limits<NVal>::is_integer)
+            {
+                json_int_t value = json_integer_value(pVal); // exact, not through a double.
+                bool bNegative = value < 0;
+                bParseSuccess = SetInteger(bNegative, bNegative ? uint64_t(-(value + 1)) + 1 : uint64_t(value));
+            }
+            else if(json_is_number(pVal))
             {
                 bParseSuccess = true;
                 *m_pValue = NVal(json_number_value(pVal)); // Always casts to a double so we have to cast it back.
             }
             else{
-                fprintf(stderr, "ERROR: %s is not an number (%s) as expected. \n", m_name.c_str(), TypeToString().c_str());
+                fprintf(stderr, "ERROR: %s is not an number (%s) as expected. \n", GetPath().c_str(), TypeToString().c_str());
+            }
+            return bParseSuccess;
+        }
+
+        bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_INTEGER && std::numeric_limits<NVal>::is_integer)
+            {
+                // straight from the digits, the full range of 64 bit types.
+                bool bNegative = false;
+                uint64_t magnitude = 0;
+                bParseSuccess = reader.ReadInteger(bNegative, magnitude) && SetInteger(bNegative, magnitude);
+            }
+            else if(type == JSON_INTEGER || type == JSON_REAL)
+            {
+                double value = 0;
+                bParseSuccess = reader.ReadNumber(value);
+                if(bParseSuccess)
+                    *m_pValue = NVal(value);
+            }
+            else{
+                fprintf(stderr, "ERROR: %s is not an number (%s) as expected. \n", GetPath().c_str(), TypeToString().c_str());
+                reader.SkipValue();
             }
             return bParseSuccess;
         }
@@ -186,11 +584,14 @@ class CJSONValueNumber : public CJSONValue // may need an unsigned version of th
             ClearJValue();
             if( std::isnan(*m_pValue) || std::isinf(*m_pValue))
             {
-                cout << "Warning! trying to dump nan/inf value to " << m_name << endl;
+                cout << "Warning! trying to dump nan/inf value to " << GetPath() << endl;
             }
             if(IsInt())
             {
-                pRet = json_integer(*m_pValue);
+                if(CJSONIntegerRange<NVal>::FitsInJSON(*m_pValue))
+                    pRet = json_integer(json_int_t(*m_pValue));
+                else
+                    cout << "Error! " << GetPath() << " is too big for a json integer." << endl;
             }
             else
             {
@@ -201,10 +602,39 @@ class CJSONValueNumber : public CJSONValue // may need an unsigned version of th
             return pRet != NULL;
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            if( std::isnan(*m_pValue) || std::isinf(*m_pValue))
+            {
+                cout << "Warning! trying to dump nan/inf value to " << GetPath() << endl;
+            }
+            if(IsInt() && !CJSONIntegerRange<NVal>::FitsInJSON(*m_pValue))
+                return writer.UnsignedInteger(uint64_t(*m_pValue)); // the text has no limit.
+            if(IsInt())
+                return writer.Integer(json_int_t(*m_pValue));
+            return WriteReal(writer, *m_pValue);
+        }
+
+        void Reset() { *m_pValue = m_DefaultValue; }
+
     // Accessor Methods
         const NVal& GetValue() const { return *m_pValue; }
         const NVal& GetDefaultValue() const { return m_DefaultValue; }
 
+    private:
+        bool SetInteger(bool bNegative, uint64_t magnitude)
+        {
+            if(CJSONIntegerRange<NVal>::Convert(bNegative, magnitude, *m_pValue))
+                return true;
+            fprintf(stderr, "ERROR: %s is out of range for its type (%s%llu). \n", GetPath().c_str(), bNegative ? "-" : "", (unsigned long long)magnitude);
+            return false;
+        }
+
+        // floats are written with float precision.
+        static bool WriteReal(CJSONWriter& writer, float value) { return writer.Real(value); }
+        template<class T>
+        static bool WriteReal(CJSONWriter& writer, const T& value) { return writer.Real(double(value)); }
+
     private:
         NVal  m_DefaultValue;
         NVal* m_pValue;
@@ -212,6 +642,10 @@ class CJSONValueNumber : public CJSONValue // may need an unsigned version of th
 
 typedef CJSONValueNumber<int, JSON_INTEGER>         CJSONValueInt;
 typedef CJSONValueNumber<size_t, JSON_INTEGER>      CJSONValueUInt;
+typedef CJSONValueNumber<int64_t, JSON_INTEGER>     CJSONValueInt64;
+typedef CJSONValueNumber<uint64_t, JSON_INTEGER>    CJSONValueUInt64;
+typedef CJSONValueNumber<int16_t, JSON_INTEGER>     CJSONValueInt16;
+typedef CJSONValueNumber<uint8_t, JSON_INTEGER>     CJSONValueUInt8;
 typedef CJSONValueNumber<float, JSON_REAL>          CJSONValueFloat;
 typedef CJSONValueNumber<double, JSON_REAL>         CJSONValueDouble;
 
@@ -230,9 +664,31 @@ class CJSONValueString : public CJSONValue
             {
                 bParseSuccess = true;
                 *m_pValue = json_string_value(pVal);
+                JSON_STATS_ADD(strings, 1);
+                JSON_STATS_ADD(stringBytes, m_pValue->size());
+            }
+            else{
+                fprintf(stderr, "ERROR: %s is not an std::string as expected. \n", GetPath().c_str());
+            }
+            return bParseSuccess;
+        }
+
+        bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_STRING)
+            {
+                bParseSuccess = reader.ReadString(*m_pValue);
+                JSON_STATS_ADD(strings, 1);
+                JSON_STATS_ADD(stringBytes, m_pValue->size());
             }
             else{
-                fprintf(stderr, "ERROR: %s is not an std::string as expected. \n", m_name.c_str());
+                fprintf(stderr, "ERROR: %s is not an std::string as expected. \n", GetPath().c_str());
+                reader.SkipValue();
             }
             return bParseSuccess;
         }
@@ -241,11 +697,20 @@ class CJSONValueString : public CJSONValue
         {
             ClearJValue();
             pRet = json_string(m_pValue->c_str());
-            if(!pRet) std::cout << "Error could not dump std::string " << m_name << std::endl;
+            if(!pRet) std::cout << "Error could not dump std::string " << GetPath() << std::endl;
             m_pJValue = pRet;
             return pRet != NULL;
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            bool bWriteSuccess = writer.String(*m_pValue);
+            if(!bWriteSuccess) std::cout << "Error could not dump std::string " << GetPath() << std::endl;
+            return bWriteSuccess;
+        }
+
+        void Reset() { *m_pValue = m_DefaultValue; }
+
         const std::string& GetValue() const { return *m_pValue; }
         const std::string& GetDefaultValue() const { return m_DefaultValue; }
 
@@ -271,7 +736,25 @@ class CJSONValueBool : public CJSONValue
                 *m_pValue = json_is_true(pVal);
             }
             else{
-                fprintf(stderr, "ERROR: %s is not a boolean as expected. \n", m_name.c_str());
+                fprintf(stderr, "ERROR: %s is not a boolean as expected. \n", GetPath().c_str());
+            }
+            return bParseSuccess;
+        }
+
+        bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_TRUE || type == JSON_FALSE)
+            {
+                bParseSuccess = reader.ReadBool(*m_pValue);
+            }
+            else{
+                fprintf(stderr, "ERROR: %s is not a boolean as expected. \n", GetPath().c_str());
+                reader.SkipValue();
             }
             return bParseSuccess;
         }
@@ -284,6 +767,13 @@ class CJSONValueBool : public CJSONValue
             return pRet != NULL;
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            return writer.Bool(*m_pValue);
+        }
+
+        void Reset() { *m_pValue = m_DefaultValue; }
+
         const bool& GetValue() const { return *m_pValue; }
         const bool& GetDefaultValue() const { return m_DefaultValue; }
 
@@ -292,6 +782,25 @@ class CJSONValueBool : public CJSONValue
         bool* m_pValue;
 };
 
+// Vectors of numbers are one CBOR typed array rather than an array of
+// values (see CJSONWriter::NumberArray and CJSONReader::ReadTypedArray).
+template<class JVal>
+struct CJSONPackedArray
+{
+    enum { value = false };
+    static bool CanRead(CJSONReader&) { return false; }
+    template<class TVal> static bool Read(CJSONReader&, std::vector<TVal>&) { return false; }
+    template<class TVal> static bool Write(CJSONWriter&, const std::vector<TVal>&) { return false; }
+};
+
+template<class NVal, json_type _type_>
+struct CJSONPackedArray< CJSONValueNumber<NVal, _type_> >
+{
+    enum { value = CJSONCborTypedArray<NVal>::value };
+    static bool CanRead(CJSONReader& reader) { return reader.template IsTypedArrayOf<NVal>(); }
+    static bool Read(CJSONReader& reader, std::vector<NVal>& values) { return reader.ReadTypedArray(values); }
+    static bool Write(CJSONWriter& writer, const std::vector<NVal>& values) { return writer.NumberArray(values.empty() ? (const NVal*)NULL : &values[0], values.size()); }
+};
 
 /*
 NOTE: the class below will be deprecated and the array class at the bottom will be a more generalized form for all array types.
@@ -328,22 +837,57 @@ class CJSONValueArray : public CJSONValue
                 bParseSuccess = true;
                 size_t n = json_array_size(pVal);
                 json_t* data;
+                m_pValue->reserve(m_pValue->size() + n);
+                JSON_STATS_ADD(nodes, n);
 
                 for (size_t i = 0; i < n; i++)
                 {
-                    TVal temp = m_DefaultArrayValue;
+                    m_pValue->push_back(m_DefaultArrayValue); // parsed in place.
 
-                    char array_number[30]; // should be enough space.
-                    sprintf(&array_number[0], "-%zu", i);
-                    JVal tjson((m_name + std::string(array_number)), &temp);
+                    JVal tjson(std::string(), &m_pValue->back());
+                    tjson.SetParent(this, i);
                     data = json_array_get(pVal, i);
                     bParseSuccess = tjson.Parse(data) && bParseSuccess;
+                }
+            }
+            else{
+                fprintf(stderr, "ERROR: %s is not an array as expected. \n", GetPath().c_str());
+            }
+
+            return bParseSuccess;
+        }
+
+        bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_ARRAY && CJSONPackedArray<JVal>::value && CJSONPackedArray<JVal>::CanRead(reader))
+            {
+                bParseSuccess = CJSONPackedArray<JVal>::Read(reader, *m_pValue);
+                if(!bParseSuccess)
+                    fprintf(stderr, "ERROR: %s is not a valid typed array. \n", GetPath().c_str());
+            }
+            else if(type == JSON_ARRAY)
+            {
+                bParseSuccess = reader.BeginArray();
+                for (size_t i = 0; reader.NextElement(); i++)
+                {
+                    JSON_STATS_ADD(nodes, 1);
+                    m_pValue->push_back(m_DefaultArrayValue); // parsed in place.
 
-                    m_pValue->push_back(temp);
+                    JVal tjson(std::string(), &m_pValue->back());
+                    tjson.SetParent(this, i);
+                    CJSONValue& jval = tjson; // JVal may hide the reader overload.
+                    bParseSuccess = jval.Parse(reader) && bParseSuccess;
                 }
+                bParseSuccess = bParseSuccess && !reader.HasError();
             }
             else{
-                fprintf(stderr, "ERROR: %s is not an array as expected. \n", m_name.c_str());
+                fprintf(stderr, "ERROR: %s is not an array as expected. \n", GetPath().c_str());
+                reader.SkipValue();
             }
 
             return bParseSuccess;
@@ -359,27 +903,52 @@ class CJSONValueArray : public CJSONValue
                 for( size_t i = 0; i < m_pValue->size(); i++)
                 {
                     json_t* pVal = NULL;
-                    TVal temp = m_pValue->at(i);
 
-                    JVal tjson("", &temp);
+                    // Dumped straight from the vector, the element is not
+                    // copied. (A NULL pointer element gets its allocation.)
+                    JVal tjson(std::string(), &(*m_pValue)[i]);
 
                     bDumpSuccess = tjson.Dump(pVal) && bDumpSuccess;
 
                     if(pVal)
                         bDumpSuccess = (json_array_append(pRet, pVal) != -1) && bDumpSuccess;
                     else
-                        std::cout << "Error could not dump array element. "<< m_name << "-"<< i << std::endl;
+                        std::cout << "Error could not dump array element. "<< GetPath() << "-"<< i << std::endl;
                 }
             }
             else
             {
                 bDumpSuccess = false;
-                std::cout << "Error! Could not dump array. "<< m_name << std::endl;
+                std::cout << "Error! Could not dump array. "<< GetPath() << std::endl;
             }
             m_pJValue = pRet;
             return bDumpSuccess;
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            if(CJSONPackedArray<JVal>::value && writer.IsCbor())
+            {
+                bool bPackSuccess = CJSONPackedArray<JVal>::Write(writer, *m_pValue);
+                if(!bPackSuccess)
+                    std::cout << "Error! Could not dump array. "<< GetPath() << std::endl;
+                return bPackSuccess;
+            }
+
+            bool bWriteSuccess = writer.BeginArray();
+            for( size_t i = 0; bWriteSuccess && i < m_pValue->size(); i++)
+            {
+                JVal tjson(std::string(), &(*m_pValue)[i]);
+                tjson.SetParent(this, i);
+                CJSONValue& jval = tjson; // JVal may hide the writer overload.
+                bWriteSuccess = jval.Write(writer);
+            }
+            bWriteSuccess = bWriteSuccess && writer.EndArray();
+            if(!bWriteSuccess)
+                std::cout << "Error! Could not dump array. "<< GetPath() << std::endl;
+            return bWriteSuccess;
+        }
+
 
         const CJSONValueArray& CopyFrom( const CJSONValueArray& src )
         {
@@ -387,6 +956,9 @@ class CJSONValueArray : public CJSONValue
            m_DefaultValue = src.GetDefaultValue();
         }
 
+        // Pointer elements are not deleted, the caller owns them.
+        void Reset() { *m_pValue = m_DefaultValue; }
+
     // Accessor Methods
         const TVal& GetValue() const { return *m_pValue; }
         const std::vector<TVal>& GetDefaultValue() const { return m_DefaultValue; }
@@ -421,22 +993,55 @@ class CJSONValueArray<TVal, CJSONValueObject<TVal> > : public CJSONValue
                 bParseSuccess = true;
                 size_t n = json_array_size(pVal);
                 json_t* data = NULL;
+                m_pValue->reserve(m_pValue->size() + n);
+                JSON_STATS_ADD(nodes, n);
 
                 for (size_t i = 0; i < n; i++)
                 {
-                    TVal temp;
-                    temp.SetupJSONObject();
-
-                    char array_number[30]; // should be enough space.
-                    sprintf(&array_number[0], "-%zu", i);
-                    temp.SetName(m_name + "-" + std::string(array_number));
+                    TVal& temp = AppendElement(i);
                     data = json_array_get(pVal, i);
                     bParseSuccess = temp.Parse(data) && bParseSuccess;
-                    m_pValue->push_back(temp);
+                    temp.SetParent(NULL, 0);
                 }
             }
             else{
-                fprintf(stderr, "ERROR: %s is not an array as expected. \n", m_name.c_str());
+                fprintf(stderr, "ERROR: %s is not an array as expected. \n", GetPath().c_str());
+            }
+            return bParseSuccess;
+        }
+
+        bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_ARRAY)
+            {
+                bParseSuccess = reader.BeginArray();
+            #ifdef c_plus_plus_11
+                if(reader.GetThreadPool())
+                    return ParseParallel(reader, *reader.GetThreadPool()) && bParseSuccess;
+            #endif
+                // Count first so the vector is not grown (copying every
+                // element so far) while parsing; skipping is much cheaper.
+                size_t n = 0;
+                for(CJSONReader lookahead(reader); lookahead.NextElement() && lookahead.SkipValue(); n++) {}
+                m_pValue->reserve(m_pValue->size() + n);
+                JSON_STATS_ADD(nodes, n);
+
+                for (size_t i = 0; reader.NextElement(); i++)
+                {
+                    CJSONValue& jval = AppendElement(i);
+                    bParseSuccess = jval.Parse(reader) && bParseSuccess;
+                    jval.SetParent(NULL, 0);
+                }
+                bParseSuccess = bParseSuccess && !reader.HasError();
+            }
+            else{
+                fprintf(stderr, "ERROR: %s is not an array as expected. \n", GetPath().c_str());
+                reader.SkipValue();
             }
             return bParseSuccess;
         }
@@ -448,27 +1053,53 @@ class CJSONValueArray<TVal, CJSONValueObject<TVal> > : public CJSONValue
             pRet = json_array();
             if(pRet)
             {
+                CJSONValue* pOwner = CJSONDumpScope::GetObject(); // see CJSONValueObject::SetCacheDumps.
                 for( size_t i = 0; i < m_pValue->size(); i++)
                 {
                     json_t* pVal = NULL;
-                    m_pValue->at(i).SetupJSONObject();
-                    bDumpSuccess = m_pValue->at(i).Dump(pVal) && bDumpSuccess;
+                    TVal& elem = (*m_pValue)[i];
+                    elem.SetupJSONObject();
+                    if(pOwner)
+                        elem.SetOwner(pOwner);
+                    bDumpSuccess = elem.Dump(pVal) && bDumpSuccess;
 
                     if(pVal)
                         bDumpSuccess = (json_array_append(pRet, pVal) != -1) && bDumpSuccess;
                     else
-                        std::cout << "Error could not dump array element. "<< m_name << "-"<< i << std::endl;
+                        std::cout << "Error could not dump array element. "<< GetPath() << "-"<< i << std::endl;
                 }
             }
             else
             {
                 bDumpSuccess = false;
-                std::cout << "Error! Could not dump array. "<< m_name << std::endl;
+                std::cout << "Error! Could not dump array. "<< GetPath() << std::endl;
             }
             m_pJValue = pRet;
             return bDumpSuccess;
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            bool bWriteSuccess = writer.BeginArray();
+            CJSONValue* pOwner = CJSONDumpScope::GetObject(); // see CJSONValueObject::SetCacheDumps.
+            CJSONDumpScope::CElements elements;
+            for( size_t i = 0; bWriteSuccess && i < m_pValue->size(); i++)
+            {
+                TVal& elem = (*m_pValue)[i];
+                elem.SetupJSONObject();
+                elem.SetParent(this, i);
+                if(pOwner)
+                    elem.SetOwner(pOwner);
+                CJSONValue& jval = elem;
+                bWriteSuccess = jval.Write(writer);
+                elem.SetParent(NULL, 0);
+            }
+            bWriteSuccess = bWriteSuccess && writer.EndArray();
+            if(!bWriteSuccess)
+                std::cout << "Error! Could not dump array. "<< GetPath() << std::endl;
+            return bWriteSuccess;
+        }
+
 
         const CJSONValueArray& CopyFrom( const CJSONValueArray& src )
         {
@@ -476,18 +1107,100 @@ class CJSONValueArray<TVal, CJSONValueObject<TVal> > : public CJSONValue
            m_DefaultValue = src.GetDefaultValue();
         }
 
+        void Reset() { *m_pValue = m_DefaultValue; }
+
     // Accessor Methods
         const std::vector<TVal>* GetValue() const { return m_pValue; }
         const std::vector<TVal>& GetDefaultValue() const { return m_DefaultValue; }
     private:
-        std::vector<TVal>*  m_pValue;
-        std::vector<TVal>   m_DefaultValue;
-};
+    #ifdef c_plus_plus_11
+        // Finds where every element starts and ends with a skip pass, then
+        // parses chunks of elements on the pool. The array is cut after the
+        // first element with a syntax error, so the result is the same as
+        // the serial loop.
+        bool ParseParallel(CJSONReader& reader, CJSONThreadPool& pool)
+        {
+            std::vector< std::pair<size_t, size_t> > spans;
+            while(reader.NextElement())
+            {
+                size_t begin = reader.GetPosition();
+                if(!reader.SkipValue())
+                    return false;
+                spans.push_back(std::make_pair(begin, reader.GetPosition()));
+            }
+            if(reader.HasError())
+                return false;
 
+            size_t chunkSize = std::max<size_t>(JSON_PARALLEL_CHUNK_MIN, spans.size() / (pool.GetThreadCount() * 8));
+            size_t chunks = (spans.size() + chunkSize - 1) / chunkSize;
+            std::vector<char> success(chunks, 1);
+            std::vector<size_t> failed(chunks, spans.size()); // first element with a syntax error.
+            std::vector<json_error_t> errors(chunks);
+
+            // The elements are made up front and each thread parses into
+            // its own range of them; nothing is copied afterwards.
+            size_t start = m_pValue->size();
+            m_pValue->resize(start + spans.size());
+
+            pool.ParallelFor(chunks, [&](size_t chunk) {
+                JSON_TRACE_SPAN("array", GetName());
+                size_t first = chunk * chunkSize;
+                size_t last = std::min(spans.size(), first + chunkSize);
+                for(size_t i = first; i < last; i++)
+                {
+                    TVal& temp = (*m_pValue)[start + i];
+                    temp.SetupJSONObject();
+                    temp.SetParent(this, i);
 
-/*
-End Note
-*/
+                    CJSONReader element(reader, spans[i].first, spans[i].second);
+                    CJSONValue& jval = temp;
+                    success[chunk] = jval.Parse(element) && success[chunk];
+                    temp.SetParent(NULL, 0);
+                    if(element.HasError())
+                    {
+                        failed[chunk] = i;
+                        errors[chunk] = element.GetError();
+                        break;
+                    }
+                }
+            });
+
+            bool bParseSuccess = true;
+            for(size_t chunk = 0; chunk < chunks; chunk++)
+            {
+                bParseSuccess = success[chunk] && bParseSuccess;
+                if(failed[chunk] != spans.size())
+                {
+                    m_pValue->resize(start + failed[chunk] + 1); // the serial parse stops there too.
+                    reader.SetError(errors[chunk]);
+                    break;
+                }
+            }
+            return bParseSuccess && !reader.HasError();
+        }
+    #endif
+
+        // Adds a default element at the end and sets it up to be parsed in
+        // place, rather than parsing a temporary and copying it in. The
+        // caller clears the parent once the element is parsed.
+        TVal& AppendElement(size_t index)
+        {
+            m_pValue->resize(m_pValue->size() + 1);
+            TVal& elem = m_pValue->back();
+            elem.SetupJSONObject();
+            elem.SetParent(this, index);
+            return elem;
+        }
+
+    private:
+        std::vector<TVal>*  m_pValue;
+        std::vector<TVal>   m_DefaultValue;
+};
+
+
+/*
+End Note
+*/
 
 
 // This requires c++11.
@@ -513,7 +1226,32 @@ class CJSONValueTuple : public CJSONValue
                 bParseSuccess = ParseTupleElements(pVal);
             }
             else{
-                fprintf(stderr, "ERROR: %s is not an array as expected. \n", m_name.c_str());
+                fprintf(stderr, "ERROR: %s is not an array as expected. \n", GetPath().c_str());
+            }
+
+            return bParseSuccess;
+        }
+
+        bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_ARRAY)
+            {
+                bool bMore = reader.BeginArray();
+                bParseSuccess = bMore && ParseTupleElements(reader, bMore);
+                while(bMore && reader.NextElement()) // extra elements are ignored.
+                {
+                    reader.SkipValue();
+                }
+                bParseSuccess = bParseSuccess && !reader.HasError();
+            }
+            else{
+                fprintf(stderr, "ERROR: %s is not an array as expected. \n", GetPath().c_str());
+                reader.SkipValue();
             }
 
             return bParseSuccess;
@@ -531,12 +1269,19 @@ class CJSONValueTuple : public CJSONValue
             else
             {
                 bDumpSuccess = false;
-                std::cout << "Error! Could not dump array. "<< m_name << std::endl;
+                std::cout << "Error! Could not dump array. "<< GetPath() << std::endl;
             }
             m_pJValue = pRet;
             return bDumpSuccess;
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            return writer.BeginArray() && WriteTupleElements(writer) && writer.EndArray();
+        }
+
+
+        void Reset() { *m_pValue = m_DefaultValue; }
 
         const CVal& GetDefaultValue() { return m_DefaultValue; }
 
@@ -552,18 +1297,39 @@ class CJSONValueTuple : public CJSONValue
 
             json_t* data;
 
-            char array_number[30]; // should be enough space.
-            sprintf(&array_number[0], "-%zu", I);
-            std::string elemName(m_name + std::string(array_number));
-
             data = json_array_get(pVal, I);
             typename std::tuple_element<I, CVal>::type* pElem = &std::get<I>(*m_pValue);
-            std::unique_ptr<CJSONValue> pJson = CreateJSONValue<typename std::tuple_element<I, CVal>::type, TVals...>(I, elemName, pElem);
+            std::unique_ptr<CJSONValue> pJson = CreateJSONValue<typename std::tuple_element<I, CVal>::type, TVals...>(I, std::string(), pElem);
+            pJson->SetParent(this, I);
             bParseSuccess = pJson->Parse(data);
 
             return ParseTupleElements<I+1>(pVal) && bParseSuccess;
         }
 
+        template<size_t I = 0>
+        typename  std::enable_if<I == sizeof...(TVals), bool >::type ParseTupleElements(CJSONReader&, bool&) { return true; }
+
+        template<size_t I = 0>
+        typename  std::enable_if< I < sizeof...(TVals), bool >::type ParseTupleElements(CJSONReader& reader, bool& bMore)
+        {
+            bool bParseSuccess = false;
+
+            bMore = bMore && reader.NextElement();
+            if(bMore)
+            {
+                typename std::tuple_element<I, CVal>::type* pElem = &std::get<I>(*m_pValue);
+                std::unique_ptr<CJSONValue> pJson = CreateJSONValue<typename std::tuple_element<I, CVal>::type, TVals...>(I, std::string(), pElem);
+                pJson->SetParent(this, I);
+                bParseSuccess = pJson->Parse(reader);
+            }
+            else if(!reader.HasError())
+            {
+                fprintf(stderr, "ERROR: %s-%zu is missing from the array. \n", GetPath().c_str(), I);
+            }
+
+            return ParseTupleElements<I+1>(reader, bMore) && bParseSuccess;
+        }
+
         template<size_t I = 0>
         typename  std::enable_if<I == sizeof...(TVals), bool >::type DumpTupleElements(json_t*&) { return true; } // All values have been dumped...
 
@@ -571,24 +1337,40 @@ class CJSONValueTuple : public CJSONValue
         typename  std::enable_if< I < sizeof...(TVals), bool >::type DumpTupleElements(json_t*& pRet)
         {
             bool bDumpSuccess = true;
-            char array_number[30]; // should be enough space.
-            sprintf(&array_number[0], "-%zu", I);
-            std::string elemName(m_name + std::string(array_number));
 
             json_t* pVal = NULL;
             auto pElem = &std::get<I>(*m_pValue);
 
-            std::unique_ptr<CJSONValue> pJson = CreateJSONValue<typename std::tuple_element<I, CVal>::type, TVals...>(I, elemName, pElem);
+            std::unique_ptr<CJSONValue> pJson = CreateJSONValue<typename std::tuple_element<I, CVal>::type, TVals...>(I, std::string(), pElem);
             pJson->Dump(pVal);
 
             if(pVal)
                 bDumpSuccess = (json_array_append(pRet, pVal) != -1) && bDumpSuccess;
             else
-                std::cout << "Error could not dump array element. " << m_name << "[" << I << "]" << std::endl;
+                std::cout << "Error could not dump array element. " << GetPath() << "[" << I << "]" << std::endl;
 
             return DumpTupleElements<I+1>(pRet) && bDumpSuccess;
         }
 
+        template<size_t I = 0>
+        typename  std::enable_if<I == sizeof...(TVals), bool >::type WriteTupleElements(CJSONWriter&) { return true; }
+
+        template<size_t I = 0>
+        typename  std::enable_if< I < sizeof...(TVals), bool >::type WriteTupleElements(CJSONWriter& writer)
+        {
+            auto pElem = &std::get<I>(*m_pValue);
+
+            std::unique_ptr<CJSONValue> pJson = CreateJSONValue<typename std::tuple_element<I, CVal>::type, TVals...>(I, std::string(), pElem);
+            pJson->SetParent(this, I);
+            if(!pJson->Write(writer))
+            {
+                std::cout << "Error could not dump array element. " << GetPath() << "[" << I << "]" << std::endl;
+                return false;
+            }
+
+            return WriteTupleElements<I+1>(writer);
+        }
+
         template<class Type1, class Type2, class JType>
         typename  std::enable_if< !std::is_same<Type1, Type2>::value, std::unique_ptr<CJSONValue> >::type create(const std::string&, Type1*)
         {
@@ -626,13 +1408,136 @@ class CJSONValueTuple : public CJSONValue
 
 #endif // end c++11 specialization
 
+
+//                  CJSONFieldCodec
+//********************************************************************//
+// Parses, dumps and resets one member for the shared field table of
+// CJSONValueObject by making the JVal on the stack for the call. Only
+// binding classes that do nothing but read and write the member are
+// marked in CJSONFieldIsShared; anything else (e.g. the pointer classes
+// which allocate) keeps the per instance map.
+//********************************************************************//
+
+template<class JVal>
+struct CJSONFieldIsShared { enum { value = false }; };
+
+template<class NVal, json_type _type_>
+struct CJSONFieldIsShared< CJSONValueNumber<NVal, _type_> > { enum { value = true }; };
+
+template<>
+struct CJSONFieldIsShared<CJSONValueString> { enum { value = true }; };
+
+template<>
+struct CJSONFieldIsShared<CJSONValueBool> { enum { value = true }; };
+
+template<class TVal, class JVal>
+struct CJSONFieldIsShared< CJSONValueArray<TVal, JVal> > { enum { value = true }; };
+
+#ifdef c_plus_plus_11
+template<typename CVal, typename... TVals>
+struct CJSONFieldIsShared< CJSONValueTuple<CVal, TVals...> > { enum { value = true }; };
+#endif
+
+// Whether the instances of DerivedClass share their field bindings, see
+// JSON_OBJECT_SHARED_FIELDS. To opt one type out:
+//
+//     namespace json { template<> struct CJSONSharedFields<Config> { enum { value = false }; }; }
+template<class DerivedClass>
+struct CJSONSharedFields { enum { value = JSON_OBJECT_SHARED_FIELDS }; };
+
+template<class TVal, class JVal>
+struct CJSONFieldCodec
+{
+    // The bindings are made for every value, so they refer to the table's
+    // name: a copy would allocate each time for a long one.
+    static bool Parse(const std::string& name, void* p, const json_t* pVal)
+    {
+        JVal jval(std::string(), (TVal*)p);
+        jval.SetNameRef(&name);
+        return jval.Parse(pVal);
+    }
+
+    static bool Read(const std::string& name, void* p, CJSONReader& reader)
+    {
+        JVal jval(std::string(), (TVal*)p);
+        jval.SetNameRef(&name);
+        CJSONValue& value = jval; // JVal may hide the reader overload.
+        return value.Parse(reader);
+    }
+
+    // pRet is returned with a reference of its own, jval drops its one.
+    static bool Dump(const std::string& name, void* p, json_t*& pRet)
+    {
+        JVal jval(std::string(), (TVal*)p);
+        jval.SetNameRef(&name);
+        bool bDumpSuccess = jval.Dump(pRet);
+        json_incref(pRet);
+        return bDumpSuccess;
+    }
+
+    static bool Write(const std::string& name, void* p, CJSONWriter& writer)
+    {
+        JVal jval(std::string(), (TVal*)p);
+        jval.SetNameRef(&name);
+        CJSONValue& value = jval; // JVal may hide the writer overload.
+        return value.Write(writer);
+    }
+
+    static void Reset(const std::string& name, void* p)
+    {
+        JVal jval(std::string(), (TVal*)p);
+        jval.SetNameRef(&name);
+        jval.Reset();
+    }
+};
+
+// Objects bound with AddObjectValue are members themselves, so p is the
+// object and it is used directly.
+struct CJSONObjectFieldCodec
+{
+    static bool Parse(const std::string&, void* p, const json_t* pVal)
+    {
+        return ((CJSONValue*)p)->Parse(pVal);
+    }
+
+    static bool Read(const std::string&, void* p, CJSONReader& reader)
+    {
+        return ((CJSONValue*)p)->Parse(reader);
+    }
+
+    static bool Dump(const std::string&, void* p, json_t*& pRet)
+    {
+        bool bDumpSuccess = ((CJSONValue*)p)->Dump(pRet);
+        json_incref(pRet); // the object keeps its own buffered reference.
+        return bDumpSuccess;
+    }
+
+    static bool Write(const std::string&, void* p, CJSONWriter& writer)
+    {
+        return ((CJSONValue*)p)->Write(writer);
+    }
+
+    static void Reset(const std::string&, void* p)
+    {
+        ((CJSONValue*)p)->Reset();
+    }
+
+    static void Clear(void* p)
+    {
+        ((CJSONValue*)p)->ClearBuffer();
+    }
+};
+
 template <class DerivedClass>
 class CJSONValueObject : public CJSONValue
 {
     public:
         typedef DerivedClass type;
 
-        CJSONValueObject(const std::string& name, DerivedClass* pval) : CJSONValue(JSON_OBJECT, name), m_pDerived(pval), m_bUpdate(JSON_OBJECT_TRACK_MISSING_VALUES_DEFAULT) {  }
+        CJSONValueObject(const std::string& name, DerivedClass* pval) : CJSONValue(JSON_OBJECT, name), m_pDerived(pval), m_bUpdate(JSON_OBJECT_TRACK_MISSING_VALUES_DEFAULT), m_bSharedFields(false), m_bLazy(false), m_bCacheDumps(JSON_OBJECT_DUMP_CACHE_DEFAULT), m_bDumpCached(false), m_Modifications(0)
+        {
+            m_LazySource.pToken = NULL;
+        }
 
     /* Want to delete any way of copying this object -- is there any other way? */
     #ifdef c_plus_plus_11
@@ -645,7 +1550,11 @@ class CJSONValueObject : public CJSONValue
     public:
     #endif
     /****************************************************************************/
-        ~CJSONValueObject() { Destroy(); }
+        ~CJSONValueObject()
+        {
+            Destroy();
+            CJSONTextToken::Release(m_LazySource.pToken);
+        }
 
         void Destroy()
         {
@@ -669,13 +1578,51 @@ class CJSONValueObject : public CJSONValue
             m_MissingValues.clear();
         }
 
-        void ClearBuffer()
+        void Reset()
         {
-            ClearJValue();
+            SetModified();
+            if(m_bSharedFields)
+            {
+                const std::vector<CJSONFieldTable::CField>& fields = GetFieldTable().GetFields();
+                for(size_t i = 0; i < fields.size(); i++)
+                {
+                    fields[i].reset(fields[i].name, GetMember(fields[i]));
+                }
+            }
+            else
+            {
+                FinishFieldTable();
+                for(std::map<std::string, CJSONValue* >::iterator iter = m_Map.begin(); iter != m_Map.end(); iter++)
+                {
+                    iter->second->Reset();
+                }
+            }
+            for(std::map<std::string, json_t* >::iterator iter = m_MissingValues.begin(); iter != m_MissingValues.end(); iter++)
+            {
+                json_decref(iter->second);
+            }
+            m_MissingValues.clear();
+            m_LazyValues.clear();
+        }
+
+        virtual void ClearBuffer()
+        {
+            if(!m_bDumpCached)
+                ClearJValue();
+            if(m_bSharedFields)
+            {
+                const std::vector<CJSONFieldTable::CField>& fields = GetFieldTable().GetFields();
+                for(size_t i = 0; i < fields.size(); i++)
+                {
+                    if(fields[i].clear)
+                        fields[i].clear(GetMember(fields[i]));
+                }
+                return;
+            }
             std::map<std::string, CJSONValue* >::iterator iter;
             for(iter = m_Map.begin(); iter != m_Map.end(); iter++)
             {
-                iter->second->ClearJValue();
+                iter->second->ClearBuffer();
             }
         }
 
@@ -683,6 +1630,8 @@ class CJSONValueObject : public CJSONValue
         virtual bool Parse (const json_t* pVal)
         {
             bool bParseSuccess = false;
+            SetModified();
+            m_LazyValues.clear(); // the tree is there, nothing to gain.
             if(json_is_object(pVal))
             {
 //                bParseSuccess = true;
@@ -699,57 +1648,369 @@ class CJSONValueObject : public CJSONValue
 //                }
 
                 bParseSuccess = true;
+                FinishFieldTable();
+                JSON_STATS_ADD(objects, 1);
                 const char * key;
                 json_t* val;
                 json_object_foreach((json_t*)pVal, key, val)
                 {
+                    const CJSONFieldTable::CField* pField = m_bSharedFields ? GetFieldTable().Find(key, strlen(key)) : NULL;
+                    if(pField)
+                    {
+                        JSON_STATS_MEMBER(pField->name);
+                        JSON_TRACE_SPAN("parse", pField->name);
+                        bParseSuccess = pField->parse(pField->name, GetMember(*pField), val) && bParseSuccess;
+                        continue;
+                    }
+
                     string name(key);
                     std::map<std::string, CJSONValue* >::iterator elem;
-                    elem = m_Map.find(name);
+                    elem = m_bSharedFields ? m_Map.end() : m_Map.find(name);
                     if(elem != m_Map.end())
                     {
+                        JSON_STATS_MEMBER(name);
+                        JSON_TRACE_SPAN("parse", name);
                         bParseSuccess = elem->second->Parse(val) && bParseSuccess;
                     }
                     else if(m_bUpdate)
                     {
-                        json_incref(val); // keep the data around.
-                        m_MissingValues.insert(pair<string, json_t*>(name, val));
+                        // keep the data around, out of the parser's arena.
+                        JSON_STATS_ADD(unknownKeys, 1);
+                        m_MissingValues.insert(pair<string, json_t*>(name, CJSONArena::Keep(val)));
+                    }
+                    else
+                    {
+                        JSON_STATS_ADD(skippedKeys, 1);
+                    }
+                }
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: %s is not an object as expected. \n", GetPath().c_str());
+            }
+
+            return bParseSuccess;
+        }
+
+        virtual bool Parse (CJSONReader& reader)
+        {
+            bool bParseSuccess = false;
+            json_type type;
+            SetModified();
+            if(!reader.Peek(type))
+                return false;
+
+            if(type == JSON_OBJECT && m_bLazy)
+            {
+                bParseSuccess = ParseLazy(reader);
+            }
+            else if(type == JSON_OBJECT)
+            {
+                bParseSuccess = reader.BeginObject();
+                FinishFieldTable();
+                JSON_STATS_ADD(objects, 1);
+                std::string& name = reader.GetKeyBuffer(); // nested objects reuse it, see GetKeyBuffer.
+                while(reader.NextKey(name))
+                {
+                    const CJSONFieldTable::CField* pField = m_bSharedFields ? GetFieldTable().Find(name.data(), name.size()) : NULL;
+                    std::map<std::string, CJSONValue* >::iterator elem;
+                    elem = m_bSharedFields ? m_Map.end() : m_Map.find(name);
+                    if(pField)
+                    {
+                        JSON_STATS_MEMBER(pField->name);
+                        JSON_TRACE_SPAN("parse", pField->name);
+                        bParseSuccess = pField->read(pField->name, GetMember(*pField), reader) && bParseSuccess;
+                    }
+                    else if(elem != m_Map.end())
+                    {
+                        JSON_STATS_MEMBER(elem->first);
+                        JSON_TRACE_SPAN("parse", elem->first);
+                        bParseSuccess = elem->second->Parse(reader) && bParseSuccess;
+                    }
+                    else if(m_bUpdate)
+                    {
+                        JSON_STATS_ADD(unknownKeys, 1);
+                        json_t* val = reader.ReadValue(); // keep the data around.
+                        if(val)
+                            KeepMissingValue(name, val);
+                    }
+                    else
+                    {
+                        JSON_STATS_ADD(skippedKeys, 1);
+                        reader.SkipValue();
                     }
                 }
+                bParseSuccess = bParseSuccess && !reader.HasError();
             }
             else
             {
-                fprintf(stderr, "ERROR: %s is not an object as expected. \n", m_name.c_str());
+                fprintf(stderr, "ERROR: %s is not an object as expected. \n", GetPath().c_str());
+                reader.SkipValue();
             }
 
             return bParseSuccess;
         }
 
         virtual bool Dump (json_t*& pRet)
+        {
+            if(!m_bCacheDumps)
+                return DumpObject(pRet);
+
+            CheckDumps();
+            if(m_bDumpCached)
+            {
+                pRet = m_pJValue;
+                return true;
+            }
+            CJSONDumpScope scope(this);
+            bool bDumpSuccess = DumpObject(pRet);
+            m_bDumpCached = bDumpSuccess && scope.CanKeep();
+            return bDumpSuccess;
+        }
+
+        // The members are written in the order Dump adds them to the
+        // jansson object, which is how json_dumps would print it: the bound
+        // fields by name and then the missing values, or all of them by
+        // name with JSON_SORT_KEYS.
+        virtual bool Write (CJSONWriter& writer)
+        {
+            if(!m_bCacheDumps)
+                return WriteObject(writer);
+            if(CJSONDumpCheck::IsChecking())
+            {
+                CJSONDumpScope scope(this);
+                return WriteObject(writer);
+            }
+
+            CheckDumps();
+            CWriteCache& cache = m_WriteCache;
+            if(cache.bDirect)
+            {
+                CJSONDumpScope scope(this);
+                bool bWriteSuccess = WriteObject(writer);
+                cache.bDirect = !scope.CanKeep();
+                return bWriteSuccess;
+            }
+
+            size_t depth = writer.GetDepth();
+            if(!cache.Matches(writer, depth) && !KeepWrite(writer.GetFlags(), writer.GetFormat(), depth))
+                return false;
+            if(cache.bValid && CJSONDumpScope::CanSplice(writer))
+            {
+                CJSONDumpSplice splice = { 0, depth, this, &WriteKept };
+                if(!writer.Raw("", 0))
+                    return false;
+                splice.offset = writer.GetBuffer().size();
+                CJSONDumpScope::AddSplice(splice);
+                return true;
+            }
+            bool bWriteSuccess = writer.Raw("", 0) && AppendKept(writer);
+            if(cache.bDirect)
+            {
+                std::string().swap(cache.text);
+                cache.splices.clear();
+            }
+            return bWriteSuccess;
+        }
+
+        // Dump caching, for objects that are dumped again and again while
+        // little of them changes. With it on, Dump and Write hand out what
+        // the last one made until the object is told of a change with
+        // SetModified, SetMember or ModifyMember; Parse and Reset tell it
+        // too. The bound members are plain members that can not be
+        // watched, so a change made without telling is not seen and the
+        // old dump goes out (CJSONDumpCheck finds those while debugging).
+        //
+        // A change is passed on to the objects this one is bound in with
+        // AddObjectValue, and to the one that last dumped the array this
+        // one is an element of. An element moved or swapped into another
+        // vector keeps telling the object it was dumped in, until the one
+        // it is in now dumps it. Nothing behind a pointer tells the objects
+        // it is reached from, so what is written through a pointer is not
+        // kept and the objects around it are written again each time.
+        //
+        // A kept Write does not hold a copy of the bound objects that keep
+        // theirs, it splices their text in when it is written out. The
+        // elements of arrays are copied in. Setting it sets it for the
+        // bound objects as well but not for the elements of a bound array
+        // or the objects behind a pointer.
+        void SetCacheDumps(bool bCache)
+        {
+            m_bCacheDumps = bCache;
+            DropDumps();
+            if(!bCache)
+            {
+                std::string().swap(m_WriteCache.text);
+                std::vector<CJSONDumpSplice>().swap(m_WriteCache.splices);
+                std::string().swap(m_Snapshot);
+            }
+            FinishFieldTable();
+            if(m_bSharedFields)
+            {
+                const std::vector<CJSONFieldTable::CField>& fields = GetFieldTable().GetFields();
+                for(size_t i = 0; i < fields.size(); i++)
+                {
+                    if(fields[i].clear) // only bound objects have one.
+                        ((CJSONValue*)GetMember(fields[i]))->SetCacheDumps(bCache);
+                }
+                return;
+            }
+            for(std::map<std::string, CJSONValue* >::iterator iter = m_Map.begin(); iter != m_Map.end(); iter++)
+            {
+                if(iter->second->IsObject())
+                    iter->second->SetCacheDumps(bCache);
+            }
+        }
+        bool CachesDumps() const { return m_bCacheDumps; }
+
+        // The object changed: counts it, drops the dumps and tells the
+        // objects this one is bound in. Parse and Reset call it.
+        void SetModified()
+        {
+            m_Modifications++;
+            DropDumps();
+            CJSONValue::SetModified();
+        }
+
+        // How many times SetModified was called on the object or the ones
+        // bound in it. Equal counts mean nothing was changed in between,
+        // as far as the object was told.
+        size_t GetModifications() const { return m_Modifications; }
+
+        // For the members of the derived class: sets one and calls
+        // SetModified.
+        template<class TVal, class TArg>
+        void SetMember(TVal& member, const TArg& value)
+        {
+            member = value;
+            SetModified();
+        }
+
+        // Calls SetModified and hands out the member to be changed in
+        // place, e.g. ModifyMember(m_Items).push_back(item).
+        template<class TVal>
+        TVal& ModifyMember(TVal& member)
+        {
+            SetModified();
+            return member;
+        }
+
+    private:
+        void DropDumps()
+        {
+            if(m_bDumpCached)
+                ClearJValue();
+            m_bDumpCached = false;
+            m_WriteCache.bValid = false;
+            m_WriteCache.bDirect = false;
+        }
+
+        // See CJSONDumpCheck.
+        void CheckDumps()
+        {
+            if(!CJSONDumpCheck::IsEnabled())
+                return;
+
+            CJSONWriter snapshot(JSON_ENCODE_ANY, NULL, JSON_FORMAT_CBOR);
+            bool bWriteSuccess;
+            {
+                CJSONDumpCheck::CScope checking;
+                CJSONDumpScope scope(this);
+                bWriteSuccess = WriteObject(snapshot);
+            }
+            if(!bWriteSuccess || snapshot.GetBuffer() != m_Snapshot)
+            {
+                if(!m_Snapshot.empty() && (m_bDumpCached || m_WriteCache.bValid))
+                    fprintf(stderr, "warning: %s changed without SetModified \n", GetPath().c_str());
+                DropDumps();
+                m_Snapshot.swap(snapshot.GetBuffer());
+            }
+        }
+
+        // Writes the object into the kept text. The bound objects that keep
+        // theirs are spliced in, see AppendKept.
+        bool KeepWrite(size_t flags, CJSONFormat format, size_t depth)
+        {
+            CWriteCache& cache = m_WriteCache;
+            cache.bValid = false;
+            cache.splices.clear();
+            CJSONWriter text(flags, NULL, format);
+            text.SetDepth(depth);
+            text.GetBuffer().swap(cache.text);
+            text.GetBuffer().clear();
+
+            CJSONDumpScope scope(this, &text, &cache.splices);
+            bool bWriteSuccess = WriteObject(text);
+            cache.text.swap(text.GetBuffer());
+            if(!bWriteSuccess)
+                return false;
+            cache.flags = flags;
+            cache.format = format;
+            cache.depth = depth;
+            cache.bValid = scope.CanKeep();
+            cache.bDirect = !cache.bValid;
+            return true;
+        }
+
+        // Appends the kept text after Raw has begun the value.
+        bool AppendKept(CJSONWriter& writer)
+        {
+            const CWriteCache& cache = m_WriteCache;
+            size_t offset = 0;
+            for(size_t i = 0; i < cache.splices.size(); i++)
+            {
+                const CJSONDumpSplice& splice = cache.splices[i];
+                if(!writer.Append(cache.text.data() + offset, splice.offset - offset) || !splice.write(splice.pObject, writer, splice.depth))
+                    return false;
+                offset = splice.offset;
+            }
+            return writer.Append(cache.text.data() + offset, cache.text.size() - offset);
+        }
+
+        // Writes a spliced object. It was written at another depth (on its
+        // own, say) if its text does not match.
+        static bool WriteKept(CJSONValue* pValue, CJSONWriter& writer, size_t depth)
+        {
+            CJSONValueObject<DerivedClass>* pObject = static_cast<CJSONValueObject<DerivedClass>*>(pValue);
+            if(!pObject->m_WriteCache.Matches(writer, depth) && !pObject->KeepWrite(writer.GetFlags(), writer.GetFormat(), depth))
+                return false;
+            return pObject->AppendKept(writer);
+        }
+
+        bool DumpObject (json_t*& pRet)
         {
             ClearJValue();
-            bool bDumpSuccess = true;
+            bool bDumpSuccess = Materialize();
 
             pRet = json_object();
+            FinishFieldTable();
 
             if(pRet)
             {
-                for(std::map<std::string, CJSONValue* >::iterator iter = m_Map.begin(); iter != m_Map.end(); iter++)
+                if(m_bSharedFields)
                 {
-                    json_t* value = NULL;
-                    if ( iter->second->Dump(value) )
+                    bDumpSuccess = DumpSharedFields(pRet) && bDumpSuccess;
+                }
+                else
+                {
+                    for(std::map<std::string, CJSONValue* >::iterator iter = m_Map.begin(); iter != m_Map.end(); iter++)
                     {
-                        if ( json_object_set(pRet, iter->first.c_str(), value) == -1)
+                        JSON_TRACE_SPAN("dump", iter->first);
+                        json_t* value = NULL;
+                        if ( iter->second->Dump(value) )
+                        {
+                            if ( json_object_set(pRet, iter->first.c_str(), value) == -1)
+                            {
+                                bDumpSuccess = false;
+                                std::cout << "Error! Could not add " << iter->first << " to object of size "<< json_object_size(pRet) << std::endl;
+                            }
+                        }
+                        else
                         {
                             bDumpSuccess = false;
-                            std::cout << "Error! Could not add " << iter->first << " to object of size "<< json_object_size(pRet) << std::endl;
+                            std::cout << "Error! Could not dump " << iter->first << std::endl;
                         }
                     }
-                    else
-                    {
-                        bDumpSuccess = false;
-                        std::cout << "Error! Could not dump " << iter->first << std::endl;
-                    }
                 }
 
                 if(bDumpSuccess && m_bUpdate) // add the missing data
@@ -764,26 +2025,119 @@ class CJSONValueObject : public CJSONValue
                     }
                 }
             }
-            else
+            else
+            {
+                std::cout << "Error! could not create object!" << std::endl;
+                bDumpSuccess = false;
+            }
+            m_pJValue = pRet;
+            return bDumpSuccess;
+        }
+
+        bool WriteObject (CJSONWriter& writer)
+        {
+            FinishFieldTable();
+            bool bWriteSuccess = Materialize() && writer.BeginObject();
+
+            std::map<std::string, json_t* >::iterator missing = m_MissingValues.begin();
+            std::map<std::string, json_t* >::iterator missingEnd = m_bUpdate ? m_MissingValues.end() : m_MissingValues.begin();
+            if(m_bSharedFields)
+            {
+                const std::vector<CJSONFieldTable::CField>& fields = GetFieldTable().GetFields();
+                for(size_t i = 0; bWriteSuccess && i < fields.size(); i++)
+                {
+                    JSON_TRACE_SPAN("dump", fields[i].name);
+                    bWriteSuccess = WriteMissingValues(writer, missing, missingEnd, &fields[i].name) && writer.Key(fields[i].name);
+                    if(bWriteSuccess && !fields[i].write(fields[i].name, GetMember(fields[i]), writer))
+                    {
+                        bWriteSuccess = false;
+                        std::cout << "Error! Could not dump " << fields[i].name << std::endl;
+                    }
+                }
+            }
+            else
+            {
+                for(std::map<std::string, CJSONValue* >::iterator iter = m_Map.begin(); bWriteSuccess && iter != m_Map.end(); iter++)
+                {
+                    JSON_TRACE_SPAN("dump", iter->first);
+                    bWriteSuccess = WriteMissingValues(writer, missing, missingEnd, &iter->first) && writer.Key(iter->first);
+                    if(bWriteSuccess && !iter->second->Write(writer))
+                    {
+                        bWriteSuccess = false;
+                        std::cout << "Error! Could not dump " << iter->first << std::endl;
+                    }
+                }
+            }
+            bWriteSuccess = bWriteSuccess && WriteMissingValues(writer, missing, missingEnd, NULL);
+
+            return bWriteSuccess && writer.EndObject();
+        }
+
+    public:
+
+    // Abstract methods
+        virtual void SetupJSONObject() = 0;
+
+        virtual bool LoadFromFile( const std::string& Path ); // not abstract. implementation below.
+
+        virtual bool SaveToFile( const std::string& Path );   // not abstract. implementation below.
+
+        virtual bool UpdateFile( const std::string& Path );   // only writes what changed, see CJSONParser::UpdateObjectToFile.
+
+        // The members as Write puts them in the object when it is the root
+        // of a document written with flags, each on its own: the bound
+        // fields and the missing values. Fields a lazy parse has not
+        // materialized are left out, they have not changed.
+        bool WriteMembers(size_t flags, std::vector<CJSONMemberText>& members)
+        {
+            FinishFieldTable();
+            bool bWriteSuccess = true;
+            if(m_bSharedFields)
+            {
+                const std::vector<CJSONFieldTable::CField>& fields = GetFieldTable().GetFields();
+                for(size_t i = 0; i < fields.size(); i++)
+                {
+                    if(IsLazyPending(fields[i].name))
+                        continue;
+                    CJSONWriter writer(flags);
+                    BeginMember(writer, fields[i].name);
+                    size_t valueBegin = writer.GetBuffer().size();
+                    bWriteSuccess = fields[i].write(fields[i].name, GetMember(fields[i]), writer) && bWriteSuccess;
+                    EndMember(writer, fields[i].name, valueBegin, members);
+                }
+            }
+            else
+            {
+                for(std::map<std::string, CJSONValue* >::iterator iter = m_Map.begin(); iter != m_Map.end(); iter++)
+                {
+                    if(IsLazyPending(iter->first))
+                        continue;
+                    CJSONWriter writer(flags);
+                    BeginMember(writer, iter->first);
+                    size_t valueBegin = writer.GetBuffer().size();
+                    bWriteSuccess = iter->second->Write(writer) && bWriteSuccess;
+                    EndMember(writer, iter->first, valueBegin, members);
+                }
+            }
+            for(std::map<std::string, json_t* >::iterator iter = m_MissingValues.begin(); m_bUpdate && iter != m_MissingValues.end(); iter++)
             {
-                std::cout << "Error! could not create object!" << std::endl;
-                bDumpSuccess = false;
+                CJSONWriter writer(flags);
+                BeginMember(writer, iter->first);
+                size_t valueBegin = writer.GetBuffer().size();
+                bWriteSuccess = writer.WriteValue(iter->second) && bWriteSuccess;
+                EndMember(writer, iter->first, valueBegin, members);
             }
-            m_pJValue = pRet;
-            return bDumpSuccess;
+            return bWriteSuccess;
         }
 
-    // Abstract methods
-        virtual void SetupJSONObject() = 0;
-
-        virtual bool LoadFromFile( const std::string& Path ); // not abstract. implementation below.
-
-        virtual bool SaveToFile( const std::string& Path );   // not abstract. implementation below.
-
     // Class methods
         template<class TVal, class JVal>
         void AddNameValuePair(const std::string& name, TVal* pval)
         {
+            if(UseSharedFields(name))
+                return;
+            AddSharedField(name, pval, sizeof(TVal), CJSONFieldIsShared<JVal>::value, &CJSONFieldCodec<TVal, JVal>::Parse, &CJSONFieldCodec<TVal, JVal>::Read, &CJSONFieldCodec<TVal, JVal>::Dump, &CJSONFieldCodec<TVal, JVal>::Write, &CJSONFieldCodec<TVal, JVal>::Reset, NULL);
+
             std::map < std::string, CJSONValue* >::iterator iter = m_Map.find(name);
             if(iter == m_Map.end())
             {
@@ -804,6 +2158,22 @@ class CJSONValueObject : public CJSONValue
         {
             AddNameValuePair<size_t, CJSONValueUInt>(name, pval);
         }
+        void AddInt64Value(const std::string& name, int64_t* pval)
+        {
+            AddNameValuePair<int64_t, CJSONValueInt64>(name, pval);
+        }
+        void AddUInt64Value(const std::string& name, uint64_t* pval)
+        {
+            AddNameValuePair<uint64_t, CJSONValueUInt64>(name, pval);
+        }
+        void AddInt16Value(const std::string& name, int16_t* pval)
+        {
+            AddNameValuePair<int16_t, CJSONValueInt16>(name, pval);
+        }
+        void AddUInt8Value(const std::string& name, uint8_t* pval)
+        {
+            AddNameValuePair<uint8_t, CJSONValueUInt8>(name, pval);
+        }
         void AddBoolValue(const std::string& name, bool* pval)
         {
             AddNameValuePair<bool, CJSONValueBool>(name, pval);
@@ -824,6 +2194,11 @@ class CJSONValueObject : public CJSONValue
         template<class TVal>
         void AddObjectValue(const std::string& name, CJSONValueObject<TVal>* pval)
         {
+            pval->SetOwner(this);
+            if(UseSharedFields(name))
+                return;
+            AddSharedField(name, static_cast<CJSONValue*>(pval), sizeof(CJSONValueObject<TVal>), true, &CJSONObjectFieldCodec::Parse, &CJSONObjectFieldCodec::Read, &CJSONObjectFieldCodec::Dump, &CJSONObjectFieldCodec::Write, &CJSONObjectFieldCodec::Reset, &CJSONObjectFieldCodec::Clear);
+
             std::map < std::string, CJSONValue* >::iterator iter = m_Map.find(name);
             if(iter == m_Map.end())
             {
@@ -838,11 +2213,343 @@ class CJSONValueObject : public CJSONValue
         DerivedClass* GetDerived()  { return m_pDerived; }
         const DerivedClass& GetDefaultValue()   { return *m_pDerived; }
 
+        // true when this instance uses the bindings shared by its type.
+        bool HasSharedFields() const { return m_bSharedFields; }
+
+        // Lazy mode: a streaming parse only notes where the value of each
+        // key is in the text, and a bound member keeps its value until it
+        // is materialized. The parse then costs a skip over the text plus
+        // what is read. The notes point into the parser's text, so
+        // materialize before the parser loads again or goes away; Dump and
+        // Write materialize everything first. After that Materialize fails
+        // and the members keep what they had: the notes hold a reference
+        // to the parser's CJSONTextToken and not to the text. The DOM parse
+        // is never lazy, the jansson tree is already built.
+        bool IsLazy() const { return m_bLazy; }
+        void SetLazy(bool bLazy) { m_bLazy = bLazy; }
+        bool IsMaterialized() const { return m_LazyValues.empty(); }
+
+        // Parses the values that are still to be parsed, or those of one key.
+        bool Materialize()
+        {
+            bool bParseSuccess = true;
+            for(size_t i = 0; i < m_LazyValues.size(); i++)
+            {
+                bParseSuccess = MaterializeValue(m_LazyValues[i]) && bParseSuccess;
+            }
+            m_LazyValues.clear();
+            return bParseSuccess;
+        }
+
+        bool Materialize(const std::string& name)
+        {
+            bool bParseSuccess = true;
+            size_t kept = 0;
+            for(size_t i = 0; i < m_LazyValues.size(); i++)
+            {
+                if(GetLazyName(m_LazyValues[i]) == name)
+                    bParseSuccess = MaterializeValue(m_LazyValues[i]) && bParseSuccess;
+                else
+                    std::swap(m_LazyValues[kept++], m_LazyValues[i]);
+            }
+            m_LazyValues.resize(kept);
+            return bParseSuccess;
+        }
+
+        // For the accessors of a lazy DerivedClass: the member bound to name,
+        // parsed on the first access.
+        template<class TVal>
+        TVal& GetLazyMember(const std::string& name, TVal& member)
+        {
+            Materialize(name);
+            return member;
+        }
+
+    private:
+        // One table per DerivedClass.
+        static CJSONFieldTable& GetFieldTable()
+        {
+            static CJSONFieldTable table;
+            return table;
+        }
+
+        // Only instances of DerivedClass itself use the table. A class
+        // derived from it may bind more, and those members lie beyond the
+        // DerivedClass the offsets are taken in.
+        bool IsTableType() const
+        {
+            return CJSONSharedFields<DerivedClass>::value && m_pDerived && typeid(*m_pDerived) == typeid(DerivedClass);
+        }
+
+        // Once the type's table is ready the Add* calls only switch this
+        // instance over to it, nothing is allocated. A name the table does
+        // not have is a binding this instance loses: warn, the instances
+        // of the type do not bind the same members.
+        bool UseSharedFields(const std::string& name)
+        {
+            if(!m_bSharedFields && GetFieldTable().IsReady() && IsTableType())
+                m_bSharedFields = true;
+            if(m_bSharedFields && !GetFieldTable().Find(name.data(), name.size()))
+                fprintf(stderr, "warning: %s is not in the shared fields of %s, see CJSONSharedFields \n", name.c_str(), GetPath().c_str());
+            return m_bSharedFields;
+        }
+
+        // Describes a binding to the table while it is being collected. It
+        // can only be shared when the member lies inside the object.
+        void AddSharedField(const std::string& name, void* pMember, size_t size, bool bShared, CJSONFieldTable::ParseFunc parse, CJSONFieldTable::ReadFunc read, CJSONFieldTable::DumpFunc dump, CJSONFieldTable::WriteFunc write, CJSONFieldTable::ResetFunc reset, CJSONFieldTable::ClearFunc clear)
+        {
+            if(!IsTableType())
+                return;
+            CJSONFieldTable& table = GetFieldTable();
+            const char* pBase = (const char*)m_pDerived;
+            const char* p = (const char*)pMember;
+            if(!bShared || p < pBase || p + size > pBase + sizeof(DerivedClass))
+            {
+                table.SetDynamic();
+                return;
+            }
+
+            CJSONFieldTable::CField field;
+            field.name = name;
+            field.offset = size_t(p - pBase);
+            field.parse = parse;
+            field.read = read;
+            field.dump = dump;
+            field.write = write;
+            field.reset = reset;
+            field.clear = clear;
+            table.Add(field);
+        }
+
+        // The table is complete once an instance that filled its map is used.
+        void FinishFieldTable()
+        {
+            if(!m_bSharedFields && !m_Map.empty() && IsTableType())
+                GetFieldTable().Finish(m_Map.begin(), m_Map.end());
+        }
+
+        void* GetMember(const CJSONFieldTable::CField& field)
+        {
+            return (char*)m_pDerived + field.offset;
+        }
+
+        bool DumpSharedFields(json_t* pRet)
+        {
+            bool bDumpSuccess = true;
+            const std::vector<CJSONFieldTable::CField>& fields = GetFieldTable().GetFields();
+            for(size_t i = 0; i < fields.size(); i++)
+            {
+                JSON_TRACE_SPAN("dump", fields[i].name);
+                json_t* value = NULL;
+                if ( fields[i].dump(fields[i].name, GetMember(fields[i]), value) )
+                {
+                    if ( json_object_set_new(pRet, fields[i].name.c_str(), value) == -1)
+                    {
+                        bDumpSuccess = false;
+                        std::cout << "Error! Could not add " << fields[i].name << " to object of size "<< json_object_size(pRet) << std::endl;
+                    }
+                }
+                else
+                {
+                    json_decref(value);
+                    bDumpSuccess = false;
+                    std::cout << "Error! Could not dump " << fields[i].name << std::endl;
+                }
+            }
+            return bDumpSuccess;
+        }
+
+        bool IsLazyPending(const std::string& name) const
+        {
+            for(size_t i = 0; i < m_LazyValues.size(); i++)
+            {
+                if(GetLazyName(m_LazyValues[i]) == name)
+                    return true;
+            }
+            return false;
+        }
+
+        // A member is written into an object of its own so that it is
+        // indented as a member of the root.
+        static void BeginMember(CJSONWriter& writer, const std::string& name)
+        {
+            writer.BeginObject();
+            writer.Key(name);
+        }
+
+        static void EndMember(CJSONWriter& writer, const std::string& name, size_t valueBegin, std::vector<CJSONMemberText>& members)
+        {
+            const std::string& text = writer.GetBuffer();
+            size_t begin = 1; // after the '{', before the indent.
+            while(begin < text.size() && (text[begin] == '\n' || text[begin] == ' '))
+                begin++;
+            CJSONMemberText member;
+            member.name = name;
+            member.text = text.substr(begin);
+            member.valueBegin = valueBegin - begin;
+            members.push_back(member);
+        }
+
+        // Duplicate keys: the last one wins like jansson.
+        void KeepMissingValue(const std::string& name, json_t* val)
+        {
+            std::map<std::string, json_t* >::iterator missing = m_MissingValues.find(name);
+            if(missing != m_MissingValues.end())
+            {
+                json_decref(missing->second);
+                missing->second = val;
+            }
+            else
+            {
+                m_MissingValues.insert(pair<string, json_t*>(name, val));
+            }
+        }
+
+        // A key of a lazy parse: the binding it goes to and where its value is.
+        struct CLazyValue
+        {
+            const CJSONFieldTable::CField*  pField;
+            CJSONValue*                     pValue;     // from m_Map when the fields are not shared.
+            const std::string*              pKey;       // m_Map's key for pValue.
+            std::string                     name;       // of a missing value.
+            size_t                          begin;
+            size_t                          end;
+        };
+
+        const std::string& GetLazyName(const CLazyValue& value) const
+        {
+            return value.pField ? value.pField->name : value.pKey ? *value.pKey : value.name;
+        }
+
+        // Notes the keys and skips their values. Keys that are neither bound
+        // nor kept as missing values are dropped here like in the full parse.
+        bool ParseLazy(CJSONReader& reader)
+        {
+            m_LazyValues.clear();
+            CJSONTextToken::Release(m_LazySource.pToken);
+            m_LazySource = reader.GetSource();
+            CJSONTextToken::AddRef(m_LazySource.pToken);
+            bool bParseSuccess = reader.BeginObject();
+            FinishFieldTable();
+            JSON_STATS_ADD(objects, 1);
+            std::string& name = reader.GetKeyBuffer();
+            while(reader.NextKey(name))
+            {
+                CLazyValue value;
+                value.pField = m_bSharedFields ? GetFieldTable().Find(name.data(), name.size()) : NULL;
+                value.pValue = NULL;
+                value.pKey = NULL;
+                if(!m_bSharedFields)
+                {
+                    std::map<std::string, CJSONValue* >::iterator elem = m_Map.find(name);
+                    if(elem != m_Map.end())
+                    {
+                        value.pValue = elem->second;
+                        value.pKey = &elem->first;
+                    }
+                }
+                if(!value.pField && !value.pValue)
+                {
+                    if(!m_bUpdate)
+                    {
+                        JSON_STATS_ADD(skippedKeys, 1);
+                        reader.SkipValue();
+                        continue;
+                    }
+                    JSON_STATS_ADD(unknownKeys, 1);
+                    value.name = name;
+                }
+                value.begin = reader.GetPosition();
+                if(!reader.SkipValue())
+                    break;
+                value.end = reader.GetPosition();
+                m_LazyValues.push_back(value);
+            }
+            if(reader.HasError())
+                m_LazyValues.clear();
+            return bParseSuccess && !reader.HasError();
+        }
+
+        bool MaterializeValue(const CLazyValue& value)
+        {
+            if(m_LazySource.pToken && !m_LazySource.pToken->IsValid())
+            {
+                fprintf(stderr, "warning: %s can not be materialized, the parser's text is gone \n", GetLazyName(value).c_str());
+                return false;
+            }
+            CJSONReader reader(m_LazySource, value.begin, value.end);
+            JSON_STATS_MEMBER(GetLazyName(value));
+            JSON_TRACE_SPAN("parse", GetLazyName(value));
+            bool bParseSuccess = false;
+            if(value.pField)
+            {
+                bParseSuccess = value.pField->read(value.pField->name, GetMember(*value.pField), reader);
+            }
+            else if(value.pValue)
+            {
+                bParseSuccess = value.pValue->Parse(reader);
+            }
+            else
+            {
+                json_t* val = reader.ReadValue();
+                if(val)
+                    KeepMissingValue(value.name, val);
+                bParseSuccess = (val != NULL);
+            }
+            if(reader.HasError())
+                fprintf(stderr, "warning: %s \n", reader.GetError().text);
+            return bParseSuccess && !reader.HasError();
+        }
+
+        // Writes the missing values that go before the key pNext (all that
+        // are left when it is NULL). Without JSON_SORT_KEYS they all go
+        // after the bound fields.
+        bool WriteMissingValues(CJSONWriter& writer, std::map<std::string, json_t* >::iterator& missing, const std::map<std::string, json_t* >::iterator& missingEnd, const std::string* pNext)
+        {
+            bool bWriteSuccess = true;
+            for(; bWriteSuccess && missing != missingEnd && (!pNext || (writer.SortKeys() && missing->first < *pNext)); missing++)
+            {
+                bWriteSuccess = writer.Key(missing->first) && writer.WriteValue(missing->second);
+                if(!bWriteSuccess)
+                    std::cout << "Error! Could not add " << missing->first << " to object " << GetPath() << std::endl;
+            }
+            return bWriteSuccess;
+        }
+
     private:
         DerivedClass*                               m_pDerived;
         std::map < std::string, CJSONValue* >       m_Map;              // map for each element in the object at this level. How to access data?
         bool                                        m_bUpdate;
         map<string, json_t*>                        m_MissingValues;
+        bool                                        m_bSharedFields;    // bindings come from GetFieldTable(), m_Map is not used.
+        bool                                        m_bLazy;
+        CJSONReader::CSource                        m_LazySource;       // text of the last lazy parse.
+        std::vector<CLazyValue>                     m_LazyValues;       // not parsed yet, in the order of the text.
+
+        // The text of the last Write and how it was written.
+        struct CWriteCache
+        {
+            CWriteCache() : flags(0), format(JSON_FORMAT_TEXT), depth(0), bValid(false), bDirect(false) {}
+
+            bool Matches(const CJSONWriter& writer, size_t at) const
+            {
+                return bValid && flags == writer.GetFlags() && format == writer.GetFormat() && depth == at;
+            }
+
+            std::string                     text;
+            std::vector<CJSONDumpSplice>    splices;    // by offset.
+            size_t                          flags;
+            CJSONFormat                     format;
+            size_t                          depth;
+            bool                            bValid;
+            bool                            bDirect;    // the last one could not be kept, write without.
+        };
+
+        bool                                        m_bCacheDumps;
+        bool                                        m_bDumpCached;      // m_pJValue is the last Dump and still holds.
+        size_t                                      m_Modifications;
+        CWriteCache                                 m_WriteCache;
+        std::string                                 m_Snapshot;         // CBOR of the object, only with CJSONDumpCheck.
 };
 
 
@@ -895,14 +2602,36 @@ class CJSONValuePointer : public CJSONValue
     // Overloaded Methods
         bool Parse (const json_t* pVal)
         {
+            CJSONPathScope path(m_pJson, this);
             return m_pJson->Parse(pVal);
         }
 
+        bool Parse (CJSONReader& reader)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the reader overload.
+            CJSONPathScope path(pJson, this);
+            return pJson->Parse(reader);
+        }
+
         bool Dump (json_t*& pRet)
         {
+            CJSONDumpScope::CPointer pointer; // see CJSONValueObject::SetCacheDumps.
             return m_pJson->Dump(pRet);
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the writer overload.
+            CJSONPathScope path(pJson, this);
+            CJSONDumpScope::CPointer pointer;
+            return pJson->Write(writer);
+        }
+
+        void Reset()
+        {
+            m_pJson->Reset();
+        }
+
     // Accessor Methods
         const TVal* GetValue() const { return *m_pValue; }
         TVal* GetDefaultValue() const { return m_DefaultValue; }
@@ -948,14 +2677,36 @@ class CJSONValuePointer<TVal, CJSONValueObject<TVal> > : public CJSONValue
     // Overloaded Methods
         bool Parse (const json_t* pVal)
         {
+            CJSONPathScope path(m_pJson, this);
             return m_pJson->Parse(pVal);
         }
 
+        bool Parse (CJSONReader& reader)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the reader overload.
+            CJSONPathScope path(pJson, this);
+            return pJson->Parse(reader);
+        }
+
         bool Dump (json_t*& pRet)
         {
+            CJSONDumpScope::CPointer pointer; // see CJSONValueObject::SetCacheDumps.
             return m_pJson->Dump(pRet);
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the writer overload.
+            CJSONPathScope path(pJson, this);
+            CJSONDumpScope::CPointer pointer;
+            return pJson->Write(writer);
+        }
+
+        void Reset()
+        {
+            m_pJson->Reset();
+        }
+
     // Accessor Methods
         const TVal* GetValue() const { return *m_pValue; }
         TVal* GetDefaultValue() const { return m_DefaultValue; }
@@ -1002,14 +2753,36 @@ class CJSONValueSmartPointer : public CJSONValue
     // Overloaded Methods
         bool Parse (const json_t* pVal)
         {
+            CJSONPathScope path(m_pJson, this);
             return m_pJson->Parse(pVal);
         }
 
+        bool Parse (CJSONReader& reader)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the reader overload.
+            CJSONPathScope path(pJson, this);
+            return pJson->Parse(reader);
+        }
+
         bool Dump (json_t*& pRet)
         {
+            CJSONDumpScope::CPointer pointer; // see CJSONValueObject::SetCacheDumps.
             return m_pJson->Dump(pRet);
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the writer overload.
+            CJSONPathScope path(pJson, this);
+            CJSONDumpScope::CPointer pointer;
+            return pJson->Write(writer);
+        }
+
+        void Reset()
+        {
+            m_pJson->Reset();
+        }
+
     // Accessor Methods
         const TVal* GetValue() const { return *m_pValue; }
         SmartPointer<TVal> GetDefaultValue() const { return m_DefaultValue; }
@@ -1052,14 +2825,36 @@ class CJSONValueSmartPointer<TVal, SmartPointer, CJSONValueObject<TVal> > : publ
     // Overloaded Methods
         bool Parse (const json_t* pVal)
         {
+            CJSONPathScope path(m_pJson, this);
             return m_pJson->Parse(pVal);
         }
 
+        bool Parse (CJSONReader& reader)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the reader overload.
+            CJSONPathScope path(pJson, this);
+            return pJson->Parse(reader);
+        }
+
         bool Dump (json_t*& pRet)
         {
+            CJSONDumpScope::CPointer pointer; // see CJSONValueObject::SetCacheDumps.
             return m_pJson->Dump(pRet);
         }
 
+        bool Write (CJSONWriter& writer)
+        {
+            CJSONValue* pJson = m_pJson; // JVal may hide the writer overload.
+            CJSONPathScope path(pJson, this);
+            CJSONDumpScope::CPointer pointer;
+            return pJson->Write(writer);
+        }
+
+        void Reset()
+        {
+            m_pJson->Reset();
+        }
+
     // Accessor Methods
         const TVal* GetValue() const { return *m_pValue; }
         SmartPointer<TVal> GetDefaultValue() const { return m_DefaultValue; }
@@ -1079,27 +2874,34 @@ class CJSONValueSmartPointer<TVal, SmartPointer, CJSONValueObject<TVal> > : publ
 class CJSONParser
 {
     public:
-        CJSONParser(size_t flags = (JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER)) : m_pRoot(NULL), m_Flags(flags)
+        CJSONParser(size_t flags = (JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER), bool bStreaming = JSON_PARSER_STREAMING_DEFAULT) : m_pRoot(NULL), m_Flags(flags), m_bStreaming(bStreaming), m_bMemoryMap(JSON_PARSER_MEMORY_MAP_DEFAULT), m_bPatchInPlace(JSON_PARSER_PATCH_IN_PLACE_DEFAULT), m_bArena(JSON_PARSER_ARENA_DEFAULT), m_Format(JSON_FORMAT_TEXT), m_pText(NULL), m_TextSize(0), m_pTextToken(NULL), m_pThreadPool(NULL), m_pStats(NULL)
         {
+            m_LastError.text[0] = '\0';
         }
 
         ~CJSONParser()
         {
-            json_decref(m_pRoot); // Realease ownership
+            ReleaseRoot(); // Realease ownership
+            CJSONTextToken::Release(m_pTextToken);
         }
 
+        // Text only, CBOR has nul bytes. Use LoadFromBuffer for it.
         bool Load(const char* pBuffer)
         {
-            if(m_pRoot)
-            {
-                json_decref(m_pRoot); // Release ownership.
-                m_pRoot = NULL;
-            }
+            JSON_TRACE_SPAN("parser", "Load");
+            if(UseReader())
+                return LoadText(pBuffer, strlen(pBuffer));
 
+            ReleaseRoot();
+
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_ADD(bytesRead, strlen(pBuffer));
+            JSON_STATS_PHASE(PHASE_TOKENIZE);
+            CJSONArena::CScope arena(GetArena());
             m_pRoot = json_loads(pBuffer, 0, &m_LastError);
             if(!m_pRoot)
             {
-                fprintf(stderr, "warning: %s \n", m_LastError.text);
+                ReportError();
                 return false;
             }
             return true;
@@ -1107,21 +2909,27 @@ class CJSONParser
 
         bool LoadFromString(const std::string& str)
         {
+            if(m_Format != JSON_FORMAT_TEXT)
+                return LoadFromBuffer(str.data(), str.size());
             return Load(str.c_str());
         }
 
         bool LoadFromBuffer(const char* pBuffer, const size_t& size)
         {
-            if(m_pRoot)
-            {
-                json_decref(m_pRoot); // Release ownership.
-                m_pRoot = NULL;
-            }
+            JSON_TRACE_SPAN("parser", "LoadFromBuffer");
+            if(UseReader())
+                return LoadText(pBuffer, size);
+
+            ReleaseRoot();
 
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_ADD(bytesRead, size);
+            JSON_STATS_PHASE(PHASE_TOKENIZE);
+            CJSONArena::CScope arena(GetArena());
             m_pRoot = json_loadb(pBuffer, size, 0, &m_LastError);
             if(!m_pRoot)
             {
-                fprintf(stderr, "warning: %s \n", m_LastError.text);
+                ReportError();
                 return false;
             }
             return true;
@@ -1129,48 +2937,209 @@ class CJSONParser
 
         bool LoadFromFile(const std::string& Path)
         {
-            if(m_pRoot)
+            JSON_TRACE_SPAN("parser", "LoadFromFile");
+            ReleaseRoot();
+            JSON_STATS_SCOPE(m_pStats);
+
+            if(UseReader())
             {
-                json_decref(m_pRoot); // Release ownership.
-                m_pRoot = NULL;
+                bool bReadSuccess = false;
+                {
+                    JSON_STATS_PHASE(PHASE_READ);
+                    bReadSuccess = m_bMemoryMap && CJSONMappedFile::IsSupported() ? MapFile(Path) : ReadFile(Path);
+                }
+                if(!bReadSuccess)
+                {
+                    ReportError();
+                    return false;
+                }
+                JSON_STATS_ADD(bytesRead, m_TextSize);
+                return CheckText();
+            }
+
+            {
+                JSON_STATS_PHASE(PHASE_TOKENIZE);
+                CJSONArena::CScope arena(GetArena());
+                m_pRoot = json_load_file(Path.c_str(), 0, &m_LastError);
+            }
+            if(!m_pRoot)
+            {
+                ReportError();
+                return false;
+            }
+            JSON_STATS_ADD(bytesRead, CJSONStats::FileSize(Path));
+            return true;
+        }
+
+        template<class TVal>
+        bool ParseObjectFromArray(const size_t& index, CJSONValueObject<TVal>* pOject)
+        {
+            JSON_TRACE_SPAN("parser", "ParseObjectFromArray");
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_PHASE(PHASE_BIND);
+            bool bParseSuccess = false;
+            if(!m_pRoot && m_pText)
+            {
+                CJSONReader reader(m_pText, m_TextSize, &m_Index, m_Format);
+                reader.SetThreadPool(m_pThreadPool);
+                reader.SetKeyBuffer(&m_Key);
+                reader.SetTokenBuffer(&m_Tokens);
+                reader.SetTextToken(GetTextToken());
+                bool bFound = reader.BeginArray();
+                for(size_t i = 0; bFound && i < index; i++)
+                {
+                    bFound = reader.NextElement() && reader.SkipValue();
+                }
+                bFound = bFound && reader.NextElement();
+
+                if(bFound)
+                {
+                    bParseSuccess = pOject->Parse(reader);
+                }
+                else if(!reader.HasError())
+                {
+                    bParseSuccess = pOject->Parse((const json_t*)NULL); // index is past the end.
+                }
+                return CheckReader(reader, false) && bParseSuccess;
+            }
+
+            CJSONArena::CScope arena(GetArena()); // values kept by the objects are copied out.
+            json_t* object_data = json_array_get(m_pRoot, index);
+            bParseSuccess = pOject->Parse(object_data);
+
+            return bParseSuccess;
+        }
+
+        template<class TVal>
+        bool ParseObject(CJSONValueObject<TVal>* pOject)
+        {
+            JSON_TRACE_SPAN("parser", "ParseObject");
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_PHASE(PHASE_BIND);
+            bool bParseSuccess = false;
+            if(!m_pRoot && m_pText)
+            {
+                CJSONReader reader(m_pText, m_TextSize, &m_Index, m_Format);
+                reader.SetThreadPool(m_pThreadPool);
+                reader.SetKeyBuffer(&m_Key);
+                reader.SetTokenBuffer(&m_Tokens);
+                reader.SetTextToken(GetTextToken());
+                bParseSuccess = pOject->Parse(reader);
+                return CheckReader(reader, true) && bParseSuccess;
+            }
+
+            CJSONArena::CScope arena(GetArena());
+            bParseSuccess = pOject->Parse(m_pRoot);
+            return bParseSuccess;
+        }
+
+        // Parses a root array of objects, appending them to pArray. In
+        // streaming mode with a thread pool set the elements are parsed in
+        // parallel.
+        template<class TVal>
+        bool ParseObjectArray(std::vector<TVal>* pArray)
+        {
+            JSON_TRACE_SPAN("parser", "ParseObjectArray");
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_PHASE(PHASE_BIND);
+            CJSONValueArray<TVal, CJSONValueObject<TVal> > array("root", pArray);
+            CJSONValue& jval = array;
+            if(!m_pRoot && m_pText)
+            {
+                CJSONReader reader(m_pText, m_TextSize, &m_Index, m_Format);
+                reader.SetThreadPool(m_pThreadPool);
+                reader.SetKeyBuffer(&m_Key);
+                reader.SetTokenBuffer(&m_Tokens);
+                reader.SetTextToken(GetTextToken());
+                bool bParseSuccess = jval.Parse(reader);
+                return CheckReader(reader, true) && bParseSuccess;
+            }
+            CJSONArena::CScope arena(GetArena());
+            return jval.Parse(m_pRoot);
+        }
+
+        // Parses the values at JSON Pointers (see json_pointer.h) into their
+        // bindings, which are not owned, in one pass over the document: the
+        // subtrees that lead to no target are skipped without building
+        // anything and the pass stops once every target is found, so the
+        // text after the last one is not looked at. With duplicate keys the
+        // streaming parse takes the first and jansson the last. false if a
+        // pointer is malformed or not in the document, or a value does not
+        // parse; the others are parsed all the same, a malformed pointer is
+        // skipped.
+        bool ParsePointers(const std::vector< std::pair<std::string, CJSONValue*> >& targets)
+        {
+            JSON_TRACE_SPAN("parser", "ParsePointers");
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_PHASE(PHASE_BIND);
+            bool bParseSuccess = true;
+            std::vector<CPointerTarget> walk(targets.size());
+            std::vector<size_t> active;
+            for(size_t i = 0; i < targets.size(); i++)
+            {
+                walk[i].pValue = targets[i].second;
+                walk[i].bFound = false;
+                if(!CJSONPointer::Split(targets[i].first, walk[i].tokens))
+                {
+                    fprintf(stderr, "warning: %s is not a JSON Pointer \n", targets[i].first.c_str());
+                    bParseSuccess = false;
+                    continue;
+                }
+                active.push_back(i);
+            }
+
+            if(!m_pRoot && m_pText)
+            {
+                CJSONReader reader(m_pText, m_TextSize, &m_Index, m_Format);
+                reader.SetKeyBuffer(&m_Key);
+                reader.SetTokenBuffer(&m_Tokens);
+                reader.SetTextToken(GetTextToken());
+                size_t left = active.size();
+                bParseSuccess = WalkPointerValue(reader, walk, active, 0, left) && bParseSuccess;
+                bParseSuccess = CheckReader(reader, false) && bParseSuccess;
+            }
+            else
+            {
+                CJSONArena::CScope arena(GetArena());
+                for(size_t i = 0; i < active.size(); i++)
+                {
+                    CPointerTarget& target = walk[active[i]];
+                    json_t* pVal = FindPointer(m_pRoot, target.tokens);
+                    if(pVal)
+                    {
+                        target.bFound = true;
+                        bParseSuccess = target.pValue->Parse((const json_t*)pVal) && bParseSuccess;
+                    }
+                }
             }
 
-            m_pRoot = json_load_file(Path.c_str(), 0, &m_LastError);
-            if(!m_pRoot)
+            for(size_t i = 0; i < active.size(); i++)
             {
-                fprintf(stderr, "warning: %s \n", m_LastError.text);
-                return false;
+                if(!walk[active[i]].bFound)
+                {
+                    fprintf(stderr, "warning: %s not found \n", targets[active[i]].first.c_str());
+                    bParseSuccess = false;
+                }
             }
-            return true;
-        }
-
-        template<class TVal>
-        bool ParseObjectFromArray(const size_t& index, CJSONValueObject<TVal>* pOject)
-        {
-            bool bParseSuccess = false;
-            json_t* object_data = json_array_get(m_pRoot, index);
-            bParseSuccess = pOject->Parse(object_data);
-
             return bParseSuccess;
         }
 
-        template<class TVal>
-        bool ParseObject(CJSONValueObject<TVal>* pOject)
+        bool ParsePointer(const std::string& pointer, CJSONValue* pValue)
         {
-            bool bParseSuccess = false;
-            bParseSuccess = pOject->Parse(m_pRoot);
-            return bParseSuccess;
+            return ParsePointers(std::vector< std::pair<std::string, CJSONValue*> >(1, std::make_pair(pointer, pValue)));
         }
 
         template<class TVal>
         bool DumpObjectToFile(const std::string& Path, CJSONValueObject<TVal>* pOject)
         {
+            JSON_TRACE_SPAN("parser", "DumpObjectToFile");
+            if(UseReader())
+                return WriteObjectToFile(Path, pOject);
+
             bool bDumpSuccess = false;
-            if(m_pRoot)
-            {
-                json_decref(m_pRoot); // Release ownership.
-                m_pRoot = NULL;
-            }
+            ReleaseRoot();
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_PHASE(PHASE_DUMP);
 
             if(pOject->Dump(m_pRoot))
             {
@@ -1181,10 +3150,15 @@ class CJSONParser
                     cout << "Error dumping file to disk!" << endl;;
                     perror("Error dumping file");
                 }
+                else
+                {
+                    JSON_STATS_ADD(bytesWritten, CJSONStats::FileSize(Path));
+                }
             }
             else
             {
                 std::cout << "Error dumping object! " << std::endl;
+                m_pRoot = NULL; // not referenced, ClearBuffer frees what was dumped.
             }
             pOject->ClearBuffer();
 
@@ -1194,12 +3168,22 @@ class CJSONParser
         template<class TVal>
         bool DumpObjectToString(std::string& ret, CJSONValueObject<TVal>* pOject)
         {
+            JSON_TRACE_SPAN("parser", "DumpObjectToString");
             ret.clear();
-            if(m_pRoot)
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_PHASE(PHASE_DUMP);
+            if(UseReader())
             {
-                json_decref(m_pRoot); // Release ownership.
-                m_pRoot = NULL;
+                CJSONWriter writer(m_Flags, NULL, m_Format);
+                CJSONValue& jval = *pOject;
+                if(jval.Write(writer) && writer.Flush())
+                    ret.swap(writer.GetBuffer());
+                else
+                    cout << "Error dumping file to string!" << endl;
+                JSON_STATS_ADD(bytesWritten, ret.size());
+                return ret.length() > 0;
             }
+            ReleaseRoot();
 
             if(pOject->Dump(m_pRoot))
             {
@@ -1216,40 +3200,112 @@ class CJSONParser
                     free(s);                // free the memory
                 }
             }
+            else
+            {
+                m_pRoot = NULL; // not referenced, ClearBuffer frees what was dumped.
+            }
             pOject->ClearBuffer();
+            JSON_STATS_ADD(bytesWritten, ret.size());
             return ret.length() > 0;
         }
 
 
-//        template<class TVal>
-//        bool UpdateObjectToFile(const std::string& Path, CJSONValueObject<TVal>* pOject)
-//        {
-//            bool bUpdateSuccess = false;
-//
-//            if(m_pRoot)
-//            {
-//                json_decref(m_pRoot); // Release ownership.
-//                m_pRoot = NULL;
-//            }
-//
-//            json_t* pJson = NULL;
-//            if(pOject->Dump(pJson) && LoadFromFile(Path))    // Current version && Previous version
-//            {
-//                if(json_object_update(m_pRoot, pJson) == 0) // update root with the object
-//                {
-//                    bUpdateSuccess = (json_dump_file(m_pRoot, Path.c_str(), m_Flags) == 0);
-//                }else { cout << "Error could not update object" << endl;}
-//            }else { cout << "Error could not dump object and/or Load from file. Object @ "<< pJson << " root @ "<< m_pRoot << endl;}
-//
-//            pOject->ClearBuffer();
-//
-//            return bUpdateSuccess;
-//        }
+        // Writes only the root members of the file that differ from the
+        // object's, compared as text with the whitespace outside strings
+        // ignored. The file is rewritten like a dump, through a temporary
+        // file, with the unchanged bytes copied as they are. With
+        // SetPatchInPlace, when every changed value fits in the bytes of
+        // the old one (padded with spaces) they are written over it in the
+        // file instead, which is not crash safe. Members the object does not
+        // bind or keep as missing values stay as they are, new ones go at
+        // the end. Without a readable file holding one object (or for CBOR)
+        // this is DumpObjectToFile.
+        template<class TVal>
+        bool UpdateObjectToFile(const std::string& Path, CJSONValueObject<TVal>* pOject)
+        {
+            JSON_TRACE_SPAN("parser", "UpdateObjectToFile");
+            if(m_Format != JSON_FORMAT_TEXT)
+                return DumpObjectToFile(Path, pOject);
+
+            ReleaseRoot();
+            JSON_STATS_SCOPE(m_pStats);
+            std::vector<CJSONMemberText> members;
+            bool bWriteSuccess = false;
+            {
+                JSON_STATS_PHASE(PHASE_DUMP);
+                bWriteSuccess = pOject->WriteMembers(m_Flags, members);
+            }
+            if(!bWriteSuccess)
+            {
+                std::cout << "Error dumping object! " << std::endl;
+                return false;
+            }
+
+            std::vector<CFileMember> file;
+            size_t insertAt = 0;
+            bool bReadSuccess = false;
+            {
+                JSON_STATS_PHASE(PHASE_READ);
+                bReadSuccess = m_bMemoryMap && CJSONMappedFile::IsSupported() ? MapFile(Path) : ReadFile(Path);
+            }
+            if(!bReadSuccess || !FindFileMembers(file, insertAt))
+            {
+                ReleaseRoot();
+                return DumpObjectToFile(Path, pOject);
+            }
+
+            std::vector<CFileEdit> edits;   // in the order of the file.
+            std::string inserts;
+            bool bInPlace = m_bPatchInPlace;
+            for(size_t i = 0; i < members.size(); i++)
+            {
+                const CJSONMemberText& member = members[i];
+                const char* pValue = member.text.data() + member.valueBegin;
+                const char* pValueEnd = member.text.data() + member.text.size();
+                std::vector<CFileMember>::iterator found = std::lower_bound(file.begin(), file.end(), member.name);
+                if(found == file.end() || found->name != member.name)
+                {
+                    AppendMember(inserts, member.text, file.empty() && inserts.empty());
+                    bInPlace = false;
+                }
+                else if(!SameText(m_pText + found->begin, m_pText + found->end, pValue, pValueEnd))
+                {
+                    CFileEdit edit = { found->begin, found->end, i };
+                    edits.push_back(edit);
+                    bInPlace = bInPlace && size_t(pValueEnd - pValue) <= found->end - found->begin;
+                }
+            }
+            if(edits.empty() && inserts.empty())
+            {
+                ReleaseRoot();
+                return true;
+            }
+            std::sort(edits.begin(), edits.end());
+
+            JSON_STATS_PHASE(PHASE_OUTPUT);
+            bool bUpdateSuccess = bInPlace ? PatchFile(Path, members, edits) : RewriteFile(Path, members, edits, inserts, insertAt, file.empty());
+            ReleaseRoot();
+            if(!bUpdateSuccess)
+            {
+                cout << "Error updating file on disk!" << endl;
+                perror("Error updating file");
+            }
+            return bUpdateSuccess;
+        }
 
         size_t RootArrayLength()
         {
             if ( IsRootArray() )
             {
+                if(!m_pRoot)
+                {
+                    size_t n = 0;
+                    CJSONReader reader(m_pText, m_TextSize, &m_Index, m_Format);
+                    reader.BeginArray();
+                    while(reader.NextElement() && reader.SkipValue())
+                        n++;
+                    return n;
+                }
                 return json_array_size(m_pRoot);
             }
             return 0;
@@ -1258,47 +3314,600 @@ class CJSONParser
         bool IsRootObject()
         {
             if(IsRootValid())
-                return json_is_object(m_pRoot);
+                return m_pRoot ? json_is_object(m_pRoot) : PeekText() == JSON_OBJECT;
             return false;
         }
 
         bool IsRootArray()
         {
             if(IsRootValid())
-                return json_is_array(m_pRoot);
+                return m_pRoot ? json_is_array(m_pRoot) : PeekText() == JSON_ARRAY;
             return false;
         }
 
         bool IsRootString()
         {
             if(IsRootValid())
-                return json_is_string(m_pRoot);
+                return m_pRoot ? json_is_string(m_pRoot) : PeekText() == JSON_STRING;
             return false;
         }
 
         bool IsRootNumber()
         {
             if(IsRootValid())
-                return json_is_number(m_pRoot);
+            {
+                json_type type = m_pRoot ? json_typeof(m_pRoot) : PeekText();
+                return type == JSON_INTEGER || type == JSON_REAL;
+            }
             return false;
         }
 
         bool IsRootBool()
         {
             if(IsRootValid())
-                return json_is_boolean(m_pRoot);
+            {
+                json_type type = m_pRoot ? json_typeof(m_pRoot) : PeekText();
+                return type == JSON_TRUE || type == JSON_FALSE;
+            }
             return false;
         }
 
         bool IsRootValid()
         {
-            return (m_pRoot && !json_is_null(m_pRoot));
+            return (m_pRoot && !json_is_null(m_pRoot)) || m_pText != NULL;
+        }
+
+        // Drops the loaded document as the next load would. What the parser
+        // needed for it (the text and its index, the arena's block, the key
+        // scratch) stays allocated for the next one, so a parser kept for
+        // many small documents stops allocating once they have all fitted.
+        // With bKeepBuffers false the memory goes too, e.g. after an
+        // unusually large document.
+        void Reset(bool bKeepBuffers = true)
+        {
+            ReleaseRoot();
+            if(!bKeepBuffers)
+            {
+                std::string().swap(m_Text);
+                std::string().swap(m_Key);
+                std::vector<uint32_t>().swap(m_Tokens);
+                m_Index.Shrink();
+                m_Arena.Purge();
+            }
+        }
+
+        bool IsStreaming() const { return m_bStreaming; }
+        void SetStreaming(bool bStreaming) { m_bStreaming = bStreaming; }
+
+        // JSON_FORMAT_CBOR loads and dumps CBOR instead of text. It always
+        // goes through CJSONReader and CJSONWriter, whatever IsStreaming
+        // says, since jansson has no CBOR.
+        CJSONFormat GetFormat() const { return m_Format; }
+        void SetFormat(CJSONFormat format) { m_Format = format; }
+
+        // Streaming LoadFromFile maps the file rather than reading it. The
+        // mapping is released by the next load or dump, the parsed values
+        // are copies so they stay valid.
+        bool IsMemoryMap() const { return m_bMemoryMap; }
+        void SetMemoryMap(bool bMemoryMap) { m_bMemoryMap = bMemoryMap; }
+
+        // UpdateObjectToFile writes the changed values over the old ones in
+        // the file when they fit. Not crash safe: a crash part way leaves
+        // the file half updated, which a rewrite never does. Only for files
+        // that can be rebuilt, see JSON_PARSER_PATCH_IN_PLACE_DEFAULT.
+        bool IsPatchInPlace() const { return m_bPatchInPlace; }
+        void SetPatchInPlace(bool bPatchInPlace) { m_bPatchInPlace = bPatchInPlace; }
+
+        // A DOM load builds its tree in an arena the parser owns, which is
+        // emptied with the root (the next load, or the destructor). The
+        // first load with it on installs jansson's allocation hooks for
+        // the program. The stats are for the current load. Needs c++11,
+        // see json_arena.h.
+        bool IsArena() const { return m_bArena; }
+        void SetArena(bool bArena) { m_bArena = bArena; }
+        const CJSONArena::CStats& GetArenaStats() const { return m_Arena.GetStats(); }
+
+        // Pool used by the streaming parse for large arrays of objects, NULL
+        // (the default) parses on the calling thread. Not owned, it must
+        // outlive the parse calls. Needs c++11, see json_thread_pool.h.
+        CJSONThreadPool* GetThreadPool() const { return m_pThreadPool; }
+        void SetThreadPool(CJSONThreadPool* pPool) { m_pThreadPool = pPool; }
+
+        // Stats the loads, parses and dumps of this parser add to, NULL (the
+        // default) for none. Not owned. Only recorded when built with
+        // JSON_STATS, see json_stats.h.
+        CJSONStats* GetStats() const { return m_pStats; }
+        void SetStats(CJSONStats* pStats) { m_pStats = pStats; }
+
+        // Why the last load failed.
+        const json_error_t& GetLastError() const { return m_LastError; }
+
+    private:
+        bool UseReader() const { return m_bStreaming || m_Format != JSON_FORMAT_TEXT; }
+
+        CJSONArena* GetArena() { return m_bArena ? &m_Arena : NULL; }
+
+        void ReleaseRoot()
+        {
+            if(m_pRoot)
+            {
+                // A tree in the arena goes with it, nothing else refers to
+                // it (CJSONArena::Keep).
+                if(!m_Arena.Owns(m_pRoot))
+                    json_decref(m_pRoot); // Release ownership.
+                m_pRoot = NULL;
+            }
+            m_Arena.Release();
+            if(m_pTextToken && m_pTextToken->IsShared()) // kept for the next text when no lazy object noted it.
+            {
+                m_pTextToken->Invalidate();
+                CJSONTextToken::Release(m_pTextToken);
+                m_pTextToken = NULL;
+            }
+            m_Text.clear();
+            m_File.Close();
+            m_pText = NULL;
+            m_TextSize = 0;
+            m_Index.Clear();
+        }
+
+        // Handed to the readers over the text. A new one is made once a lazy
+        // object has noted the last, see ReleaseRoot.
+        CJSONTextToken* GetTextToken()
+        {
+            if(!m_pTextToken)
+                m_pTextToken = new CJSONTextToken();
+            return m_pTextToken;
+        }
+
+        bool LoadText(const char* pBuffer, size_t size)
+        {
+            ReleaseRoot();
+            JSON_STATS_SCOPE(m_pStats);
+            JSON_STATS_ADD(bytesRead, size);
+            m_Text.assign(pBuffer, size);
+            m_pText = m_Text.data();
+            m_TextSize = m_Text.size();
+            return CheckText();
+        }
+
+        bool MapFile(const std::string& Path)
+        {
+            if(!m_File.Open(Path))
+            {
+                snprintf(m_LastError.text, sizeof(m_LastError.text), "unable to open %s: %s", Path.c_str(), strerror(errno));
+                return false;
+            }
+            m_pText = m_File.GetData();
+            m_TextSize = m_File.GetSize();
+            return true;
+        }
+
+        bool ReadFile(const std::string& Path)
+        {
+            FILE* pFile = fopen(Path.c_str(), "rb");
+            if(!pFile)
+            {
+                snprintf(m_LastError.text, sizeof(m_LastError.text), "unable to open %s: %s", Path.c_str(), strerror(errno));
+                return false;
+            }
+
+            bool bReadSuccess = true;
+            if(fseek(pFile, 0, SEEK_END) == 0)
+            {
+                long size = ftell(pFile);
+                rewind(pFile);
+                if(size > 0)
+                {
+                    m_Text.resize(size_t(size));
+                    bReadSuccess = fread(&m_Text[0], 1, m_Text.size(), pFile) == m_Text.size();
+                }
+            }
+            else
+            {
+                char buffer[4096];
+                size_t n;
+                while((n = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+                    m_Text.append(buffer, n);
+                bReadSuccess = !ferror(pFile);
+            }
+            fclose(pFile);
+
+            if(!bReadSuccess)
+            {
+                snprintf(m_LastError.text, sizeof(m_LastError.text), "unable to read %s", Path.c_str());
+                m_Text.clear();
+                return false;
+            }
+            m_pText = m_Text.data();
+            m_TextSize = m_Text.size();
+            return true;
+        }
+
+        // Streams the text to a temporary file which replaces Path once it
+        // is complete (see json_replace_file.h), so a dump that fails part
+        // way leaves the old file as the jansson dump (which fails before
+        // opening the file) does.
+        template<class TVal>
+        bool WriteObjectToFile(const std::string& Path, CJSONValueObject<TVal>* pOject)
+        {
+            CJSONReplaceFile file;
+            FILE* pFile = file.Open(Path, m_Format != JSON_FORMAT_TEXT);
+            if(!pFile)
+            {
+                cout << "Error dumping file to disk!" << endl;;
+                perror("Error dumping file");
+                return false;
+            }
+
+            JSON_STATS_SCOPE(m_pStats);
+            CJSONWriter writer(m_Flags, pFile, m_Format);
+            CJSONValue& jval = *pOject;
+            bool bWriteSuccess = false;
+            {
+                JSON_STATS_PHASE(PHASE_DUMP);
+                bWriteSuccess = jval.Write(writer);
+            }
+            JSON_STATS_PHASE(PHASE_OUTPUT);
+            bool bDumpSuccess = bWriteSuccess && writer.Flush();
+            if(bDumpSuccess)
+                JSON_STATS_ADD(bytesWritten, size_t(ftell(pFile)));
+            bDumpSuccess = bDumpSuccess && file.Commit();
+            if(!bDumpSuccess)
+            {
+                if(bWriteSuccess)
+                {
+                    cout << "Error dumping file to disk!" << endl;;
+                    perror("Error dumping file");
+                }
+                else
+                {
+                    std::cout << "Error dumping object! " << std::endl;
+                }
+                file.Abort();
+            }
+            return bDumpSuccess;
+        }
+
+        // A root member of the file being updated, by name.
+        struct CFileMember
+        {
+            std::string name;
+            size_t      begin;  // of the value.
+            size_t      end;
+            bool operator<(const CFileMember& other) const { return name < other.name; }
+            bool operator<(const std::string& other) const { return name < other; }
+        };
+
+        // The value of members[member] goes over [begin, end) of the file.
+        struct CFileEdit
+        {
+            size_t  begin;
+            size_t  end;
+            size_t  member;
+            bool operator<(const CFileEdit& other) const { return begin < other.begin; }
+        };
+
+        // The loaded text's root members, sorted by name, and where new ones
+        // go: after the last member, or after the '{'. false if the text is
+        // not one object or has a key twice, it is then rewritten.
+        bool FindFileMembers(std::vector<CFileMember>& file, size_t& insertAt)
+        {
+            m_Index.Build(m_pText, m_TextSize);
+            CJSONReader reader(m_pText, m_TextSize, &m_Index);
+            json_type type = JSON_NULL;
+            if(!reader.Peek(type) || type != JSON_OBJECT || !reader.BeginObject())
+                return false;
+            insertAt = reader.GetPosition();
+            CFileMember member;
+            while(reader.NextKey(member.name))
+            {
+                member.begin = reader.GetPosition();
+                if(!reader.SkipValue())
+                    return false;
+                member.end = insertAt = reader.GetPosition();
+                while(IsSpace(m_pText[member.begin]))
+                    member.begin++; // the value's own bytes, the layout stays.
+                file.push_back(member);
+            }
+            if(reader.HasError() || !reader.AtEnd())
+                return false;
+
+            std::sort(file.begin(), file.end());
+            for(size_t i = 1; i < file.size(); i++)
+            {
+                if(file[i - 1].name == file[i].name)
+                    return false;
+            }
+            return true;
+        }
+
+        // The comma and indent before a member, as CJSONWriter puts them.
+        void AppendMember(std::string& out, const std::string& text, bool bFirst)
+        {
+            if(!bFirst)
+                out += ',';
+            if(JSON_INDENT(m_Flags) > 0)
+                out += '\n' + std::string(JSON_INDENT(m_Flags), ' ');
+            else if(!bFirst && !(m_Flags & JSON_COMPACT))
+                out += ' ';
+            out += text;
+        }
+
+        static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+        // true when the two texts only differ in whitespace outside strings.
+        static bool SameText(const char* a, const char* aEnd, const char* b, const char* bEnd)
+        {
+            bool bString = false;
+            bool bEscape = false;
+            for(;;)
+            {
+                if(!bString)
+                {
+                    while(a < aEnd && IsSpace(*a))
+                        a++;
+                    while(b < bEnd && IsSpace(*b))
+                        b++;
+                }
+                if(a == aEnd || b == bEnd)
+                    return a == aEnd && b == bEnd;
+                if(*a != *b)
+                    return false;
+                char c = *a++;
+                b++;
+                if(bEscape)
+                    bEscape = false;
+                else if(bString && c == '\\')
+                    bEscape = true;
+                else if(c == '"')
+                    bString = !bString;
+            }
+        }
+
+        // Writes the new values over the old ones. They fit, the rest of
+        // each old value is blanked. Not crash safe, see SetPatchInPlace.
+        bool PatchFile(const std::string& Path, const std::vector<CJSONMemberText>& members, const std::vector<CFileEdit>& edits)
+        {
+            ReleaseRoot(); // the mapping.
+            FILE* pFile = fopen(Path.c_str(), "r+b");
+            if(!pFile)
+                return false;
+
+            bool bPatchSuccess = true;
+            for(size_t i = 0; bPatchSuccess && i < edits.size(); i++)
+            {
+                const CJSONMemberText& member = members[edits[i].member];
+                size_t length = member.text.size() - member.valueBegin;
+                std::string value = member.text.substr(member.valueBegin);
+                value.append(edits[i].end - edits[i].begin - length, ' ');
+                bPatchSuccess = fseek(pFile, long(edits[i].begin), SEEK_SET) == 0 && fwrite(value.data(), 1, value.size(), pFile) == value.size();
+            }
+            return (fclose(pFile) == 0) && bPatchSuccess;
+        }
+
+        // Copies the loaded text to a temporary file with the edits and the
+        // new members in it, then puts it in place of Path.
+        bool RewriteFile(const std::string& Path, const std::vector<CJSONMemberText>& members, const std::vector<CFileEdit>& edits, const std::string& inserts, size_t insertAt, bool bWasEmpty)
+        {
+            CJSONReplaceFile file;
+            FILE* pFile = file.Open(Path, false);
+            if(!pFile)
+                return false;
+
+            bool bWriteSuccess = true;
+            size_t pos = 0;
+            for(size_t i = 0; i < edits.size(); i++)
+            {
+                const CJSONMemberText& member = members[edits[i].member];
+                bWriteSuccess = WriteRange(pFile, m_pText + pos, edits[i].begin - pos) && bWriteSuccess;
+                bWriteSuccess = WriteRange(pFile, member.text.data() + member.valueBegin, member.text.size() - member.valueBegin) && bWriteSuccess;
+                pos = edits[i].end;
+            }
+            bWriteSuccess = WriteRange(pFile, m_pText + pos, insertAt - pos) && WriteRange(pFile, inserts.data(), inserts.size()) && bWriteSuccess;
+            if(bWasEmpty && !inserts.empty() && JSON_INDENT(m_Flags) > 0)
+                bWriteSuccess = WriteRange(pFile, "\n", 1) && bWriteSuccess;
+            bWriteSuccess = WriteRange(pFile, m_pText + insertAt, m_TextSize - insertAt) && bWriteSuccess;
+            return bWriteSuccess && file.Commit(); // the destructor drops the file otherwise.
+        }
+
+        static bool WriteRange(FILE* pFile, const char* p, size_t size)
+        {
+            return size == 0 || fwrite(p, 1, size, pFile) == size;
+        }
+
+        // jansson only accepts an object or array at the root. Do the same
+        // check up front, the rest of the text is checked in ParseObject.
+        bool CheckText()
+        {
+            JSON_STATS_PHASE(PHASE_TOKENIZE);
+            CJSONReader reader(m_pText, m_TextSize, &m_Index, m_Format);
+            json_type type = JSON_NULL;
+            if(m_Format == JSON_FORMAT_TEXT && m_TextSize > JSON_STRUCTURAL_INDEX_MAX_SIZE)
+            {
+                reader.SetError("text too large for the streaming parse");
+                m_LastError = reader.GetError();
+                ReportError();
+                ReleaseRoot();
+                return false;
+            }
+            if(!reader.Peek(type) || (type != JSON_OBJECT && type != JSON_ARRAY))
+            {
+                reader.SetError("'[' or '{' expected");
+                m_LastError = reader.GetError();
+                ReportError();
+                ReleaseRoot();
+                return false;
+            }
+            if(m_Format == JSON_FORMAT_TEXT)
+                m_Index.Build(m_pText, m_TextSize); // no index just means the slower byte scan.
+            return true;
+        }
+
+        json_type PeekText()
+        {
+            json_type type = JSON_NULL;
+            CJSONReader reader(m_pText, m_TextSize, NULL, m_Format);
+            if(!reader.Peek(type))
+                return JSON_NULL;
+            return type;
+        }
+
+        struct CPointerTarget
+        {
+            std::vector<std::string>    tokens;
+            CJSONValue*                 pValue;
+            bool                        bFound;
+        };
+
+        // The reader is on the value that the first depth tokens of the
+        // targets in active lead to. A value that is a target is skipped
+        // and parsed again from its range, so targets inside it are found
+        // as well.
+        bool WalkPointerValue(CJSONReader& reader, std::vector<CPointerTarget>& walk, const std::vector<size_t>& active, size_t depth, size_t& left)
+        {
+            std::vector<size_t> deeper;
+            for(size_t i = 0; i < active.size(); i++)
+            {
+                if(walk[active[i]].tokens.size() > depth)
+                    deeper.push_back(active[i]);
+            }
+            if(deeper.size() == active.size())
+                return WalkPointerContainer(reader, walk, deeper, depth, left);
+
+            size_t begin = reader.GetPosition();
+            if(!reader.SkipValue())
+                return false;
+            CJSONReader::CSource source = reader.GetSource();
+            size_t end = reader.GetPosition();
+
+            bool bParseSuccess = true;
+            for(size_t i = 0; i < active.size(); i++)
+            {
+                CPointerTarget& target = walk[active[i]];
+                if(target.tokens.size() == depth)
+                {
+                    CJSONReader value(source, begin, end);
+                    target.bFound = true;
+                    left--;
+                    bParseSuccess = target.pValue->Parse(value) && bParseSuccess;
+                }
+            }
+            if(!deeper.empty())
+            {
+                CJSONReader value(source, begin, end);
+                value.SetKeyBuffer(&m_Key);
+                bParseSuccess = WalkPointerContainer(value, walk, deeper, depth, left) && bParseSuccess;
+            }
+            return bParseSuccess;
+        }
+
+        // Goes through the members or elements, down into those the next
+        // token of a target names and over the others.
+        bool WalkPointerContainer(CJSONReader& reader, std::vector<CPointerTarget>& walk, const std::vector<size_t>& active, size_t depth, size_t& left)
+        {
+            json_type type;
+            if(!reader.Peek(type))
+                return false;
+
+            bool bParseSuccess = true;
+            std::vector<size_t> matched;
+            if(type == JSON_OBJECT)
+            {
+                reader.BeginObject();
+                std::string& key = reader.GetKeyBuffer(); // not used after the value, see GetKeyBuffer.
+                while(left > 0 && reader.NextKey(key))
+                {
+                    matched.clear();
+                    for(size_t i = 0; i < active.size(); i++)
+                    {
+                        if(!walk[active[i]].bFound && walk[active[i]].tokens[depth] == key)
+                            matched.push_back(active[i]);
+                    }
+                    bParseSuccess = (matched.empty() ? reader.SkipValue() : WalkPointerValue(reader, walk, matched, depth + 1, left)) && bParseSuccess;
+                }
+            }
+            else if(type == JSON_ARRAY)
+            {
+                reader.BeginArray();
+                for(size_t n = 0; left > 0 && reader.NextElement(); n++)
+                {
+                    matched.clear();
+                    for(size_t i = 0; i < active.size(); i++)
+                    {
+                        size_t index = 0;
+                        if(!walk[active[i]].bFound && CJSONPointer::ToIndex(walk[active[i]].tokens[depth], index) && index == n)
+                            matched.push_back(active[i]);
+                    }
+                    bParseSuccess = (matched.empty() ? reader.SkipValue() : WalkPointerValue(reader, walk, matched, depth + 1, left)) && bParseSuccess;
+                }
+            }
+            else
+            {
+                reader.SkipValue(); // the targets go deeper than a scalar.
+            }
+            return bParseSuccess && !reader.HasError();
+        }
+
+        static json_t* FindPointer(json_t* pVal, const std::vector<std::string>& tokens)
+        {
+            for(size_t i = 0; pVal && i < tokens.size(); i++)
+            {
+                size_t index = 0;
+                if(json_is_object(pVal))
+                    pVal = json_object_get(pVal, tokens[i].c_str());
+                else if(json_is_array(pVal) && CJSONPointer::ToIndex(tokens[i], index))
+                    pVal = json_array_get(pVal, index);
+                else
+                    pVal = NULL;
+            }
+            return pVal;
+        }
+
+        // Prints m_LastError.
+        void ReportError()
+        {
+            JSON_STATS_PHASE(PHASE_REPORT);
+            JSON_STATS_ADD(errors, 1);
+            fprintf(stderr, "warning: %s \n", m_LastError.text);
+        }
+
+        bool CheckReader(CJSONReader& reader, bool bCheckEOF)
+        {
+            if(bCheckEOF && !reader.HasError() && !reader.AtEnd())
+            {
+                reader.SetError("end of file expected");
+            }
+
+            if(reader.HasError())
+            {
+                m_LastError = reader.GetError();
+                ReportError();
+                return false;
+            }
+            return true;
         }
 
     private:
-        json_t*         m_pRoot;
-        json_error_t    m_LastError;
-        size_t          m_Flags;
+        json_t*                 m_pRoot;
+        json_error_t            m_LastError;
+        size_t                  m_Flags;
+        bool                    m_bStreaming;
+        bool                    m_bMemoryMap;
+        bool                    m_bPatchInPlace;
+        bool                    m_bArena;
+        CJSONArena              m_Arena;    // the jansson tree of a DOM load.
+        CJSONFormat             m_Format;
+        std::string             m_Text;     // document text in streaming mode, unless mapped.
+        CJSONMappedFile         m_File;
+        const char*             m_pText;    // m_Text or the mapping. NULL if nothing is loaded.
+        size_t                  m_TextSize;
+        CJSONStructuralIndex    m_Index;    // lists the token offsets into m_pText a chunk at a time.
+        CJSONTextToken*         m_pTextToken; // of m_pText, NULL until a parse asks for one.
+        std::string             m_Key;      // lent to the readers, see CJSONReader::GetKeyBuffer.
+        std::vector<uint32_t>   m_Tokens;   // lent to the readers, see CJSONReader::SetTokenBuffer.
+        CJSONThreadPool*        m_pThreadPool;
+        CJSONStats*             m_pStats;   // not owned, NULL to record nothing.
 };
 
 
@@ -1472,7 +4081,8 @@ inline bool CJSONValueObject<DerivedClass>::LoadFromFile( const std::string& Pat
     json.LoadFromFile(Path);    // opens the JSON file and loads the data into buffer.
     if(json.IsRootObject())     // expecting an object
     {
-        return json.ParseObject(m_pDerived); // Parses all the data for this object.
+        bool bParseSuccess = json.ParseObject(m_pDerived); // Parses all the data for this object.
+        return Materialize() && bParseSuccess; // the text goes with json.
     }
     else
     {
@@ -1489,6 +4099,13 @@ inline bool CJSONValueObject<DerivedClass>::SaveToFile( const std::string& Path
     return bSaveSuccess;
 }
 
+template<class DerivedClass>
+inline bool CJSONValueObject<DerivedClass>::UpdateFile( const std::string& Path )
+{
+    CJSONParser json;
+    return json.UpdateObjectToFile(Path, m_pDerived);
+}
+
 
 
 
@@ -0,0 +1,589 @@
+//
+//  json_writer.h
+//
+//  Text writer used by the streaming (DOM-free) dump mode of CJSONParser.
+//  The CJSONValue classes write their bound members straight into an
+//  output buffer, so no jansson tree is built and then walked again to
+//  print and release it. Values without a binding (the missing values of
+//  an object) are still jansson values and are written from the tree.
+//
+//  The layout is the one json_dumps makes for the same flags: JSON_INDENT,
+//  JSON_COMPACT, JSON_ENSURE_ASCII, JSON_SORT_KEYS, JSON_PRESERVE_ORDER,
+//  JSON_ENCODE_ANY and JSON_ESCAPE_SLASH, except that reals are printed
+//  with their shortest digits (JSON_WRITER_SHORTEST_REALS). The writer
+//  does not sort, a caller writing bound members must write the keys in
+//  the order jansson would (see CJSONValueObject::Write).
+//
+//  With JSON_FORMAT_CBOR the same calls write CBOR (see json_cbor.h) and
+//  the layout flags are ignored; JSON_ENCODE_ANY still allows any root.
+//
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <jansson.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "json_number.h"
+#include "json_cbor.h"
+#include "json_utf8.h"
+
+namespace json {
+
+// With a file the buffer is written out whenever it holds this much.
+#ifndef JSON_WRITER_BUFFER_SIZE
+#define JSON_WRITER_BUFFER_SIZE (64 * 1024)
+#endif
+
+// Reals are printed with the shortest digits that read back the same (see
+// json_number.h). false prints them with %.17g like json_dumps.
+#ifndef JSON_WRITER_SHORTEST_REALS
+#define JSON_WRITER_SHORTEST_REALS true
+#endif
+
+class CJSONWriter
+{
+    public:
+        CJSONWriter(size_t flags = (JSON_INDENT(4) | JSON_SORT_KEYS | JSON_PRESERVE_ORDER), FILE* pFile = NULL, CJSONFormat format = JSON_FORMAT_TEXT) : m_Flags(flags), m_pFile(pFile), m_Format(format), m_Depth(0), m_bAfterKey(false), m_bError(false)
+        {
+            if(m_pFile)
+                m_Buffer.reserve(JSON_WRITER_BUFFER_SIZE + 1024);
+        }
+
+        ~CJSONWriter() {}
+
+    // Structure
+        bool BeginObject()
+        {
+            if(!BeginValue(true))
+                return false;
+            m_Buffer += IsCbor() ? char(0xA0 | CJSONCbor::INFO_INDEFINITE) : '{';
+            m_Counts.push_back(0);
+            m_Kinds.push_back('{');
+            return true;
+        }
+
+        // The key of the next value in the current object.
+        bool Key(const char* key, size_t length)
+        {
+            if(m_bError)
+                return false;
+            if(m_Counts.empty() || m_Kinds.back() != '{' || m_bAfterKey)
+                return SetError();
+            if(!WriteOutIfFull())
+                return false;
+            Separator();
+            if(IsCbor())
+            {
+                if(!WriteCborString(key, length))
+                    return false;
+            }
+            else
+            {
+                if(!WriteString(key, length))
+                    return false;
+                m_Buffer += (m_Flags & JSON_COMPACT) ? ":" : ": ";
+            }
+            m_bAfterKey = true;
+            return true;
+        }
+        bool Key(const std::string& key) { return Key(key.c_str(), strlen(key.c_str())); }
+
+        bool EndObject() { return End('}'); }
+
+        bool BeginArray()
+        {
+            if(!BeginValue(true))
+                return false;
+            m_Buffer += IsCbor() ? char(0x80 | CJSONCbor::INFO_INDEFINITE) : '[';
+            m_Counts.push_back(0);
+            m_Kinds.push_back('[');
+            return true;
+        }
+
+        bool EndArray() { return End(']'); }
+
+        // A complete value as text (or CBOR) made by a writer with the same
+        // flags and format at the depth it is written at, see SetDepth.
+        bool Raw(const char* value, size_t length)
+        {
+            if(!BeginValue(true))
+                return false;
+            m_Buffer.append(value, length);
+            return true;
+        }
+        bool Raw(const std::string& value) { return Raw(value.data(), value.size()); }
+
+        // More of the value Raw began, for one that is put together from
+        // pieces. Nothing is checked.
+        bool Append(const char* value, size_t length)
+        {
+            if(m_bError)
+                return false;
+            m_Buffer.append(value, length);
+            return true;
+        }
+
+    // Values
+        bool Null()
+        {
+            if(!BeginValue(false))
+                return false;
+            if(IsCbor())
+                m_Buffer += char((CJSONCbor::MAJOR_SIMPLE << 5) | CJSONCbor::SIMPLE_NULL);
+            else
+                m_Buffer += "null";
+            return true;
+        }
+
+        bool Bool(bool value)
+        {
+            if(!BeginValue(false))
+                return false;
+            if(IsCbor())
+                m_Buffer += char((CJSONCbor::MAJOR_SIMPLE << 5) | (value ? CJSONCbor::SIMPLE_TRUE : CJSONCbor::SIMPLE_FALSE));
+            else
+                m_Buffer += value ? "true" : "false";
+            return true;
+        }
+
+        bool Integer(json_int_t value)
+        {
+            if(!BeginValue(false))
+                return false;
+            if(IsCbor())
+            {
+                if(value < 0)
+                    CJSONCbor::AppendHead(m_Buffer, CJSONCbor::MAJOR_NEGATIVE, uint64_t(-(value + 1)));
+                else
+                    CJSONCbor::AppendHead(m_Buffer, CJSONCbor::MAJOR_UNSIGNED, uint64_t(value));
+            }
+            else if(value < 0)
+            {
+                m_Buffer += '-';
+                AppendDigits(uint64_t(-(value + 1)) + 1);
+            }
+            else
+            {
+                AppendDigits(uint64_t(value));
+            }
+            return true;
+        }
+
+        // Values of unsigned 64 bit members above the json_int_t range.
+        bool UnsignedInteger(uint64_t value)
+        {
+            if(!BeginValue(false))
+                return false;
+            if(IsCbor())
+                CJSONCbor::AppendHead(m_Buffer, CJSONCbor::MAJOR_UNSIGNED, value);
+            else
+                AppendDigits(value);
+            return true;
+        }
+
+        // nan and inf have no JSON form, json_real refuses them as well.
+        bool Real(double value)
+        {
+            if(std::isnan(value) || std::isinf(value))
+                return SetError();
+            if(!BeginValue(false))
+                return false;
+            char buffer[100];
+            if(IsCbor())
+                CJSONCbor::AppendReal(m_Buffer, value);
+            else if(JSON_WRITER_SHORTEST_REALS)
+                m_Buffer.append(buffer, CJSONNumber::FormatDouble(value, buffer));
+            else
+                m_Buffer += FormatReal(value, buffer, sizeof(buffer));
+            return true;
+        }
+
+        // Only the digits a float needs, 0.1 and not 0.10000000149011612.
+        bool Real(float value)
+        {
+            if(!JSON_WRITER_SHORTEST_REALS && !IsCbor())
+                return Real(double(value));
+            if(std::isnan(value) || std::isinf(value))
+                return SetError();
+            if(!BeginValue(false))
+                return false;
+            char buffer[32];
+            if(IsCbor())
+                CJSONCbor::AppendFloat(m_Buffer, value);
+            else
+                m_Buffer.append(buffer, CJSONNumber::FormatFloat(value, buffer));
+            return true;
+        }
+
+        // Fails on invalid UTF-8, like json_string.
+        bool String(const char* value, size_t length)
+        {
+            if(!BeginValue(false))
+                return false;
+            return IsCbor() ? WriteCborString(value, length) : WriteString(value, length);
+        }
+        bool String(const std::string& value) { return String(value.c_str(), strlen(value.c_str())); }
+
+        // The numbers of an array in one go. CBOR packs them in a typed
+        // array of T in host byte order; text writes them one by one.
+        template<class T>
+        bool NumberArray(const T* pValues, size_t count)
+        {
+            if(!IsCbor() || !CJSONCborTypedArray<T>::value)
+            {
+                bool bWriteSuccess = BeginArray();
+                for(size_t i = 0; bWriteSuccess && i < count; i++)
+                {
+                    bWriteSuccess = WriteNumber(pValues[i]);
+                }
+                return bWriteSuccess && EndArray();
+            }
+
+            if(!std::numeric_limits<T>::is_integer)
+            {
+                for(size_t i = 0; i < count; i++)
+                {
+                    if(std::isnan(double(pValues[i])) || std::isinf(double(pValues[i])))
+                        return SetError();
+                }
+            }
+            if(!BeginValue(true))
+                return false;
+            CJSONCbor::AppendHead(m_Buffer, CJSONCbor::MAJOR_TAG, CJSONCbor::TypedArrayTag<T>());
+            CJSONCbor::AppendHead(m_Buffer, CJSONCbor::MAJOR_BYTES, uint64_t(count) * sizeof(T));
+            if(!WriteOutIfFull())
+                return false;
+            if(count > 0)
+                m_Buffer.append((const char*)pValues, count * sizeof(T));
+            return true;
+        }
+
+        // A jansson value, e.g. one kept for a key without a binding.
+        bool WriteValue(const json_t* pVal)
+        {
+            if(m_bError)
+                return false;
+            if(!pVal)
+                return SetError();
+
+            switch(json_typeof(pVal))
+            {
+                case JSON_OBJECT:   return WriteObject(pVal);
+                case JSON_ARRAY:
+                {
+                    bool bWriteSuccess = BeginArray();
+                    for(size_t i = 0; bWriteSuccess && i < json_array_size(pVal); i++)
+                    {
+                        bWriteSuccess = WriteValue(json_array_get(pVal, i));
+                    }
+                    return bWriteSuccess && EndArray();
+                }
+                case JSON_STRING:
+                {
+                    const char* value = json_string_value(pVal);
+                    return String(value, strlen(value));
+                }
+                case JSON_INTEGER:  return Integer(json_integer_value(pVal));
+                case JSON_REAL:     return Real(json_real_value(pVal));
+                case JSON_TRUE:     return Bool(true);
+                case JSON_FALSE:    return Bool(false);
+                case JSON_NULL:     return Null();
+            }
+            return SetError();
+        }
+
+    // Output
+        // Writes what is buffered to the file. Without a file this only
+        // checks that a complete value has been written.
+        bool Flush()
+        {
+            if(m_bError)
+                return false;
+            if(!m_Counts.empty() || m_bAfterKey)
+                return SetError();
+            return WriteOut();
+        }
+
+        // The text so far when there is no file.
+        const std::string& GetBuffer() const { return m_Buffer; }
+        std::string& GetBuffer() { return m_Buffer; }
+
+        size_t GetFlags() const { return m_Flags; }
+
+        // Objects and arrays open, counting those of the writer the text
+        // goes into when it is written with Raw.
+        size_t GetDepth() const { return m_Depth + m_Counts.size(); }
+        // Indents as if the root were a value depth levels down.
+        void SetDepth(size_t depth) { m_Depth = depth; }
+        CJSONFormat GetFormat() const { return m_Format; }
+        bool IsCbor() const { return m_Format == JSON_FORMAT_CBOR; }
+        bool SortKeys() const { return (m_Flags & JSON_SORT_KEYS) != 0; }
+        bool HasError() const { return m_bError; }
+
+    private:
+        bool SetError()
+        {
+            m_bError = true;
+            return false;
+        }
+
+        // jansson puts each element on its own line when indenting and a
+        // single space after the commas otherwise (unless compact).
+        void Indent(size_t depth, bool bSpace)
+        {
+            size_t indent = JSON_INDENT(m_Flags);
+            if(indent > 0)
+            {
+                m_Buffer += '\n';
+                m_Buffer.append(depth * indent, ' ');
+            }
+            else if(bSpace && !(m_Flags & JSON_COMPACT))
+            {
+                m_Buffer += ' ';
+            }
+        }
+
+        // The comma and indent before an element or key.
+        void Separator()
+        {
+            if(IsCbor())
+                m_Counts.back()++;
+            else if(m_Counts.back()++ == 0)
+            {
+                Indent(GetDepth(), false);
+            }
+            else
+            {
+                m_Buffer += ',';
+                Indent(GetDepth(), true);
+            }
+        }
+
+        bool BeginValue(bool bContainer)
+        {
+            if(m_bError)
+                return false;
+            if(m_bAfterKey)
+            {
+                m_bAfterKey = false;
+                return true;
+            }
+            if(m_Counts.empty())
+            {
+                // only one root, and it must be a container unless asked.
+                if(!m_Buffer.empty() || (!bContainer && !(m_Flags & JSON_ENCODE_ANY)))
+                    return SetError();
+                return true;
+            }
+            if(m_Kinds.back() == '{')
+                return SetError(); // object values need a key.
+            if(!WriteOutIfFull())
+                return false;
+            Separator();
+            return true;
+        }
+
+        bool End(char close)
+        {
+            if(m_bError)
+                return false;
+            if(m_Counts.empty() || m_bAfterKey || m_Kinds.back() != (close == '}' ? '{' : '['))
+                return SetError();
+            if(m_Counts.back() > 0 && !IsCbor())
+                Indent(GetDepth() - 1, false);
+            m_Counts.pop_back();
+            m_Kinds.pop_back();
+            m_Buffer += IsCbor() ? char(CJSONCbor::BREAK) : close;
+            return true;
+        }
+
+        bool WriteOut()
+        {
+            if(!m_pFile || m_Buffer.empty())
+                return true;
+            if(fwrite(m_Buffer.data(), 1, m_Buffer.size(), m_pFile) != m_Buffer.size())
+                return SetError();
+            m_Buffer.clear();
+            return true;
+        }
+
+        void AppendDigits(uint64_t value)
+        {
+            char buffer[24];
+            char* p = buffer + sizeof(buffer);
+            do
+            {
+                *--p = char('0' + value % 10);
+                value /= 10;
+            } while(value);
+            m_Buffer.append(p, size_t(buffer + sizeof(buffer) - p));
+        }
+
+        bool WriteOutIfFull()
+        {
+            return !m_pFile || m_Buffer.size() < JSON_WRITER_BUFFER_SIZE || WriteOut();
+        }
+
+        // %.17g, made to look like a real (1.0 not 1) and without the '+'
+        // and leading zeros in the exponent, as jansson prints it.
+        static const char* FormatReal(double value, char* buffer, size_t size)
+        {
+            snprintf(buffer, size - 3, "%.17g", value);
+            if(!strchr(buffer, '.') && !strchr(buffer, 'e'))
+                strcat(buffer, ".0");
+
+            char* pExp = strchr(buffer, 'e');
+            if(pExp)
+            {
+                char* pStart = pExp + 1;
+                char* pEnd = pStart + 1;
+                if(*pStart == '-')
+                    pStart++;
+                while(*pEnd == '0')
+                    pEnd++;
+                if(pEnd != pStart)
+                    memmove(pStart, pEnd, strlen(pEnd) + 1);
+            }
+            return buffer;
+        }
+
+        bool WriteString(const char* value, size_t length)
+        {
+            const unsigned char* p = (const unsigned char*)value;
+            const unsigned char* pEnd = p + length;
+            const bool bAscii = (m_Flags & JSON_ENSURE_ASCII) != 0;
+            const bool bSlash = (m_Flags & JSON_ESCAPE_SLASH) != 0;
+
+            m_Buffer += '"';
+            while(p < pEnd)
+            {
+                // copy the run of characters that need nothing done.
+                const unsigned char* pRun = p;
+                while(p < pEnd && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\' && !(bSlash && *p == '/'))
+                    p++;
+                m_Buffer.append((const char*)pRun, size_t(p - pRun));
+                if(p == pEnd)
+                    break;
+
+                unsigned int codepoint = 0;
+                size_t n = CJSONUTF8::Decode(p, pEnd, codepoint);
+                if(n == 0)
+                    return SetError();
+
+                switch(codepoint)
+                {
+                    case '\\':  m_Buffer += "\\\\"; break;
+                    case '\"':  m_Buffer += "\\\""; break;
+                    case '\b':  m_Buffer += "\\b"; break;
+                    case '\f':  m_Buffer += "\\f"; break;
+                    case '\n':  m_Buffer += "\\n"; break;
+                    case '\r':  m_Buffer += "\\r"; break;
+                    case '\t':  m_Buffer += "\\t"; break;
+                    case '/':   m_Buffer += "\\/"; break;
+                    default:
+                    {
+                        char escape[13];
+                        if(codepoint >= 0x80 && !bAscii)
+                        {
+                            m_Buffer.append((const char*)p, n);
+                        }
+                        else if(codepoint < 0x10000)
+                        {
+                            snprintf(escape, sizeof(escape), "\\u%04x", codepoint);
+                            m_Buffer += escape;
+                        }
+                        else // surrogate pair
+                        {
+                            codepoint -= 0x10000;
+                            snprintf(escape, sizeof(escape), "\\u%04x\\u%04x", 0xD800 | ((codepoint & 0xFFC00) >> 10), 0xDC00 | (codepoint & 0x003FF));
+                            m_Buffer += escape;
+                        }
+                        break;
+                    }
+                }
+                p += n;
+            }
+            m_Buffer += '"';
+            return true;
+        }
+
+        // A text string: the same UTF-8 check, nothing is escaped.
+        bool WriteCborString(const char* value, size_t length)
+        {
+            const unsigned char* p = (const unsigned char*)value;
+            const unsigned char* pEnd = p + length;
+            while(p < pEnd)
+            {
+                if(*p < 0x80)
+                {
+                    p++;
+                    continue;
+                }
+                unsigned int codepoint = 0;
+                size_t n = CJSONUTF8::Decode(p, pEnd, codepoint);
+                if(n == 0)
+                    return SetError();
+                p += n;
+            }
+            CJSONCbor::AppendHead(m_Buffer, CJSONCbor::MAJOR_TEXT, length);
+            m_Buffer.append(value, length);
+            return true;
+        }
+
+        template<class T>
+        bool WriteNumber(T value)
+        {
+            if(std::numeric_limits<T>::is_integer)
+                return std::numeric_limits<T>::is_signed ? Integer(json_int_t(value)) : UnsignedInteger(uint64_t(value));
+            return Real(double(value));
+        }
+        bool WriteNumber(float value) { return Real(value); }
+
+        // Keys in iteration order, which is insertion order, or sorted.
+        bool WriteObject(const json_t* pVal)
+        {
+            std::vector<const char*> keys;
+            for(void* iter = json_object_iter((json_t*)pVal); iter; iter = json_object_iter_next((json_t*)pVal, iter))
+            {
+                keys.push_back(json_object_iter_key(iter));
+            }
+            if(SortKeys())
+                std::sort(keys.begin(), keys.end(), KeyLess());
+
+            bool bWriteSuccess = BeginObject();
+            for(size_t i = 0; bWriteSuccess && i < keys.size(); i++)
+            {
+                bWriteSuccess = Key(keys[i], strlen(keys[i])) && WriteValue(json_object_get(pVal, keys[i]));
+            }
+            return bWriteSuccess && EndObject();
+        }
+
+        struct KeyLess
+        {
+            bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+        };
+
+    private:
+        size_t                  m_Flags;
+        FILE*                   m_pFile;        // NULL to keep everything in m_Buffer.
+        CJSONFormat             m_Format;
+        size_t                  m_Depth;        // of the root, see SetDepth.
+        std::string             m_Buffer;
+        std::vector<size_t>     m_Counts;       // values written in each open object/array.
+        std::vector<char>       m_Kinds;        // '{' or '[' for each open object/array.
+        bool                    m_bAfterKey;    // a key was written, its value is next.
+        bool                    m_bError;
+};
+
+}
+
+#endif